@@ -0,0 +1,163 @@
+#ifndef BINARYFILEHELPERS_H
+#define BINARYFILEHELPERS_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// C++ 3rd party includes
+#include <concurrentqueue.h>
+#include <fmt/core.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+namespace SBCQueens {
+
+// Binary version of DataFile for the slow control data. Items are queued
+// with add() and written by save() as the lines of an SBC binary file
+// (version 1), one typed column per DataTypes.
+// The file is created on the first save() so the length of the columns
+// can depend on the data (ex: the number of RTDs). If a file with the
+// same name but other columns exists, "name_1.bin", "name_2.bin"... is
+// used instead.
+template <typename T, typename... DataTypes>
+requires std::copyable<T> or std::movable<T>
+class BinaryDataFile {
+    using writer_type = BinaryFormat::DynamicWriter<DataTypes...>;
+    constexpr static std::size_t n_cols = sizeof...(DataTypes);
+
+    const std::string _file_name;
+    const std::array<std::string, n_cols> _column_names;
+    std::string _current_file_name;
+    std::unique_ptr<writer_type> _writer;
+    std::size_t _dropped = 0;
+
+    moodycamel::ConcurrentQueue<T> _queue;
+    // Dequeued before the file could be opened, saved first next time
+    std::vector<T> _unsaved;
+
+    std::string _sequenced_name(const std::size_t& i) const {
+        if (i == 0) {
+            return _file_name;
+        }
+
+        const auto path = std::filesystem::path(_file_name);
+        return (path.parent_path() / fmt::format("{}_{}{}", path.stem().string(), i,
+                                                 path.extension().string())).string();
+    }
+
+    void _open(const std::vector<std::size_t>& sizes) {
+        std::array<std::size_t, n_cols> ranks;
+        ranks.fill(1);
+        for (std::size_t i = 0; i < 100; i++) {
+            const auto name = _sequenced_name(i);
+            try {
+                auto writer = std::make_unique<writer_type>(name, _column_names,
+                                                            ranks, sizes);
+                if (not writer->isOpen()) {
+                    break;
+                }
+
+                _writer = std::move(writer);
+                _current_file_name = name;
+                return;
+            } catch (const std::runtime_error&) {
+                // An existing file with other columns, try the next name
+            }
+        }
+
+        throw std::runtime_error("Could not open " + _file_name);
+    }
+
+ public:
+    using type = T;
+
+    // column_names are the names of the DataTypes columns in the header
+    BinaryDataFile(std::string_view file_name,
+                   const std::array<std::string, n_cols>& column_names) :
+        _file_name{file_name}, _column_names{column_names} {}
+
+    // True if the parent directory exists, the file itself is only
+    // created on the first save()
+    bool isOpen() const {
+        const auto parent = std::filesystem::path(_file_name).parent_path();
+        return parent.empty() or std::filesystem::is_directory(parent);
+    }
+
+    // Name of the file being written, empty before the first save()
+    const std::string& getFileName() const { return _current_file_name; }
+
+    // Items that did not fit the columns of the file
+    std::size_t getDropped() const { return _dropped; }
+
+    // Adds element as a copy to current buffer
+    void add(const T& element) noexcept {
+        _queue.enqueue(element);
+    }
+
+    void operator()(const T& element) noexcept {
+        add(element);
+    }
+
+    /* Writes everything in the buffer in the calling thread. f(T&) returns
+     * the columns of an item as std::tuple<std::span<DataTypes>...>, they
+     * must point inside the item. Items whose columns do not have the
+     * length of the first one are dropped. Throws if the file cannot be
+     * opened; the items are kept and written by the next save().
+     */
+    template<typename RowFunc>
+    requires std::is_invocable_r_v<std::tuple<std::span<DataTypes>...>, RowFunc, T&>
+    void save(RowFunc&& f) {
+        std::vector<T> data = std::move(_unsaved);
+        _unsaved.clear();
+        const auto num_unsaved = data.size();
+        const auto approx_length = _queue.size_approx();
+        data.resize(num_unsaved + approx_length);
+        data.resize(num_unsaved + _queue.try_dequeue_bulk(data.data() + num_unsaved,
+                                                          approx_length));
+        if (data.empty()) {
+            return;
+        }
+
+        if (not _writer) {
+            const auto columns = f(data.front());
+            std::vector<std::size_t> sizes;
+            std::apply([&](const auto&... column) {
+                (sizes.push_back(column.size()), ...);
+            }, columns);
+
+            try {
+                _open(sizes);
+            } catch (const std::runtime_error&) {
+                _unsaved = std::move(data);
+                throw;
+            }
+        }
+
+        for (auto& item : data) {
+            try {
+                std::apply([&](auto... columns) {
+                    _writer->save(columns...);
+                }, f(item));
+            } catch (const std::out_of_range&) {
+                _dropped++;
+            }
+        }
+
+        _writer->flush();
+    }
+};
+
+}  // namespace SBCQueens
+#endif
@@ -51,7 +51,7 @@ std::string translate_caen_error_code(const CAEN_DGTZ_ErrorCode&);
 enum class CAENConnectionType {
     USB,
     A4818,
-    OpticalLink, // Not supported
+    OpticalLink, // A2818 or A3818 CONET2 optical link
     Ethernet_V4718, // Only available for V4718 (not supported)
     USB_V4718 // not supported
 };
@@ -61,9 +61,12 @@ enum class CAENDigitizerModel {
 #ifndef NDEBUG
     DEBUG = 0,
 #endif
+    DT5725,
     DT5730B,
     DT5740D,
-    V1740D
+    DT5751,
+    V1740D,
+    V1751
 };
 
 // All the constants that never change for a given digitizer
@@ -89,8 +92,209 @@ struct CAENDigitizerModelConstants {
 
     // Voltage ranges the digitizer has.
     std::vector<double> VoltageRanges = {};
+
+    // Time between ticks of the trigger time tag in ns
+    double TriggerTimeTagPeriod = 8.0;
+};
+
+// Registers whose address depends on the digitizer family. Per channel
+// (or group) registers are at address | (n << 8).
+template<CAENDigitizerFamilies Family>
+struct CAENFamilyRegisters {};
+
+template<>
+struct CAENFamilyRegisters<CAENDigitizerFamilies::x730> {
+    // Input dynamic range of channel n
+    constexpr static uint32_t DCRange = 0x1028;
+};
+
+template<>
+struct CAENFamilyRegisters<CAENDigitizerFamilies::x725> {
+    // Input dynamic range of channel n
+    constexpr static uint32_t DCRange = 0x1028;
+};
+
+template<>
+struct CAENFamilyRegisters<CAENDigitizerFamilies::x740> {
+    // 8-bit DC corrections of channels 0-3 and 4-7 of group n
+    constexpr static uint32_t DCCorrectionsLow = 0x10C0;
+    constexpr static uint32_t DCCorrectionsHigh = 0x10C4;
+    // Post trigger size in samples (as written by the V1740D workaround)
+    constexpr static uint32_t PostTrigger = 0x8114;
+};
+
+// Compile-time version of CAENDigitizerModelConstants, one specialization
+// per supported model. Code that is specialized per model (such as the
+// decode loop) takes them as a template argument.
+template<CAENDigitizerModel Model>
+struct CAENModelTraits;
+
+#ifndef NDEBUG
+template<>
+struct CAENModelTraits<CAENDigitizerModel::DEBUG> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::DEBUG;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::DEBUG;
+    constexpr static uint32_t ADCResolution = 8;
+    constexpr static double AcquisitionRate = 100e3;
+    constexpr static uint32_t MemoryPerChannel = 1024;
+    constexpr static uint8_t NumChannels = 1;
+    constexpr static uint8_t NumberOfGroups = 0;
+    constexpr static uint8_t NumChannelsPerGroup = 1;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 10.0f;
+    constexpr static std::array<double, 1> VoltageRanges = {1.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+#endif
+
+template<>
+struct CAENModelTraits<CAENDigitizerModel::DT5730B> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::DT5730B;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x730;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 14;
+    constexpr static double AcquisitionRate = 500e6;
+    constexpr static uint32_t MemoryPerChannel = 5120000;
+    constexpr static uint8_t NumChannels = 8;
+    constexpr static uint8_t NumberOfGroups = 0;
+    constexpr static uint8_t NumChannelsPerGroup = 8;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 10.0f;
+    constexpr static std::array<double, 2> VoltageRanges = {0.5, 2.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+
+template<>
+struct CAENModelTraits<CAENDigitizerModel::DT5725> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::DT5725;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x725;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 14;
+    constexpr static double AcquisitionRate = 250e6;
+    constexpr static uint32_t MemoryPerChannel = 640000;
+    constexpr static uint8_t NumChannels = 8;
+    constexpr static uint8_t NumberOfGroups = 0;
+    constexpr static uint8_t NumChannelsPerGroup = 8;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 10.0f;
+    constexpr static std::array<double, 2> VoltageRanges = {0.5, 2.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+
+template<>
+struct CAENModelTraits<CAENDigitizerModel::DT5740D> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::DT5740D;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x740;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 12;
+    constexpr static double AcquisitionRate = 62.5e6;
+    constexpr static uint32_t MemoryPerChannel = 192000;
+    constexpr static uint8_t NumChannels = 32;
+    constexpr static uint8_t NumberOfGroups = 4;
+    constexpr static uint8_t NumChannelsPerGroup = 8;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 1.5f;
+    constexpr static std::array<double, 2> VoltageRanges = {2.0, 10.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+
+template<>
+struct CAENModelTraits<CAENDigitizerModel::V1740D> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::V1740D;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x740;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 12;
+    constexpr static double AcquisitionRate = 62.5e6;
+    constexpr static uint32_t MemoryPerChannel = 192000;
+    constexpr static uint8_t NumChannels = 64;
+    constexpr static uint8_t NumberOfGroups = 8;
+    constexpr static uint8_t NumChannelsPerGroup = 8;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 1.5f;
+    constexpr static std::array<double, 1> VoltageRanges = {2.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+
+// The x751 samples are 10-bit. The rate is the one without DES mode,
+// with DES mode on the board interleaves channel pairs at 2 GS/s.
+template<>
+struct CAENModelTraits<CAENDigitizerModel::DT5751> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::DT5751;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x751;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 10;
+    constexpr static double AcquisitionRate = 1e9;
+    constexpr static uint32_t MemoryPerChannel = 1835008;
+    constexpr static uint8_t NumChannels = 4;
+    constexpr static uint8_t NumberOfGroups = 0;
+    constexpr static uint8_t NumChannelsPerGroup = 4;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 7.0f;
+    constexpr static std::array<double, 1> VoltageRanges = {1.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
+};
+
+template<>
+struct CAENModelTraits<CAENDigitizerModel::V1751> {
+    constexpr static CAENDigitizerModel Model = CAENDigitizerModel::V1751;
+    constexpr static CAENDigitizerFamilies Family = CAENDigitizerFamilies::x751;
+    using Registers = CAENFamilyRegisters<Family>;
+    constexpr static uint32_t ADCResolution = 10;
+    constexpr static double AcquisitionRate = 1e9;
+    constexpr static uint32_t MemoryPerChannel = 1835008;
+    constexpr static uint8_t NumChannels = 8;
+    constexpr static uint8_t NumberOfGroups = 0;
+    constexpr static uint8_t NumChannelsPerGroup = 8;
+    constexpr static uint32_t MaxNumBuffers = 1024;
+    constexpr static float NLOCToRecordLength = 7.0f;
+    constexpr static std::array<double, 1> VoltageRanges = {1.0};
+    constexpr static double TriggerTimeTagPeriod = 8.0;
 };
 
+// Calls func with the traits of model (as an empty object) so model
+// specific code can be selected once at runtime, ex: at connection.
+// All the branches must return the same type.
+template<typename Func>
+constexpr decltype(auto) caen_model_dispatch(const CAENDigitizerModel& model,
+                                             Func&& func) {
+    switch(model) {
+#ifndef NDEBUG
+    case CAENDigitizerModel::DEBUG:
+        return func(CAENModelTraits<CAENDigitizerModel::DEBUG>{});
+#endif
+    case CAENDigitizerModel::DT5725:
+        return func(CAENModelTraits<CAENDigitizerModel::DT5725>{});
+    case CAENDigitizerModel::DT5730B:
+        return func(CAENModelTraits<CAENDigitizerModel::DT5730B>{});
+    case CAENDigitizerModel::DT5740D:
+        return func(CAENModelTraits<CAENDigitizerModel::DT5740D>{});
+    case CAENDigitizerModel::DT5751:
+        return func(CAENModelTraits<CAENDigitizerModel::DT5751>{});
+    case CAENDigitizerModel::V1751:
+        return func(CAENModelTraits<CAENDigitizerModel::V1751>{});
+    case CAENDigitizerModel::V1740D:
+    default:
+        return func(CAENModelTraits<CAENDigitizerModel::V1740D>{});
+    }
+}
+
+// Builds the runtime constants from the traits
+template<typename Traits>
+CAENDigitizerModelConstants caen_model_constants() {
+    return CAENDigitizerModelConstants {
+        Traits::ADCResolution,
+        Traits::AcquisitionRate,
+        Traits::MemoryPerChannel,
+        Traits::NumChannels,
+        Traits::NumberOfGroups,
+        Traits::NumChannelsPerGroup,
+        Traits::MaxNumBuffers,
+        Traits::NLOCToRecordLength,
+        {Traits::VoltageRanges.begin(), Traits::VoltageRanges.end()},
+        Traits::TriggerTimeTagPeriod
+    };
+}
+
 // This is here so we can transform string to enums
 // If the key does not exist, this will throw an error
 const static inline std::unordered_map<std::string, CAENDigitizerModel>
@@ -98,88 +302,79 @@ const static inline std::unordered_map<std::string, CAENDigitizerModel>
 #ifndef NDEBUG
         {"DEBUG", CAENDigitizerModel::DEBUG},
 #endif
+        {"DT5725", CAENDigitizerModel::DT5725},
         {"DT5730B", CAENDigitizerModel::DT5730B},
         {"DT5740D", CAENDigitizerModel::DT5740D},
-        {"V1740D", CAENDigitizerModel::V1740D}
+        {"DT5751", CAENDigitizerModel::DT5751},
+        {"V1740D", CAENDigitizerModel::V1740D},
+        {"V1751", CAENDigitizerModel::V1751}
 };
 
+// Gets the family given a model.
+constexpr CAENDigitizerFamilies caen_model_family(const CAENDigitizerModel& model) noexcept {
+    return caen_model_dispatch(model, [](auto traits) {
+        return decltype(traits)::Family;
+    });
+}
+
+// Nominal transfer rate of the link in 16-bit samples per second, so the
+// link carries twice this number in bytes. 0 if unknown.
+constexpr uint32_t caen_comm_transfer_rate(const CAENConnectionType& ct) noexcept {
+    switch (ct) {
+    case CAENConnectionType::USB:
+        return 15000000u;  // S/s
+    case CAENConnectionType::A4818:
+        return 40000000u;
+    // CONET2 runs at 80 MB/s per link. The A3818 has up to 4 links, so
+    // boards in different links do not share it.
+    case CAENConnectionType::OpticalLink:
+        return 40000000u;
+    default:
+        return 0u;
+    }
+}
+
+// Events per block transfer used when MaxEventsPerRead is 0. Slow links
+// use smaller blocks so a single ReadData does not block for long, fast
+// links use bigger blocks to pay the transfer overhead fewer times.
+constexpr uint32_t caen_link_max_events_per_read(const CAENConnectionType& ct) noexcept {
+    switch (ct) {
+    case CAENConnectionType::OpticalLink:
+        return 1023u;
+    case CAENConnectionType::A4818:
+        return 512u;
+    case CAENConnectionType::USB:
+    default:
+        return 256u;
+    }
+}
+
 // These links all the enums with their constants or properties that
 // are fixed per digitizer
 const static inline std::unordered_map<CAENDigitizerModel, CAENDigitizerModelConstants>
     CAENDigitizerModelsConstantsMap {
-        #ifndef NDEBUG
-        {CAENDigitizerModel::DEBUG, CAENDigitizerModelConstants {
-            8,          // ADCResolution
-            100e3,      //  AcquisitionRate
-            1024ul,     // MemoryPerChannel
-            1,          // NumChannels
-            0,          // NumberOfGroups, 0 -> no groups
-            1,          // NumChannelsPerGroup
-            1024,       // MaxNumBuffers
-            10.0f,      // NLOCToRecordLength
-            {1.0}       // VoltageRanges
-        }},
-        #endif
-        {CAENDigitizerModel::DT5730B, CAENDigitizerModelConstants {
-            14,         // ADCResolution
-            500e6,      //  AcquisitionRate
-            static_cast<uint32_t>(5.12e6),  // MemoryPerChannel
-            8,          // NumChannels
-            0,          // NumberOfGroups, 0 -> no groups
-            8,          // NumChannelsPerGroup
-            1024,       // MaxNumBuffers
-            10.0f,      // NLOCToRecordLength
-            {0.5, 2.0}  // VoltageRanges
-        }},
-        {CAENDigitizerModel::DT5740D, CAENDigitizerModelConstants {
-            12,         // ADCResolution
-            62.5e6,     //  AcquisitionRate
-            static_cast<uint32_t>(192e3),  // MemoryPerChannel
-            32,         // NumChannels
-            4,          // NumChannelsPerGroup
-            8,          // NumberOfGroups
-            1024,       // MaxNumBuffers
-            1.5f,       // NLOCToRecordLength
-            {2.0, 10.0} // VoltageRanges
-        }},
-        {CAENDigitizerModel::V1740D, CAENDigitizerModelConstants {
-            12,         // ADCResolution
-            62.5e6,     //  AcquisitionRate
-            static_cast<uint32_t>(192e3),  // MemoryPerChannel
-            64,         // NumChannels
-            8,          // NumChannelsPerGroup
-            8,          // NumberOfGroups
-            1024,       // MaxNumBuffers
-            1.5f,       // NLOCToRecordLength
-            {2.0}       // VoltageRanges
-        }}
-    // This is a C++20 higher feature so lets keep everything 17 compliant
-    // CAENDigitizerModelsConstants_map {
-    //     {CAENDigitizerModel::DT5730B, CAENDigitizerModelConstants{
-    //         .ADCResolution = 14,
-    //         .AcquisitionRate = 500e6,
-    //         .MemoryPerChannel = static_cast<uint32_t>(5.12e6),
-    //         .NumChannels = 8,
-    //         .NumberOfGroups = 0,
-    //         .NumChannelsPerGroup = 8,
-    //         .NLOCToRecordLength = 10,
-    //         .VoltageRanges = {0.5, 2.0}
-    //     }},
-    //     {CAENDigitizerModel::DT5740D, CAENDigitizerModelConstants{
-    //         .ADCResolution = 12,
-    //         .AcquisitionRate = 62.5e6,
-    //         .MemoryPerChannel = static_cast<uint32_t>(192e3),
-    //         .NumChannels = 32,
-    //         .NumberOfGroups = 4,
-    //         .NumChannelsPerGroup = 8,
-    //         .NLOCToRecordLength = 1.5,
-    //         .VoltageRanges = {2.0, 10.0}
-    //     }}
+#ifndef NDEBUG
+        {CAENDigitizerModel::DEBUG,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::DEBUG>>()},
+#endif
+        {CAENDigitizerModel::DT5725,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::DT5725>>()},
+        {CAENDigitizerModel::DT5730B,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::DT5730B>>()},
+        {CAENDigitizerModel::DT5740D,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::DT5740D>>()},
+        {CAENDigitizerModel::DT5751,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::DT5751>>()},
+        {CAENDigitizerModel::V1740D,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::V1740D>>()},
+        {CAENDigitizerModel::V1751,
+            caen_model_constants<CAENModelTraits<CAENDigitizerModel::V1751>>()}
 };
 
 struct CAENGlobalConfig {
     // X730 max buffers is 1024
     // X740 max buffers is 1024
+    // 0 = use the default of the connection type
     uint32_t MaxEventsPerRead = 512;
 
     // Record length in samples
@@ -263,7 +458,13 @@ struct CAENGlobalConfig {
     // In units of trigger clock. Only 4 LSB bits are counted.
     uint32_t MajorityCoincidenceWindow = 0;
 
+    // Only available for x751. Interleaves each pair of channels so the
+    // even channel samples at twice the rate. Only enable the even channels.
+    bool DESMode = false;
+
     // TODO(Any): there are also majority values for TRG-OUT
+
+    bool operator==(const CAENGlobalConfig&) const = default;
 };
 
 // Help structure to link an array of booleans to a single uint8_t
@@ -292,6 +493,8 @@ struct ChannelsMask {
 
         return CH[iter];
     }
+
+    bool operator==(const ChannelsMask&) const = default;
 };
 
 // As a general case, this holds all the configuration values for a channel
@@ -320,6 +523,8 @@ struct CAENGroupConfig {
 
     // In ADC counts
     uint32_t TriggerThreshold = 0;
+
+    bool operator==(const CAENGroupConfig&) const = default;
 };
 
 // Events structure: holds the raw data of the event, the info (timestamp),
@@ -410,6 +615,98 @@ class CAENEvent {
     }
 };
 
+// Timing of an event that is not part of CAEN_DGTZ_EventInfo_t
+struct CAENEventTime {
+    // Trigger time tag with all its rollovers, in ticks of
+    // TriggerTimeTagPeriod. Monotonic since the last EnableAcquisition.
+    uint64_t ExtendedTimeTag = 0;
+    // Estimated host wall-clock time of the trigger in ns since the unix
+    // epoch. Anchored to the host time of the ReadData that brought it.
+    int64_t HostTime = 0;
+};
+
+// Turns the 31-bit trigger time tag (TTT) into a 64-bit monotonic time
+// tag, and correlates it to the host wall-clock.
+//
+// Events are handled in batches, one per ReadData. The last event of a
+// batch is assumed to have happened when ReadData finished, and the rest
+// are placed before it using their time tags. The host time between
+// batches is also used to find rollovers missed when no event came for
+// longer than a TTT period (~17 s at 8 ns).
+class CAENTimeTagTracker {
+    constexpr static uint64_t kTTTRollover = uint64_t{1} << 31;
+
+    // In ns
+    double _period = 8.0;
+    uint64_t _offset = 0;
+    uint32_t _last_ttt = 0;
+
+    // Last event of the latest batch and its host time
+    bool _has_anchor = false;
+    uint64_t _anchor_tag = 0;
+    int64_t _anchor_time = 0;
+
+ public:
+    // Has to be called every time the acquisition starts as the
+    // digitizer sets its TTT back to 0.
+    void reset(const double& period) noexcept {
+        _period = period;
+        _offset = 0;
+        _last_ttt = 0;
+        _has_anchor = false;
+    }
+
+    // The acquisition was stopped and started again at host_time (ns).
+    // The TTT is back to 0, but the extended time tag keeps going using
+    // the time elapsed since the last batch.
+    void restart(const int64_t& host_time) noexcept {
+        if (_has_anchor and host_time > _anchor_time) {
+            _offset = _anchor_tag + static_cast<uint64_t>(
+                static_cast<double>(host_time - _anchor_time) / _period);
+        }
+        _last_ttt = 0;
+    }
+
+    // Extended time tag of the next event in the batch
+    uint64_t extend(const uint32_t& ttt) noexcept {
+        const uint32_t tag = ttt & (kTTTRollover - 1);
+        if (tag < _last_ttt) {
+            _offset += kTTTRollover;
+        }
+        _last_ttt = tag;
+        return _offset + tag;
+    }
+
+    // Closes the batch whose last event has time tag last_tag, and which
+    // was read at read_time (ns). Returns the ticks to add to every event
+    // of the batch due to missed rollovers.
+    uint64_t close_batch(const uint64_t& last_tag, const int64_t& read_time) noexcept {
+        uint64_t correction = 0;
+        if (_has_anchor and read_time > _anchor_time) {
+            const double host_ticks
+                = static_cast<double>(read_time - _anchor_time) / _period;
+            const double tag_ticks = static_cast<double>(last_tag - _anchor_tag);
+            const auto missed = std::floor((host_ticks - tag_ticks)
+                / static_cast<double>(kTTTRollover) + 0.5);
+            if (missed > 0) {
+                correction = static_cast<uint64_t>(missed)*kTTTRollover;
+                _offset += correction;
+            }
+        }
+
+        _has_anchor = true;
+        _anchor_tag = last_tag + correction;
+        _anchor_time = read_time;
+        return correction;
+    }
+
+    // Host time (ns) of an event in the latest closed batch
+    int64_t host_time(const uint64_t& tag) const noexcept {
+        return _anchor_time - static_cast<int64_t>(
+            static_cast<double>(_anchor_tag - tag) * _period);
+    }
+};
+
 template <typename DataType = uint16_t>
 requires std::is_same_v<DataType, uint16_t> or std::is_same_v<DataType, uint8_t>
 class CAENWaveforms {
@@ -417,6 +714,7 @@ class CAENWaveforms {
     std::size_t _num_en_chs = 0;
     uint32_t _record_length = 0;
     CAEN_DGTZ_EventInfo_t _info = CAEN_DGTZ_EventInfo_t{};
+    CAENEventTime _time = CAENEventTime{};
  public:
     CAENWaveforms() = default;
     CAENWaveforms(const CAENDigitizerModelConstants& model_constants,
@@ -445,6 +743,14 @@ class CAENWaveforms {
     [[nodiscard]] const CAEN_DGTZ_EventInfo_t& getInfo() const {
         return _info;
     }
+    [[nodiscard]] const CAENEventTime& getTime() const {
+        return _time;
+    }
+
+    // Set by CAEN::DecodeEvents after copying the event
+    void setTime(const CAENEventTime& time) {
+        _time = time;
+    }
 
     // Copies values from event into the internal buffer
     // Does not copy if record length does not match the size
@@ -473,6 +779,32 @@ class CAENWaveforms {
         }
     }
 
+    // Same as copy(event) but specialized per model. The number of
+    // channels is known at compile time so the loop is bounded and
+    // each channel is a straight copy the compiler can vectorize.
+    // Does not copy if the record length of any channel does not match.
+    template<typename Traits>
+    void copy(const std::unique_ptr<CAENEvent>& event) {
+        static_assert(8*sizeof(DataType) >= Traits::ADCResolution,
+                      "DataType cannot hold the samples of this model");
+        const CAEN_DGTZ_UINT16_EVENT_t* data = event->getData();
+        const std::size_t num_chs = std::min<std::size_t>(_num_en_chs,
+                                                          Traits::NumChannels);
+
+        for (std::size_t ch_index = 0; ch_index < num_chs; ch_index++) {
+            if (data->ChSize[_en_chs[ch_index]] != _record_length) {
+                return;
+            }
+        }
+
+        _info = event->getInfo();
+        DataType* out = _data.data();
+        for (std::size_t ch_index = 0; ch_index < num_chs; ch_index++) {
+            std::copy_n(data->DataChannel[_en_chs[ch_index]], _record_length,
+                        out + _record_length*ch_index);
+        }
+    }
+
     // Does not copy if both waveforms do not match in enabled channels,
     // number of enabled channels or record length
     void copy(const CAENWaveforms<DataType>& other) {
@@ -490,6 +822,7 @@ class CAENWaveforms {
 
         auto other_data = other.getData();
         _info = other.getInfo();
+        _time = other.getTime();
         for(std::size_t i = 0; i < _data.size(); i++) {
             _data[i] = other_data[i];
         }
@@ -516,7 +849,9 @@ class CAENWaveforms {
 
             // If the digitizer does not support groups, group_num = ch
             if(model_constants.NumberOfGroups == 0) {
-                out.push_back(group_num);
+                if (group_num < model_constants.NumChannels) {
+                    out.push_back(group_num);
+                }
                 continue;
             }
 
@@ -641,6 +976,21 @@ class CAEN {
     using CAENWaveforms_ptr = std::shared_ptr<CAENWaveforms<uint16_t>>;
     std::array<CAENWaveforms_ptr, EventBufferSize> _waveforms;
 
+    // Used to measure the actual link speed during RetrieveData
+    uint64_t _read_bytes_total = 0;
+    std::chrono::duration<double> _read_time_total{0.0};
+
+    // Host wall-clock time (ns since epoch) of the latest ReadData
+    int64_t _read_host_time = 0;
+    CAENTimeTagTracker _time_tracker;
+
+    // DecodeEvents specialized for the model, chosen at construction.
+    using DecodeEventsFn = void (CAEN::*)() noexcept;
+    const DecodeEventsFn _decode_events_fn;
+
+    template<typename Traits>
+    void _decode_events() noexcept;
+
     // Translates the connection info data to a single number that should
     // be unique.
     constexpr uint64_t _hash_connection_info(const CAENConnectionType& ct,
@@ -649,19 +999,18 @@ class CAEN {
         id |= (cn & 0x000000FF) << 16;
         id |= (ln & 0x000000FF) << 8;
 
-        // TODO(Any): missing enum cases
-        switch (ct) {
-        case CAENConnectionType::A4818:
-            id |= 1;
-        break;
-        case CAENConnectionType::USB:
-        default:
-            id |= 0;
-        }
+        // The first byte is the connection type: USB = 0, A4818 = 1...
+        id |= static_cast<uint64_t>(ct) & 0x000000FF;
 
         return id;
     }
 
+    // Host wall-clock time in ns since the unix epoch
+    static int64_t _host_time_now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
     // Private helper function to wrap the logic behind checking for an error
     // and printing the error message
     void _print_if_err(std::string_view CAEN_func_name,
@@ -695,18 +1044,6 @@ class CAEN {
         }
     }
 
-    // Gets the family given a model.
-    CAENDigitizerFamilies _get_family(const CAENDigitizerModel& model) {
-        switch(model) {
-        case CAENDigitizerModel::DT5740D:
-        case CAENDigitizerModel::V1740D: 
-            return CAENDigitizerFamilies::x740;
-        default:
-        case CAENDigitizerModel::DT5730B: 
-            return CAENDigitizerFamilies::x730;
-        }
-    }
-
  public:
     // Family 
     const CAENDigitizerFamilies Family;
@@ -746,7 +1083,10 @@ class CAEN {
          const CAENConnectionType& ct, const int& ln, const int& cn,
          const uint32_t& addr) :
         _logger{logger},
-        Family{_get_family(model)},
+        _decode_events_fn{caen_model_dispatch(model, [](auto traits) -> DecodeEventsFn {
+            return &CAEN::template _decode_events<decltype(traits)>;
+        })},
+        Family{caen_model_family(model)},
         Model{model},
         ModelConstants{CAENDigitizerModelsConstantsMap.at(model)},
         ConnectionType{ct},
@@ -781,6 +1121,14 @@ class CAEN {
                 ln, cn, addr, &_caen_api_handle);
         break;
 
+        // ln is the link of the A2818/A3818 and cn the board position
+        // in the daisy chain of that link.
+        case CAENConnectionType::OpticalLink:
+            _err_code = CAEN_DGTZ_OpenDigitizer(
+                CAEN_DGTZ_ConnectionType::CAEN_DGTZ_OpticalLink,
+                ln, cn, addr, &_caen_api_handle);
+        break;
+
         case CAENConnectionType::USB:
         default:
             _err_code = CAEN_DGTZ_OpenDigitizer(
@@ -833,6 +1181,8 @@ class CAEN {
 
     // Check whenever the port is connected
     bool IsConnected() noexcept { return _is_connected; }
+    // Check whenever the digitizer is acquiring
+    bool IsAcquiring() noexcept { return _is_acquiring; }
     // Check if it has error.
     bool HasError() noexcept { return _has_error; }
     // Resets warning flag
@@ -859,11 +1209,15 @@ class CAEN {
     // any dynamic memory.
     void Reset() noexcept;
     // Enables the acquisition and allocates the memory for the acquired data.
+    // If the memory is already allocated (a previous Enable/Disable cycle
+    // without a Setup or Reset in between) it is reused.
     // Does not enable acquisition if there are errors.
     void EnableAcquisition() noexcept;
-    // Disables the acquisition.
+    // Disables the acquisition. Keeps the memory allocated so the
+    // acquisition can be enabled again without reallocating.
     // Does not disables acquisition if resource there are errors.
-    void DisableAcquisition() noexcept;// Writes to register ADDR with VALUE
+    void DisableAcquisition() noexcept;
+    // Writes to register ADDR with VALUE
     // Does write to register if there are errors.
     void WriteRegister(const uint32_t& addr, const uint32_t& value) noexcept;
     // Reads contents of register ADDR into value
@@ -923,13 +1277,17 @@ class CAEN {
     }
 
     uint32_t GetCommTransferRate() noexcept {
-        if(ConnectionType == CAENConnectionType::USB){
-            return 15000000u;  // S/s
-        } else if (ConnectionType == CAENConnectionType::A4818) {
-            return 40000000u;
+        return caen_comm_transfer_rate(ConnectionType);
+    }
+
+    // Returns the transfer rate (in bytes/s) measured during the ReadData
+    // calls since the last EnableAcquisition. 0 if nothing has been read.
+    double GetMeasuredTransferRate() noexcept {
+        if (_read_time_total.count() <= 0.0) {
+            return 0.0;
         }
 
-        return 0u;
+        return static_cast<double>(_read_bytes_total) / _read_time_total.count();
     }
 
     // Returns the channel voltage range. If channel does not exist
@@ -1010,6 +1368,10 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
     _err_code = CAEN_DGTZ_GetInfo(handle, &_board_info);
     _print_if_err("CAEN_DGTZ_GetInfo", __FUNCTION__);
 
+    if (_global_config.MaxEventsPerRead == 0) {
+        _global_config.MaxEventsPerRead = caen_link_max_events_per_read(ConnectionType);
+    }
+
     _err_code = CAEN_DGTZ_SetMaxNumEventsBLT(handle, _global_config.MaxEventsPerRead);
     _print_if_err("CAEN_DGTZ_SetMaxNumEventsBLT", __FUNCTION__);
 
@@ -1051,7 +1413,8 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
     if (Model == CAENDigitizerModel::V1740D) {
         _print_if_err("CAEN_DGTZ_SetPostTriggerSize", __FUNCTION__);
         uint32_t posttrigval = 0.01*_global_config.PostTriggerPorcentage*_global_config.RecordLength*_global_config.DecimationFactor;
-        WriteRegister(0x8114, posttrigval);
+        WriteRegister(CAENFamilyRegisters<CAENDigitizerFamilies::x740>::PostTrigger,
+                      posttrigval);
     } else {
         _err_code = CAEN_DGTZ_SetPostTriggerSize(handle, _global_config.PostTriggerPorcentage);
         _print_if_err("CAEN_DGTZ_SetPostTriggerSize", __FUNCTION__);
@@ -1091,22 +1454,32 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
 
     // Channel stuff
     _group_configs = gr_configs;
-    if (Family == CAENDigitizerFamilies::x730) {
-        // For DT5730B, there are no groups only channels so we take
-        // each configuration as a channel
+    if (Family == CAENDigitizerFamilies::x730 or Family == CAENDigitizerFamilies::x725
+        or Family == CAENDigitizerFamilies::x751) {
+        // For these families there are no groups only channels so we take
+        // each configuration as a channel. Boards with less than 8
+        // channels (DT5751) ignore the extra configurations.
+        const std::size_t num_chs = std::min<std::size_t>(gr_configs.size(),
+                                                          ModelConstants.NumChannels);
+
         // First, we make the channel mask
         uint32_t channel_mask = 0;
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
+        for (std::size_t ch = 0; ch < num_chs; ch++) {
             channel_mask |= _group_configs[ch].Enabled << ch;
         }
 
         uint32_t trg_mask = 0;
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
-            trg_mask = _group_configs[ch].TriggerMask.get();
-            bool has_trig_mask = trg_mask > 0;
+        for (std::size_t ch = 0; ch < num_chs; ch++) {
+            bool has_trig_mask = _group_configs[ch].TriggerMask.get() > 0;
             trg_mask |=  has_trig_mask << ch;
         }
 
+        if (Family == CAENDigitizerFamilies::x751) {
+            _err_code = CAEN_DGTZ_SetDESMode(handle, _global_config.DESMode ?
+                CAEN_DGTZ_ENABLE : CAEN_DGTZ_DISABLE);
+            _print_if_err("CAEN_DGTZ_SetDESMode", __FUNCTION__);
+        }
+
         // Then enable those channels
         _err_code = CAEN_DGTZ_SetChannelEnableMask(handle, channel_mask);
         _print_if_err("CAEN_DGTZ_SetChannelEnableMask", __FUNCTION__);
@@ -1117,7 +1490,7 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
                                                     trg_mask);
         _print_if_err("CAEN_DGTZ_SetChannelSelfTrigger", __FUNCTION__);
 
-        for (std::size_t ch = 0; ch < gr_configs.size(); ch++) {
+        for (std::size_t ch = 0; ch < num_chs; ch++) {
             auto ch_config = gr_configs[ch];
 
             // Trigger stuff
@@ -1131,8 +1504,12 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
             _print_if_err("CAEN_DGTZ_SetChannelDCOffset", __FUNCTION__);
 
             // Writes to the registers that holds the DC range
-            // For 5730 it is the register 0x1n28
-            WriteRegister(0x1028 | (ch & 0x0F) << 8, ch_config.DCRange & 0x0001);
+            // For 5730 and 5725 it is the register 0x1n28. The x751
+            // only has one range.
+            if (Family != CAENDigitizerFamilies::x751) {
+                WriteRegister(CAENFamilyRegisters<CAENDigitizerFamilies::x730>::DCRange
+                              | (ch & 0x0F) << 8, ch_config.DCRange & 0x0001);
+            }
         }
 
     } else if (Family == CAENDigitizerFamilies::x740) {
@@ -1185,12 +1562,13 @@ void CAEN<T, N>::Setup(const CAENGlobalConfig& global_config,
                 word += gr_config.DCCorrections[ch] << (ch * 8);
             }
 
-            WriteRegister(0x10C0 | (grp_n << 8), word);
+            using x740Registers = CAENFamilyRegisters<CAENDigitizerFamilies::x740>;
+            WriteRegister(x740Registers::DCCorrectionsLow | (grp_n << 8), word);
             word = 0;
             for (int ch = 4; ch < 8; ch++) {
                 word += gr_config.DCCorrections[ch] << ((ch - 4) * 8);
             }
-            WriteRegister(0x10C4 | (grp_n << 8), word);
+            WriteRegister(x740Registers::DCCorrectionsHigh | (grp_n << 8), word);
         }
 
         bool trg_out = false;
@@ -1232,27 +1610,36 @@ void CAEN<T, N>::EnableAcquisition() noexcept {
 
     int& handle = _caen_api_handle;
 
-    // By using reset() for CAENData and CAENEvent we release memory, too.
-    // so by calling enable acquisition we also free memory and re-allocate.
-
-    // We need a single data buffer to hold the incoming Data
-    _caen_raw_data.reset(new CAENData{_logger, handle});
-    _err_code = _caen_raw_data->getError();
-    _print_if_err("CAENData", __FUNCTION__);
-
-    // Allocates all the memory for the internal events buffer
-    std::generate(_events.begin(), _events.end(), [h = handle](){
-        return std::make_unique<CAENEvent>(h);
-    });
+    // Reset() (and therefore Setup(...)) releases the memory, so we only
+    // allocate if this is the first enable after a setup. Otherwise, the
+    // buffers, events and waveforms from the last enable are reused.
+    if (not _caen_raw_data) {
+        // We need a single data buffer to hold the incoming Data
+        _caen_raw_data.reset(new CAENData{_logger, handle});
+        _err_code = _caen_raw_data->getError();
+        _print_if_err("CAENData", __FUNCTION__);
+
+        // Allocates all the memory for the internal events buffer
+        std::generate(_events.begin(), _events.end(), [h = handle](){
+            return std::make_unique<CAENEvent>(h);
+        });
+
+        std::generate(_waveforms.begin(), _waveforms.end(),
+                      [constants = ModelConstants,
+                       global = _global_config,
+                       groups = _group_configs]() {
+                        return std::make_shared<CAENWaveforms<uint16_t>>(constants,
+                                                       global,
+                                                       groups);
+        });
+    }
 
-    std::generate(_waveforms.begin(), _waveforms.end(),
-                  [constants = ModelConstants,
-                   global = _global_config,
-                   groups = _group_configs]() {
-                    return std::make_shared<CAENWaveforms<uint16_t>>(constants,
-                                                   global,
-                                                   groups);
-    });
+    // Whatever was read during the last enable is no longer valid.
+    _caen_raw_data->DataSize = 0;
+    _caen_raw_data->NumEvents = 0;
+    _read_bytes_total = 0;
+    _read_time_total = std::chrono::duration<double>{0.0};
+    _time_tracker.reset(ModelConstants.TriggerTimeTagPeriod);
 
     _err_code = CAEN_DGTZ_ClearData(handle);
     _print_if_err("CAEN_DGTZ_ClearData", __FUNCTION__);
@@ -1368,6 +1755,7 @@ void CAEN<T, N>::RetrieveData() noexcept {
         return;
     }
 
+    auto read_start = std::chrono::steady_clock::now();
     // UNSAFE CODE AHEAD
     _err_code = CAEN_DGTZ_ReadData(handle,
         CAEN_DGTZ_ReadMode_t::CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT,
@@ -1375,6 +1763,10 @@ void CAEN<T, N>::RetrieveData() noexcept {
         &_caen_raw_data->DataSize);
     _print_if_err("CAEN_DGTZ_ReadData", __FUNCTION__);
 
+    _read_time_total += std::chrono::steady_clock::now() - read_start;
+    _read_bytes_total += _caen_raw_data->DataSize;
+    _read_host_time = _host_time_now();
+
     _err_code = CAEN_DGTZ_GetNumEvents(handle,
                                        _caen_raw_data->Buffer,
                                        _caen_raw_data->DataSize,
@@ -1438,6 +1830,12 @@ auto CAEN<T, N>::DecodeEvent(const uint32_t& i) noexcept {
 
 template<typename T, size_t N>
 void CAEN<T, N>::DecodeEvents() noexcept {
+    (this->*_decode_events_fn)();
+}
+
+template<typename T, size_t N>
+template<typename Traits>
+void CAEN<T, N>::_decode_events() noexcept {
     if (_has_error or not _is_connected) {
         return;
     }
@@ -1455,7 +1853,25 @@ void CAEN<T, N>::DecodeEvents() noexcept {
                       __FUNCTION__,
                       "at event " + std::to_string(i));
 
-        _waveforms[i]->copy(_events[i]);
+        _waveforms[i]->template copy<Traits>(_events[i]);
+        _waveforms[i]->setTime(CAENEventTime{
+            _time_tracker.extend(_events[i]->getInfo().TriggerTimeTag), 0});
+    }
+
+    const auto n_events = _caen_raw_data->NumEvents;
+    if (n_events == 0) {
+        return;
+    }
+
+    // Second pass now that the batch is complete to anchor them to the
+    // host clock.
+    const auto correction = _time_tracker.close_batch(
+        _waveforms[n_events - 1]->getTime().ExtendedTimeTag, _read_host_time);
+    for (uint32_t i = 0; i < n_events; i++) {
+        auto time = _waveforms[i]->getTime();
+        time.ExtendedTimeTag += correction;
+        time.HostTime = _time_tracker.host_time(time.ExtendedTimeTag);
+        _waveforms[i]->setTime(time);
     }
 }
 
@@ -1472,6 +1888,7 @@ void CAEN<T, N>::ClearData() noexcept {
     _print_if_err("CAEN_DGTZ_ClearData", __FUNCTION__);
     _err_code = CAEN_DGTZ_SWStartAcquisition(handle);
     _print_if_err("CAEN_DGTZ_SWStartAcquisition", __FUNCTION__);
+    _time_tracker.restart(_host_time_now());
 }
 
 /// End Data Acquisition functions
@@ -0,0 +1,347 @@
+#ifndef FILEMIGRATOR_H
+#define FILEMIGRATOR_H
+#pragma once
+
+// C STD includes
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryReader.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCChecksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCFileSink.hpp"
+
+namespace SBCQueens {
+
+struct MigrationConfig {
+    // Where the files are moved to, keeping their path inside the run
+    // directory. Empty disables the migration.
+    std::string ArchiveDir;
+    // Of the copies, 0 = no limit
+    double MaxMBps = 0.0;
+    // Copies with the idle I/O class (Linux) so they only use the disks
+    // when nothing else does
+    bool IdleIO = true;
+
+    bool isEnabled() const { return not ArchiveDir.empty(); }
+};
+
+struct MigrationStats {
+    std::size_t Pending = 0;
+    uint64_t Migrated = 0;
+    // Left in the run directory
+    uint64_t Failed = 0;
+    uint64_t Bytes = 0;
+};
+
+// Moves completed files (ex: rotated SiPM files, slow control files of a
+// finished connection) from the fast run directory to a large archive in
+// its own thread. Every file is copied to "name.part" in the archive,
+// synced and read back; it is renamed and the original deleted only if
+// the CRC32C of the copy matches and, for SBC v2 files, all its block
+// checksums are good. Otherwise the original stays where it is.
+class FileMigrator {
+    constexpr static std::size_t kChunkSize = 1024*1024;
+
+    const MigrationConfig _config;
+    std::shared_ptr<spdlog::logger> _logger;
+
+    struct PendingFile {
+        std::string FileName;
+        std::string RunDir;
+    };
+
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<PendingFile> _pending;
+    bool _busy = false;
+    bool _stop = false;
+
+    std::atomic<uint64_t> _migrated = 0;
+    std::atomic<uint64_t> _failed = 0;
+    std::atomic<uint64_t> _bytes = 0;
+
+    std::thread _thread;
+
+    // Affects only the calling thread
+    static void _lower_io_priority() {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+        constexpr int kWhoProcess = 1;
+        constexpr int kClassIdle = 3;
+        constexpr int kClassShift = 13;
+        ::syscall(SYS_ioprio_set, kWhoProcess, 0, kClassIdle << kClassShift);
+#endif
+    }
+
+    // So the file is read back from the disk and not from memory
+    static void _drop_cache(const std::string& file_name) {
+#if defined(__linux__)
+        const int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+#else
+        static_cast<void>(file_name);
+#endif
+    }
+
+    // "name.bin" if it is free, otherwise "name_1.bin", "name_2.bin"...
+    static std::filesystem::path _free_name(const std::filesystem::path& path) {
+        auto out = path;
+        for (std::size_t i = 1; std::filesystem::exists(out); i++) {
+            out = path.parent_path() / fmt::format("{}_{}{}", path.stem().string(), i,
+                                                   path.extension().string());
+        }
+        return out;
+    }
+
+    // Returns false if it has to stop
+    bool _wait_until(const std::chrono::steady_clock::time_point& time) {
+        std::unique_lock lock(_mutex);
+        return not _cv.wait_until(lock, time, [&]() { return _stop; });
+    }
+
+    // Copies source to target at up to MaxMBps and returns the CRC32C of
+    // what was read. Throws if it fails or has to stop.
+    uint32_t _copy(const std::string& source, const std::string& target) {
+        std::ifstream in(source, std::ios::binary);
+        std::ofstream out(target, std::ios::binary | std::ios::trunc);
+        if (not in or not out) {
+            throw std::runtime_error("Could not open " + (in ? target : source));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const double bytes_per_second = _config.MaxMBps*1e6;
+        std::vector<char> buffer(kChunkSize);
+        uint64_t copied = 0;
+        uint32_t crc = 0;
+        while (in) {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            const auto n = static_cast<std::size_t>(in.gcount());
+            if (n == 0) {
+                break;
+            }
+
+            crc = BinaryFormat::crc32c(buffer.data(), n, crc);
+            out.write(buffer.data(), static_cast<std::streamsize>(n));
+            copied += n;
+            _bytes += n;
+
+            if (bytes_per_second > 0.0) {
+                const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(static_cast<double>(copied) / bytes_per_second));
+                if (not _wait_until(due)) {
+                    throw std::runtime_error("Stopped");
+                }
+            }
+        }
+
+        if (in.bad()) {
+            throw std::runtime_error("Failed to read " + source);
+        }
+
+        out.close();
+        if (not out) {
+            throw std::runtime_error("Failed to write " + target);
+        }
+        return crc;
+    }
+
+    static uint32_t _file_crc(const std::string& file_name) {
+        std::ifstream in(file_name, std::ios::binary);
+        std::vector<char> buffer(kChunkSize);
+        uint32_t crc = 0;
+        while (in) {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            crc = BinaryFormat::crc32c(buffer.data(), static_cast<std::size_t>(in.gcount()), crc);
+        }
+
+        if (in.bad()) {
+            throw std::runtime_error("Failed to read " + file_name);
+        }
+        return crc;
+    }
+
+    static bool _is_sbc_v2(const std::string& file_name) {
+        std::ifstream in(file_name, std::ios::binary);
+        std::array<char, 4> magic = {};
+        in.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+        return in and magic == BinaryFormat::kSBCv2Magic;
+    }
+
+    // Path of file_name inside the archive, empty if it is not in run_dir
+    std::filesystem::path _archive_path(const std::string& file_name,
+                                        const std::string& run_dir) const {
+        const auto relative = std::filesystem::relative(file_name, run_dir);
+        if (relative.empty() or *relative.begin() == "..") {
+            return {};
+        }
+        return std::filesystem::path(_config.ArchiveDir) / relative;
+    }
+
+    void _migrate(const PendingFile& file) {
+        const std::filesystem::path source = file.FileName;
+        const auto archive_path = _archive_path(file.FileName, file.RunDir);
+        if (archive_path.empty()) {
+            throw std::runtime_error(file.FileName + " is not in " + file.RunDir);
+        }
+
+        const auto target = _free_name(archive_path);
+        if (target != archive_path) {
+            _logger->warn("{} is already in the archive, {} is saved as {}",
+                          archive_path.string(), file.FileName, target.string());
+        }
+
+        const auto part = target.string() + ".part";
+        std::filesystem::create_directories(target.parent_path());
+
+        try {
+            const auto crc = _copy(source.string(), part);
+            BinaryFormat::sync_file_data(part);
+            _drop_cache(part);
+            if (_file_crc(part) != crc) {
+                throw std::runtime_error("The copy of " + file.FileName + " is different");
+            }
+
+            if (_is_sbc_v2(part)
+                and not BinaryFormat::Reader(part).verify_checksums(1).isOk()) {
+                throw std::runtime_error(file.FileName + " has corrupted blocks");
+            }
+        } catch (...) {
+            std::filesystem::remove(part);
+            throw;
+        }
+
+        std::filesystem::rename(part, target);
+        std::filesystem::remove(source);
+        _logger->info("Moved {} to {}", file.FileName, target.string());
+    }
+
+    void _loop() {
+        if (_config.IdleIO) {
+            _lower_io_priority();
+        }
+
+        while (true) {
+            PendingFile file;
+            {
+                std::unique_lock lock(_mutex);
+                _busy = false;
+                _cv.notify_all();
+                _cv.wait(lock, [&]() { return _stop or not _pending.empty(); });
+                if (_stop) {
+                    return;
+                }
+
+                file = std::move(_pending.front());
+                _pending.pop_front();
+                _busy = true;
+            }
+
+            try {
+                _migrate(file);
+                _migrated++;
+            } catch (const std::exception& err) {
+                _failed++;
+                _logger->error("Could not move {} to the archive, it stays in place. "
+                               "Error: {}", file.FileName, err.what());
+            }
+        }
+    }
+
+ public:
+    explicit FileMigrator(const MigrationConfig& config) :
+        _config{config}, _logger{spdlog::get("log")}
+    {
+        if (not _logger) {
+            _logger = spdlog::default_logger();
+        }
+
+        _thread = std::thread(&FileMigrator::_loop, this);
+    }
+
+    // The files still pending stay in the run directory
+    ~FileMigrator() {
+        std::size_t pending = 0;
+        {
+            std::lock_guard lock(_mutex);
+            _stop = true;
+            pending = _pending.size();
+        }
+        _cv.notify_all();
+        _thread.join();
+
+        if (pending > 0) {
+            _logger->warn("{} files were not moved to the archive", pending);
+        }
+    }
+
+    const MigrationConfig& config() const { return _config; }
+
+    // First sequence number (see SiPMDynamicWriter) of base_name that is
+    // free in the archive. Used as RolloverPolicy::FirstSequence so a
+    // writer restarted in the same run does not reuse the numbers of the
+    // files already moved.
+    uint32_t first_free_sequence(const std::string& base_name,
+                                 const std::string& run_dir) const {
+        const auto archive_path = _archive_path(base_name, run_dir);
+        uint32_t seq = 0;
+        while (not archive_path.empty() and std::filesystem::exists(
+                BinaryFormat::Tools::sequenced_file_name(archive_path.string(), seq))) {
+            seq++;
+        }
+        return seq;
+    }
+
+    // Queues file_name, which must be closed and inside run_dir. It goes
+    // to the same path inside the archive. Thread safe.
+    void submit(const std::string& file_name, const std::string& run_dir) {
+        {
+            std::lock_guard lock(_mutex);
+            _pending.push_back({file_name, run_dir});
+        }
+        _cv.notify_all();
+    }
+
+    // Blocks until every queued file is done
+    void wait() {
+        std::unique_lock lock(_mutex);
+        _cv.wait(lock, [&]() { return _stop or (_pending.empty() and not _busy); });
+    }
+
+    MigrationStats get_stats() {
+        std::lock_guard lock(_mutex);
+        return {_pending.size() + (_busy ? 1 : 0), _migrated.load(),
+                _failed.load(), _bytes.load()};
+    }
+};
+
+}  // namespace SBCQueens
+#endif
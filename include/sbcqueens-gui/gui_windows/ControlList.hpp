@@ -28,6 +28,8 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
     SiPMAcquisitionControl<ControlTypes::ComboBox, "CAEN Model">{""},
     SiPMAcquisitionControl<ControlTypes::InputUINT32, "VME Address">{"", "",
         DrawingOptions{.StepSize = 1, .Format = "%X"}},
+    SiPMAcquisitionControl<ControlTypes::InputInt, "CONET Node">{"",
+        "Position of the board in the daisy chain of the optical link."},
     SiPMAcquisitionControl<ControlTypes::InputText, "Keithley COM Port">{""},
     SiPMAcquisitionControl<ControlTypes::Button, "Connect##CAEN">{"", "",
         DrawingOptions{
@@ -41,10 +43,22 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
             .HoveredColor = HSV(0.f, 0.4, 0.7f),
             .ActiveColor = HSV(0.f, 0.8f, 0.2f)
         }},
+    SiPMAcquisitionControl<ControlTypes::Button, "Warm Standby##CAEN">{"",
+        "Stops the acquisition but keeps the digitizer connected and "
+        "configured. Connect resumes the acquisition without reprogramming "
+        "the digitizer.",
+        DrawingOptions{
+            .Color = HSV(0.12f, 0.6f, 0.5f),
+            .HoveredColor = HSV(0.12f, 0.6f, 0.7f),
+            .ActiveColor = HSV(0.12f, 0.6f, 0.2f)
+        }},
     SiPMAcquisitionControl<ControlTypes::InputUINT32, "Max Events Per Read">{""},
     SiPMAcquisitionControl<ControlTypes::InputUINT32, "Record Length [sp]">{""},
     SiPMAcquisitionControl<ControlTypes::InputUINT32, "Post-Trigger Buffer [%]">{""},
     SiPMAcquisitionControl<ControlTypes::Checkbox, "TRG-IN as Gate">{""},
+    SiPMAcquisitionControl<ControlTypes::Checkbox, "DES Mode">{"",
+        "Only available for x751. Doubles the sampling rate of the even "
+        "channels by interleaving them with the odd ones."},
     SiPMAcquisitionControl<ControlTypes::ComboBox, "External Trigger Mode">{""},
     SiPMAcquisitionControl<ControlTypes::ComboBox, "Software Trigger Mode">{""},
     SiPMAcquisitionControl<ControlTypes::ComboBox, "Trigger Polarity">{""},
@@ -71,6 +85,16 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
 
     SiPMAcquisitionControl<ControlTypes::InputText, "SiPM Output File Name">{"",
         "Name of the output file. Saved under {Run File}/{Today date}/{this}"},
+    SiPMAcquisitionControl<ControlTypes::InputUINT64, "Rotate Size [MB]">{"",
+        "The output is split in {name}_0000.bin, {name}_0001.bin... files of "
+        "this size. 0 = no limit. Applies to the next run."},
+    SiPMAcquisitionControl<ControlTypes::InputUINT64, "Rotate Events">{"",
+        "Events per output file. 0 = no limit. Applies to the next run."},
+    SiPMAcquisitionControl<ControlTypes::InputUINT64, "Rotate Time [s]">{"",
+        "Seconds per output file. 0 = no limit. Applies to the next run."},
+    SiPMAcquisitionControl<ControlTypes::Checkbox, "Preallocate Files">{"",
+        "Reserves the disk of each file when it is opened so it is written "
+        "contiguously. Needs Rotate Size or Rotate Events."},
     SiPMAcquisitionControl<ControlTypes::InputInt, "SiPM ID">{"",
         "This is the SiPM ID as specified."},
     SiPMAcquisitionControl<ControlTypes::InputInt, "SiPM Cell">{"",
@@ -82,7 +106,8 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
     SiPMAcquisitionControl<ControlTypes::InputFloat, "SiPM Voltage">{"",
             "Max voltage allowed is 60V"},
     SiPMAcquisitionControl<ControlTypes::Button, "START##CAEN">{"",
-            "Starts the acquisition and file saving routine.",
+            "Starts the acquisition and file saving routine. "
+            "Stops after Run Events events unless it is 0.",
             DrawingOptions{
                     .Color = HSV(118.f, 0.4f, 0.5f),
                     .HoveredColor = HSV(118.f, 0.4, 0.7f),
@@ -97,6 +122,27 @@ constexpr static auto SiPMGUIControls = std::make_tuple(
                    .ActiveColor = HSV(0.f, 0.8f, 0.2f),
                    .Size = {100, 50}
             }},
+    SiPMAcquisitionControl<ControlTypes::Button, "RUN QUEUE##CAEN">{"",
+            "Takes all the runs in the run queue (from gui_setup.toml) "
+            "back to back. STOP cancels it.",
+            DrawingOptions{
+                    .Color = HSV(200.f, 0.4f, 0.5f),
+                    .HoveredColor = HSV(200.f, 0.4, 0.7f),
+                    .ActiveColor = HSV(200.f, 0.4f, 0.2f),
+                    .Size = {100, 50}
+            }},
+    SiPMAcquisitionControl<ControlTypes::InputUINT32, "Run Events">{"",
+            "Number of events START saves before it stops. "
+            "0 = save until STOP is pressed."},
+
+    // Throughput planner controls
+    SiPMAcquisitionControl<ControlTypes::InputDouble, "Expected Trigger Rate">{"",
+        "Trigger rate (in Hz) expected during the run. Used to predict "
+        "the data rates and disk usage.",
+        DrawingOptions{.StepSize = 10, .Format = "%.1f"}},
+    SiPMAcquisitionControl<ControlTypes::Button, "Measure Disk Speed">{"",
+        "Writes (and deletes) a 256 MB file under the runs directory "
+        "to measure its write speed. Blocks the CAEN thread while it runs."},
 
     // Per Group config controls
     SiPMAcquisitionControl<ControlTypes::InputUINT8, "Group to modify">{"",
@@ -15,6 +15,7 @@
 #include "sbcqueens-gui/gui_windows/CAENGeneralConfigTab.hpp"
 #include "sbcqueens-gui/gui_windows/CAENPerGroupConfigTab.hpp"
 #include "sbcqueens-gui/gui_windows/CAENTriggerConfigTab.hpp"
+#include "sbcqueens-gui/gui_windows/ThroughputPlannerTab.hpp"
 #include "sbcqueens-gui/gui_windows/OtherSmallTabs.hpp"
 
 
@@ -49,6 +50,7 @@ public Window<SiPMAcquisitionData, TeensyControllerData, SlowDAQData> {
         this->_tabs.push_back(make_caen_general_config_tab(_sipm_doe));
         this->_tabs.push_back(make_caen_group_config_tab(_sipm_doe));
         this->_tabs.push_back(make_caen_trigger_config_tab(_sipm_doe));
+        this->_tabs.push_back(make_throughput_planner_tab(_sipm_doe));
         this->_tabs.push_back(make_gui_config_tab());
     }
 
@@ -53,8 +53,29 @@ constexpr static auto SiPMGUIIndicators = std::make_tuple(
     NumericalIndicator<"Max Possible Events in Buffer">("Events", ""),
 	NumericalIndicator<"Events in buffer">("Events", ""),
 	NumericalIndicator<"Trigger Rate">("Waveforms / s", ""),
+	NumericalIndicator<"Writer Queue Depth">("Batches", ""),
+	NumericalIndicator<"Writer Latency">("ms", "",
+        DrawingOptions{.Format = "%.2f"}),
+	NumericalIndicator<"Writer Max Latency">("ms", "",
+        DrawingOptions{.Format = "%.2f"}),
+	NumericalIndicator<"Dropped Events">("Waveforms", ""),
 	NumericalIndicator<"1SPE Gain Mean">("arb.", ""),
 
+	// Throughput planner indicators
+	NumericalIndicator<"Link Bytes per Event">("B", ""),
+	NumericalIndicator<"File Bytes per Event">("B", ""),
+	NumericalIndicator<"Expected Link Rate">("MB/s", ""),
+	NumericalIndicator<"Expected File Rate">("MB/s", ""),
+	NumericalIndicator<"Disk Fill Time">("hours", ""),
+	NumericalIndicator<"Free Disk Space">("GB", ""),
+	NumericalIndicator<"Nominal Link Speed">("MB/s", ""),
+	NumericalIndicator<"Measured Link Speed">("MB/s", "",
+		DrawingOptions{.Format = "%.3f"}),
+	NumericalIndicator<"Measured Disk Speed">("MB/s", ""),
+	NumericalIndicator<"Max Sustainable Rate">("Events / s", ""),
+	LEDIndicator<"Can Keep Up?">("Off if the expected trigger rate goes "
+		"over the link or disk limits."),
+
 	// CAEN model indicators
 	StringIndicator<"Model Name">("", "",
 		DrawingOptions{.TextPosition = TextPositionEnum::Left}),
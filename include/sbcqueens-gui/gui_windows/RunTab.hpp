@@ -5,9 +5,12 @@
 // C STD includes
 // C 3rd party includes
 // C++ STD includes
+#include <memory>
+
 // C++ 3rd party includes
 // my includes
 #include "sbcqueens-gui/gui_windows/Window.hpp"
+#include "sbcqueens-gui/file_migrator.hpp"
 
 #include "sbcqueens-gui/hardware_helpers/TeensyControllerData.hpp"
 #include "sbcqueens-gui/hardware_helpers/SiPMAcquisitionData.hpp"
@@ -29,6 +32,9 @@ class RunTab
 	std::string i_run_dir = "";
     std::string i_run_name = "";
 
+    // Shared by all the managers, null if there is no archive
+    std::shared_ptr<FileMigrator> _migrator;
+
  public:
  	explicit RunTab(
     SiPMAcquisitionData& sipm_data, TeensyControllerData& teensy_data,
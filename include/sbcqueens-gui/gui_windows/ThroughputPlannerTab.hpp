@@ -0,0 +1,39 @@
+#ifndef THROUGHPUTPLANNERTAB_H
+#define THROUGHPUTPLANNERTAB_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+// C++ 3rd party includes
+// my includes
+#include "sbcqueens-gui/gui_windows/Window.hpp"
+
+#include "sbcqueens-gui/hardware_helpers/SiPMAcquisitionData.hpp"
+
+namespace SBCQueens {
+
+// Predicts if the current CAEN configuration can keep up with the expected
+// trigger rate given the link and the disk of this computer.
+class ThroughputPlannerTab : public Tab<SiPMAcquisitionData> {
+    SiPMAcquisitionData& _sipm_doe;
+
+ public:
+    explicit ThroughputPlannerTab(SiPMAcquisitionData& p) :
+        Tab<SiPMAcquisitionData>{"Planner"},
+        _sipm_doe(p)
+    { }
+
+    ~ThroughputPlannerTab() {}
+ private:
+    void init_tab(const toml::table& tb);
+    void draw();
+};
+
+inline auto make_throughput_planner_tab(SiPMAcquisitionData& p) {
+    return std::make_unique<ThroughputPlannerTab>(p);
+}
+
+}  // namespace SBCQueens
+
+#endif
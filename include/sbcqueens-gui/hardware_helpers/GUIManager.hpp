@@ -74,6 +74,9 @@ class GUIManager : public ThreadManager<Pipes> {
     std::vector<std::string> rtd_names;
     std::vector<std::string> sipm_names;
 
+    // Run queue entry whose temperature was sent to the Teensy, -1 = none
+    int _relayed_run_entry = -1;
+
  public:
     GUIManager(const Pipes& p, DrawFunc&& draw_func) :
         ThreadManager<Pipes>(p), _draw_func{draw_func},
@@ -525,6 +528,7 @@ class GUIManager : public ThreadManager<Pipes> {
         _teensy_pipe_end.send_if_changed();
         _sipm_pipe_end.send_if_changed();
         _slowdaq_pipe_end.send_if_changed();
+        _relay_run_queue();
 
         // Update local data from threads
         static TeensyControllerData teensy_thread_data;
@@ -542,6 +546,31 @@ class GUIManager : public ThreadManager<Pipes> {
             _slowdaq_doe = slowdaq_thread_data;
         }
     }
+
+    // The run queue lives in the CAEN thread but the temperature setpoint
+    // belongs to the Teensy, so it is relayed every time a new entry
+    // starts. It goes after anything already sent, as its own callback.
+    void _relay_run_queue() {
+        if (not _sipm_doe.RunQueueActive) {
+            _relayed_run_entry = -1;
+            return;
+        }
+
+        const auto index = static_cast<int>(_sipm_doe.RunQueueIndex);
+        if (_sipm_doe.RunQueueIndex >= _sipm_doe.RunQueue.size()
+            or _relayed_run_entry == index) {
+            return;
+        }
+
+        _relayed_run_entry = index;
+        const auto setpoint = _sipm_doe.RunQueue[_sipm_doe.RunQueueIndex].Temperature;
+        _teensy_doe.PIDTempValues.SetPoint = setpoint;
+        _teensy_doe.Callback = [setpoint](TeensyControllerData& teensy_twin) {
+            teensy_twin.CommandToSend = TeensyCommands::SetPPIDTempSetpoint;
+            teensy_twin.PIDTempValues.SetPoint = setpoint;
+        };
+        _teensy_pipe_end.send();
+    }
 };
 
 template<typename Pipes, typename DrawFunc>
@@ -5,6 +5,11 @@
 // C STD includes
 // C 3rd party includes
 // C++ std includes
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
 // C++ 3rd party includes
 
 // my includes
@@ -12,9 +17,13 @@
 
 #include "sbcqueens-gui/caen_helper.hpp"
 #include "sbcqueens-gui/implot_helpers.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
 
 namespace SBCQueens {
 
+// Moves completed files to the archive, see file_migrator.hpp
+class FileMigrator;
+
 struct SiPMVoltageMeasure {
     double Current;
     double Volt;
@@ -23,6 +32,9 @@ struct SiPMVoltageMeasure {
 
 enum class SiPMAcquisitionManagerStates {
     Standby,
+    // Digitizer is connected, configured and its memory allocated but
+    // it is not acquiring. Going back to Acquisition only re-enables it.
+    WarmStandby,
     Acquisition,
     Closing
 };
@@ -39,6 +51,20 @@ struct BreakdownVoltageConfigData {
     uint32_t DataPulses = 200000;
 };
 
+// A single run of the run queue
+struct SiPMRunQueueEntry {
+    // Output file name of this run
+    std::string Name = "";
+    // SiPM bias voltage in V
+    float Voltage = 0.0f;
+    // Peltier temperature setpoint. The GUI relays it to the Teensy.
+    float Temperature = 0.0f;
+    // Number of events to save
+    uint32_t Events = 0;
+    // Time to wait after changing the voltage and temperature
+    std::chrono::seconds SettleTime{0};
+};
+
 struct SiPMAcquisitionData;
 
 // Multi-threading items
@@ -59,6 +85,8 @@ struct SiPMAcquisitionPipeEnd : public PipeEnd<TPipe, Type> {
 // CAEN Interface data that holds every non-volatile items.
 struct SiPMAcquisitionData {
     std::string RunDir = "";
+    // If set, the SiPM files are archived once they are closed
+    std::shared_ptr<FileMigrator> Migrator;
 
     CAENConnectionType ConnectionType;
 
@@ -68,9 +96,26 @@ struct SiPMAcquisitionData {
     std::array<CAENGroupConfig, 8> GroupConfigs;
 
     int PortNum = 0;
+    // Position of the board in the daisy chain of an optical link
+    int ConetNode = 0;
     uint32_t VMEAddress = 0;
 
     std::string SiPMOutputName = "";
+    // When to move on to the next output file during acquisition
+    BinaryFormat::RolloverPolicy FileRollover;
+    // If enabled, the SiPM file is written from its own thread
+    BinaryFormat::AsyncWriterConfig AsyncWriter;
+    // Encoding of the waveforms in the SiPM file
+    BinaryFormat::ColumnEncoding WaveformEncoding = BinaryFormat::ColumnEncoding::Raw;
+    // How the SiPM file is written to disk
+    BinaryFormat::IOBackend IOBackend = BinaryFormat::IOBackend::Buffered;
+    // When the SiPM file is synced to the disk
+    BinaryFormat::DurabilityPolicy Durability;
+    // If true, the blocks of the SiPM file have CRC32C checksums
+    bool Checksums = true;
+    // If not empty, the SiPM events are split between files in these
+    // directories (ex: one per disk) and RunDir only has their manifest
+    std::vector<std::string> ShardDirs;
     SiPMAcquisitionManagerStates CurrentState = SiPMAcquisitionManagerStates::Standby;
     SiPMAcquisitionStates AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
 
@@ -95,12 +140,30 @@ struct SiPMAcquisitionData {
     std::string SiPMName = "";
     BreakdownVoltageConfigData VBDData;
 
+    // Run queue items
+    std::vector<SiPMRunQueueEntry> RunQueue;
+    bool RunQueueActive = false;
+    // Entry currently being taken (or settling)
+    std::size_t RunQueueIndex = 0;
+
+    // Throughput planner items
+    // In Hz
+    double ExpectedTriggerRate = 100.0;
+    // If true, the thread measures the disk write speed of RunDir
+    bool MeasureDiskSpeed = false;
+
     // Indicator/"Out" data members
     uint32_t NumEventsInBuffer = 0;
     uint32_t MaxPossibleBuffers = 0;
     uint32_t FileStatistics = 0;
     double TriggeredRate = 0;
+    BinaryFormat::AsyncWriterStats WriterStats;
     CAEN_DGTZ_BoardInfo_t CAENBoardInfo;
+    // In bytes/s, 0 if not measured yet
+    double MeasuredLinkRate = 0;
+    double MeasuredDiskRate = 0;
+    // Free space in RunDir in bytes
+    uint64_t DiskAvailable = 0;
 
     // Shared plot data
     PlotDataBuffer<2> IVData;
@@ -38,12 +38,14 @@
 #include "sbcqueens-gui/implot_helpers.hpp"
 #include "sbcqueens-gui/timing_events.hpp"
 #include "sbcqueens-gui/armadillo_helpers.hpp"
+#include "sbcqueens-gui/file_migrator.hpp"
 
 #include "sbcqueens-gui/hardware_helpers/SiPMAcquisitionData.hpp"
 #include "sbcqueens-gui/hardware_helpers/ClientController.hpp"
 #include "sbcqueens-gui/hardware_helpers/Calibration.hpp"
 
 #include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/ThroughputPlanner.hpp"
 
 // #include "sbcqueens-gui/sipm_helpers/BreakDownRoutine.hpp"
 // #include "sbcqueens-gui/sipm_helpers/AcquisitionRoutine.hpp"
@@ -67,8 +69,11 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
 
     using SiPMCAEN = CAEN<std::shared_ptr<spdlog::logger>>;
     using SiPMCAEN_ptr = std::unique_ptr<SiPMCAEN>;
+    // Lives as long as the manager is in Acquisition or WarmStandby so
+    // consecutive runs do not have to reconnect or reprogram the digitizer.
+    SiPMCAEN_ptr _caen_port = nullptr;
 
-    using SiPMCAENFile_ptr = std::unique_ptr<BinaryFormat::SiPMDynamicWriter>;
+    using SiPMCAENFile_ptr = std::unique_ptr<BinaryFormat::SiPMShardedWriter>;
     SiPMCAENFile_ptr _caen_file = nullptr;
 
     using SiPMWaveforms_ptr = std::shared_ptr<CAENWaveforms<uint16_t>>;
@@ -86,6 +91,12 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     uint32_t SavedWaveforms = 0;
     uint64_t TriggeredWaveforms = 0;
 
+    // Events the current NumberedAcquisition has to save
+    uint64_t _events_to_save = 0;
+    // True while the current run queue entry waits to settle
+    bool _run_queue_settling = false;
+    std::chrono::steady_clock::time_point _run_queue_settle_end;
+
     bool _vbd_created = false;
 
     // tmp stuff
@@ -118,6 +129,7 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     SiPMAcquisitionState_ptr main_loop_state;
 
     SiPMAcquisitionState_ptr standby_state;
+    SiPMAcquisitionState_ptr warm_standby_state;
     SiPMAcquisitionState_ptr acquisition_state;
     SiPMAcquisitionState_ptr closing_state;
 
@@ -131,6 +143,10 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             std::chrono::milliseconds(1000),
             std::bind(&SiPMAcquisitionManager::standby, this));
 
+        warm_standby_state = std::make_shared<SiPMAcquisitioneState>(
+            std::chrono::milliseconds(200),
+            std::bind(&SiPMAcquisitionManager::warm_standby, this));
+
         acquisition_state = std::make_shared<SiPMAcquisitioneState>(
             std::chrono::milliseconds(1),
             std::bind(&SiPMAcquisitionManager::acquisition, this));
@@ -280,8 +296,8 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         _doe.TriggeredRate = static_cast<double>(dWaveforms) / dt;
     }
 
-    // Changes the manager state. Currently only 3:
-    // Acquisition, Closing, and Standby
+    // Changes the manager state. Currently only 4:
+    // Acquisition, WarmStandby, Closing, and Standby
     void switch_state(const SiPMAcquisitionManagerStates& newState) {
         _doe.CurrentState = newState;
         switch (_doe.CurrentState) {
@@ -289,6 +305,10 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
                 main_loop_state = acquisition_state;
             break;
 
+            case SiPMAcquisitionManagerStates::WarmStandby:
+                main_loop_state = warm_standby_state;
+            break;
+
             case SiPMAcquisitionManagerStates::Closing:
                 main_loop_state = closing_state;
             break;
@@ -316,6 +336,29 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             switch_state(_doe.CurrentState);
         }
 
+        // Blocks this thread for a few seconds and competes for the disk
+        // with the SiPM file, so only when the digitizer is not being read
+        if (_doe.MeasureDiskSpeed) {
+            _doe.MeasureDiskSpeed = false;
+            if (_doe.CurrentState == SiPMAcquisitionManagerStates::Standby or
+                _doe.CurrentState == SiPMAcquisitionManagerStates::WarmStandby) {
+                _logger->info("Measuring the disk write speed at {}", _doe.RunDir);
+                _doe.MeasuredDiskRate = measure_disk_write_rate(_doe.RunDir);
+                _logger->info("Disk write speed: {} MB/s", _doe.MeasuredDiskRate/1e6);
+            } else {
+                _logger->warn("The disk speed can only be measured in standby "
+                              "or warm standby, ignoring the request");
+            }
+        }
+
+        static auto update_disk_space = make_total_timed_event(
+                std::chrono::seconds(5),
+                [&]() {
+                    _doe.DiskAvailable = disk_available_space(_doe.RunDir);
+                }
+        );
+        update_disk_space();
+
         static auto send_data_tt = make_total_timed_event(
                 std::chrono::milliseconds(200),
                 [&]() {
@@ -327,19 +370,38 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     }
 
     // Does nothing other than wait 1000ms to avoid clogging PC resources.
+    // If the digitizer was held by the warm standby, it is released here.
     bool standby() {
+        if (_caen_port) {
+            _caen_port.reset();
+        }
+
+        change_state();
+        return true;
+    }
+
+    // Keeps the digitizer connected and configured but not acquiring.
+    // If the digitizer errored while waiting, go to standby to release it.
+    bool warm_standby() {
+        if (not _caen_port or _caen_port->HasError()) {
+            switch_state(SiPMAcquisitionManagerStates::Standby);
+            return true;
+        }
+
         change_state();
         return true;
     }
 
     bool acquisition() {
-        auto caen_res = attempt_connection();
-        if (caen_res->HasError()) {
-            caen_res.reset();
+        _caen_port = prepare_for_acquisition(std::move(_caen_port));
+        if (_caen_port->HasError()) {
+            _caen_port.reset();
             change_state();
             return true;
         }
 
+        auto caen_res = std::move(_caen_port);
+
         // We are stuck inside this while loop which will break under
         // three conditions:
         // 1. There is a fatal error in the CAEN digitizer.
@@ -348,6 +410,8 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         // 3.- Any other condition under acquisition mode. Such as number of
         //     samples but it can always ran to go forever
         while (not caen_res->HasError()) {
+            run_queue();
+
             switch(_doe.AcquisitionState) {
                 case SiPMAcquisitionStates::Oscilloscope:
                     main_loop_state->ChangeWaitTime(std::chrono::milliseconds(200));
@@ -364,6 +428,8 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
                     break;
 
                 case SiPMAcquisitionStates::NumberedAcquisition:
+                    main_loop_state->ChangeWaitTime(std::chrono::milliseconds(1));
+                    caen_res = acquisition_numbered(std::move(caen_res));
                     break;
 
                 // Resets the setup information without freeing the CAEN resource
@@ -375,6 +441,8 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
                     break;
             }
 
+            _doe.MeasuredLinkRate = caen_res->GetMeasuredTransferRate();
+
             // This manages the communication with the GUI
             change_state();
             // If the GUI says, hey stop acquiring, we do!
@@ -383,12 +451,56 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
             }
         }
 
-        // Once we go out of scope, we release/disconnect the CAEN
-        caen_res.reset();
         _caen_file.reset();
+        _doe.RunQueueActive = false;
+        _run_queue_settling = false;
+        // Under warm standby, we hold on to the CAEN resource with all its
+        // memory. Otherwise, we release/disconnect the CAEN
+        if (_doe.CurrentState == SiPMAcquisitionManagerStates::WarmStandby
+            and not caen_res->HasError()) {
+            caen_res->DisableAcquisition();
+            _caen_port = std::move(caen_res);
+            _logger->info("CAEN is in warm standby.");
+        } else {
+            caen_res.reset();
+        }
+
         return true;
     }
 
+    // Decides how much work has to be done to start acquiring:
+    // - No digitizer or the connection parameters changed: full connection.
+    // - The configuration changed: setup the digitizer again.
+    // - Otherwise (warm standby): just enable the acquisition.
+    SiPMCAEN_ptr prepare_for_acquisition(SiPMCAEN_ptr caen_port) {
+        if (not caen_port or caen_port->HasError()
+            or caen_port->Model != _doe.Model
+            or caen_port->ConnectionType != _doe.ConnectionType
+            or caen_port->LinkNum != _doe.PortNum
+            or caen_port->ConetNode != _doe.ConetNode
+            or caen_port->VMEBaseAddress != _doe.VMEAddress) {
+            // The old resource has to be released before a new connection
+            // attempt is made to the same digitizer.
+            caen_port.reset();
+            return attempt_connection();
+        }
+
+        if (caen_port->GetGlobalConfiguration() != _doe.GlobalConfig
+            or caen_port->GetGroupConfigurations() != _doe.GroupConfigs) {
+            return setup_and_prepare(std::move(caen_port));
+        }
+
+        caen_port->EnableAcquisition();
+        if (caen_port->HasError()) {
+            switch_state(SiPMAcquisitionManagerStates::Standby);
+            return caen_port;
+        }
+
+        _logger->info("CAEN resumed from warm standby.");
+        _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+        return caen_port;
+    }
+
     // Attempts a connection to the CAEN digitizer, setups the channels,
     // starts acquisition, and moves to the oscilloscope mode
     SiPMCAEN_ptr attempt_connection() {
@@ -396,7 +508,7 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
                                   _doe.Model,
                                   _doe.ConnectionType,
                                   _doe.PortNum,
-                                  0,
+                                  _doe.ConetNode,
                                   _doe.VMEAddress);
 
         // If port resource was not created, it equals a failure!
@@ -509,25 +621,98 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
         return caen_port;
     }
 
-    SiPMCAEN_ptr acquisition_endless(SiPMCAEN_ptr caen_port) {
-        if(not _caen_file) {
-            try {
-                _caen_file = std::make_unique<BinaryFormat::SiPMDynamicWriter>(
-                        _doe.RunDir + "/" + _run_name + "/" + _doe.SiPMOutputName + ".bin",
-                        caen_port->Family,
-                        caen_port->ModelConstants,
-                        caen_port->GetGlobalConfiguration(),
-                        caen_port->GetGroupConfigurations());
-
-                _doe.FileStatistics = 0;
-            } catch(std::runtime_error& err) {
-                if (not _caen_file->isOpen()) {
-                    _logger->error("SiPM file saving was not created with error: {}",
-                                   err.what());
-                    _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
-                    return caen_port;
-                }
+    // Opens the SiPM output file. If it fails, goes back to the
+    // oscilloscope mode and returns false.
+    bool open_caen_file(const SiPMCAEN_ptr& caen_port) {
+        const auto run_dir = _doe.RunDir + "/" + _run_name + "/";
+        std::vector<std::string> file_names;
+        for (const auto& dir : _doe.ShardDirs) {
+            file_names.push_back(dir + "/" + _run_name + "/" + _doe.SiPMOutputName + ".bin");
+        }
+
+        if (file_names.empty()) {
+            file_names.push_back(run_dir + _doe.SiPMOutputName + ".bin");
+        }
+
+        // Continues after the files of this run already in the archive
+        auto rollover = _doe.FileRollover;
+        if (_doe.Migrator && file_names.size() == 1) {
+            rollover.FirstSequence
+                = _doe.Migrator->first_free_sequence(file_names.front(), _doe.RunDir);
+        }
+
+        try {
+            _caen_file = std::make_unique<BinaryFormat::SiPMShardedWriter>(
+                    run_dir + _doe.SiPMOutputName + ".shards",
+                    file_names,
+                    caen_port->Family,
+                    caen_port->ModelConstants,
+                    caen_port->GetGlobalConfiguration(),
+                    caen_port->GetGroupConfigurations(),
+                    rollover,
+                    _doe.AsyncWriter,
+                    _doe.WaveformEncoding,
+                    _doe.IOBackend,
+                    _doe.Durability,
+                    _doe.Checksums);
+
+            // The manifest of a sharded run lists the full paths of its
+            // files, so only single files are moved to the archive
+            if (_doe.Migrator && _caen_file->num_shards() == 1) {
+                _caen_file->set_on_file_closed(
+                    [migrator = _doe.Migrator, run_dir = _doe.RunDir](const std::string& name) {
+                        migrator->submit(name, run_dir);
+                    });
+            }
+
+            _doe.FileStatistics = 0;
+            _doe.WriterStats = _caen_file->get_async_stats();
+            _logger->info("Saving SiPM data to {} ({} I/O)",
+                          _caen_file->get_current_file_name(),
+                          BinaryFormat::io_backend_to_string(_caen_file->get_io_backend()));
+            if (_caen_file->num_shards() > 1) {
+                _logger->info("SiPM data is split in {} shards listed in {}",
+                              _caen_file->num_shards(), _caen_file->get_manifest_name());
             }
+        } catch(std::runtime_error& err) {
+            _caen_file.reset();
+            _logger->error("SiPM file saving was not created with error: {}",
+                           err.what());
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+            _doe.RunQueueActive = false;
+            return false;
+        }
+
+        return true;
+    }
+
+    // Saves the first n_events decoded waveforms to the SiPM file
+    void save_waveforms(const std::size_t& n_events) {
+        const auto file_sequence = _caen_file->get_file_sequence();
+
+        _caen_file->save_waveforms(_waveforms.begin(), n_events);
+        _doe.WriterStats = _caen_file->get_async_stats();
+
+        if (auto err = _caen_file->pop_write_error(); not err.empty()) {
+            _logger->error("Failed to write SiPM data to {}. Error: {}",
+                           _caen_file->get_current_file_name(), err);
+        }
+
+        if (auto err = _caen_file->pop_rollover_error(); not err.empty()) {
+            _logger->warn("Could not move to the next SiPM file, "
+                          "still writing to {}. Error: {}",
+                          _caen_file->get_current_file_name(), err);
+        }
+
+        if (_caen_file->get_file_sequence() != file_sequence) {
+            _logger->info("SiPM data rolled over to {}",
+                          _caen_file->get_current_file_name());
+        }
+    }
+
+    SiPMCAEN_ptr acquisition_endless(SiPMCAEN_ptr caen_port) {
+        if(not _caen_file and not open_caen_file(caen_port)) {
+            return caen_port;
         }
 
         software_trigger(caen_port);
@@ -543,18 +728,112 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
 
             // TODO(Any): here be the filtering/software threshold routine
 
-            std::for_each_n(_waveforms.begin(),
-                            n_events,
-                            [&](SiPMWaveforms_ptr& waveform) {
-                                _caen_file->save_waveform(waveform);
-                            }
-            );
+            save_waveforms(n_events);
             process_data_for_gui();
         }
 
         return caen_port;
     }
 
+    // Saves exactly N events and then goes back to the oscilloscope mode.
+    // N is the run queue entry events if the queue is running, otherwise
+    // RunWaveforms. Events of the last block after the N-th are dropped.
+    SiPMCAEN_ptr acquisition_numbered(SiPMCAEN_ptr caen_port) {
+        if (not _caen_file) {
+            _events_to_save = _doe.VBDData.DataPulses;
+            if (_doe.RunQueueActive and _doe.RunQueueIndex < _doe.RunQueue.size()) {
+                _events_to_save = _doe.RunQueue[_doe.RunQueueIndex].Events;
+            }
+
+            if (not open_caen_file(caen_port)) {
+                return caen_port;
+            }
+        }
+
+        software_trigger(caen_port);
+
+        if (_doe.FileStatistics < _events_to_save and
+            caen_port->RetrieveDataUntilNEvents(0.5*caen_port->GetCurrentPossibleMaxBuffer())) {
+            auto n_events = caen_port->GetNumberOfEvents();
+            _doe.NumEventsInBuffer = n_events;
+            TriggeredWaveforms += n_events;
+
+            caen_port->DecodeEvents();
+
+            auto n_save = std::min<uint64_t>(n_events,
+                                             _events_to_save - _doe.FileStatistics);
+            save_waveforms(n_save);
+            _doe.FileStatistics += n_save;
+            process_data_for_gui();
+        }
+
+        if (_doe.FileStatistics >= _events_to_save) {
+            _logger->info("Done saving {} events to {}", _doe.FileStatistics,
+                          _caen_file->get_current_file_name());
+            _caen_file.reset();
+
+            if (_doe.RunQueueActive) {
+                _doe.RunQueueIndex++;
+            }
+
+            _doe.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
+        }
+
+        return caen_port;
+    }
+
+    // Takes the run queue entries one after the other using the same
+    // configured digitizer. For each entry: sets the output name, voltage
+    // and temperature, waits for them to settle in oscilloscope mode, and
+    // then does a NumberedAcquisition.
+    void run_queue() {
+        if (not _doe.RunQueueActive) {
+            _run_queue_settling = false;
+            return;
+        }
+
+        // Still taking the data of the current entry
+        if (_doe.AcquisitionState != SiPMAcquisitionStates::Oscilloscope) {
+            return;
+        }
+
+        if (_doe.RunQueueIndex >= _doe.RunQueue.size()) {
+            _logger->info("Run queue done. {} runs taken.", _doe.RunQueue.size());
+            _doe.RunQueueActive = false;
+            return;
+        }
+
+        const auto& entry = _doe.RunQueue[_doe.RunQueueIndex];
+        if (not _run_queue_settling) {
+            // Nothing drives the SiPM voltage supply from this thread yet,
+            // so the voltage of the entries is not applied
+            if (_doe.RunQueueIndex == 0) {
+                _logger->warn("The run queue voltages are not applied yet, "
+                              "every run is taken at the current bias");
+            }
+
+            _logger->info("Run queue {}/{}: {} at {} C (requested {} V, not "
+                          "applied), settling for {} s",
+                          _doe.RunQueueIndex + 1, _doe.RunQueue.size(),
+                          entry.Name, entry.Temperature, entry.Voltage,
+                          entry.SettleTime.count());
+
+            _doe.SiPMOutputName = entry.Name;
+
+            _run_queue_settle_end = std::chrono::steady_clock::now()
+                + entry.SettleTime;
+            _run_queue_settling = true;
+            return;
+        }
+
+        if (std::chrono::steady_clock::now() < _run_queue_settle_end) {
+            return;
+        }
+
+        _run_queue_settling = false;
+        _doe.AcquisitionState = SiPMAcquisitionStates::NumberedAcquisition;
+    }
+
     void software_trigger(SiPMCAEN_ptr& caen_port) {
         if (_doe.SoftwareTrigger) {
             _logger->info("Sending a software trigger");
@@ -566,6 +845,7 @@ class SiPMAcquisitionManager : public ThreadManager<Pipes> {
     // Only mode that stops the main_loop and frees all resources
     bool closing_mode() {
         _logger->info("Going to close the CAEN thread.");
+        _caen_port.reset();
         return false;
     }
 
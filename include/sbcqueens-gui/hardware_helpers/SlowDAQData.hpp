@@ -5,6 +5,7 @@
 // C STD includes
 // C 3rd party includes
 // C++ STD includes
+#include <memory>
 #include <string>
 
 // C++ 3rd party includes
@@ -15,6 +16,9 @@
 
 namespace SBCQueens {
 
+// Moves completed files to the archive, see file_migrator.hpp
+class FileMigrator;
+
 enum class PFEIFFERSingleGaugeSP {
     SLOW = 2,   // 1 min
     FAST = 1,   // 1s
@@ -52,6 +56,8 @@ struct SlowDAQPipeEnd : public PipeEnd<TPipe, Type> {
 
 struct SlowDAQData {
     std::string RunDir      = "";
+    // If set, the files of a connection are archived once it ends
+    std::shared_ptr<FileMigrator> Migrator;
     std::string RunName     = "";
 
     std::string PFEIFFERPort = "";
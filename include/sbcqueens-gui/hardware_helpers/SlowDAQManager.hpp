@@ -24,6 +24,8 @@
 
 #include "sbcqueens-gui/serial_helper.hpp"
 #include "sbcqueens-gui/file_helpers.hpp"
+#include "sbcqueens-gui/binary_file_helpers.hpp"
+#include "sbcqueens-gui/file_migrator.hpp"
 #include "sbcqueens-gui/timing_events.hpp"
 
 #include "sbcqueens-gui/hardware_helpers/SlowDAQData.hpp"
@@ -38,7 +40,9 @@ class SlowDAQManager : public ThreadManager<Pipes> {
 
     std::shared_ptr<spdlog::logger> _logger;
 
-    std::shared_ptr<DataFile<PFEIFFERSingleGaugeData>> _pfeiffer_file;
+    // Columns: time, pressure
+    using PFEIFFERFile = BinaryDataFile<PFEIFFERSingleGaugeData, double, double>;
+    std::shared_ptr<PFEIFFERFile> _pfeiffer_file;
 
     std::string _run_name;
 
@@ -117,10 +121,11 @@ class SlowDAQManager : public ThreadManager<Pipes> {
                                 + "/" + _run_name);
 
                             _init_time = get_current_time_epoch();
-                            _pfeiffer_file = std::make_shared<DataFile<PFEIFFERSingleGaugeData>>(
+                            _pfeiffer_file = std::make_shared<PFEIFFERFile>(
                                 _slowdaq_doe.RunDir
                                 + "/" + _run_name
-                                + "/PFEIFFERSSPressures.txt");
+                                + "/PFEIFFERSSPressures.bin",
+                                std::array<std::string, 2>{"time", "pressure"});
                             bool s = _pfeiffer_file->isOpen();
 
                             if (not s) {
@@ -173,6 +178,7 @@ class SlowDAQManager : public ThreadManager<Pipes> {
                         "PFEIFFER Pressure valve with port {}",
                         _slowdaq_doe.PFEIFFERPort);
                     disconnect(_pfeiffers_port);
+                    _release_files();
                                             // Move to standby
                     _slowdaq_doe.PFEIFFERState
                         = PFEIFFERSSGState::Standby;
@@ -181,6 +187,7 @@ class SlowDAQManager : public ThreadManager<Pipes> {
                 case PFEIFFERSSGState::Closing:
                     _logger->info("Going to close the slow DAQ thread.");
                     disconnect(_pfeiffers_port);
+                    _release_files();
                     return false;
                 break;
 
@@ -209,6 +216,35 @@ class SlowDAQManager : public ThreadManager<Pipes> {
         while (main_loop_block_time());
     }
 
+    // Writes everything queued
+    void _save_files() {
+        _logger->info("Saving PFEIFFER data...");
+
+        try {
+            _pfeiffer_file->save([](PFEIFFERSingleGaugeData& data) {
+                return std::make_tuple(std::span<double>(&data.time, 1),
+                                       std::span<double>(&data.Pressure, 1));
+            });
+        } catch (const std::exception& err) {
+            _logger->error("Failed to save PFEIFFER data: {}", err.what());
+        }
+    }
+
+    // Saves and closes the file of the connection and, if there is a
+    // migrator, queues it for the archive
+    void _release_files() {
+        if (!_pfeiffer_file) {
+            return;
+        }
+
+        _save_files();
+        const auto name = _pfeiffer_file->getFileName();
+        _pfeiffer_file.reset();
+        if (_slowdaq_doe.Migrator && !name.empty()) {
+            _slowdaq_doe.Migrator->submit(name, _slowdaq_doe.RunDir);
+        }
+    }
+
     void PFEIFFER_update() {
         static auto retrieve_time = _slowdaq_doe.PFEIFFERSingleGaugeUpdateSpeed ==
         PFEIFFERSingleGaugeSP::SLOW ? 60*1000 : _slowdaq_doe.PFEIFFERSingleGaugeUpdateSpeed ==
@@ -248,15 +284,7 @@ class SlowDAQManager : public ThreadManager<Pipes> {
         static auto save_files = make_total_timed_event(
             std::chrono::seconds(30),
             [&](){
-                _logger->info("Saving PFEIFFER data...");
-
-                _pfeiffer_file->async_save([](const PFEIFFERSingleGaugeData& data) {
-                    std::ostringstream out;
-                    out.precision(4);
-                    out << std::scientific;
-                    out << data.Pressure;
-                    return std::to_string(data.time) + "," + out.str() + "\n";
-                });
+                _save_files();
         });
 
         retrieve_press_nb();
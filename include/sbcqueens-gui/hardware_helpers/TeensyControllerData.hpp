@@ -5,6 +5,9 @@
 // C STD includes
 // C 3rd party includes
 // C++ std includes
+#include <memory>
+#include <string>
+
 // C++ 3rd party includes
 // my includes
 #include "sbcqueens-gui/multithreading_helpers/Pipe.hpp"
@@ -14,6 +17,9 @@
 
 namespace SBCQueens {
 
+// Moves completed files to the archive, see file_migrator.hpp
+class FileMigrator;
+
 enum class TeensyControllerStates {
     Standby,
     AttemptConnection,
@@ -162,6 +168,8 @@ struct TeensyControllerPipeEnd : public PipeEnd<TPipe, Type> {
 // So far, I do not like teensy_serial is here.
 struct TeensyControllerData {
     std::string RunDir      = "";
+    // If set, the files of a connection are archived once it ends
+    std::shared_ptr<FileMigrator> Migrator;
 
     std::string Port        = "COM4";
 
@@ -58,8 +58,10 @@ using json = nlohmann::json;
 #include "sbcqueens-gui/imgui_helpers.hpp"
 #include "sbcqueens-gui/implot_helpers.hpp"
 #include "sbcqueens-gui/file_helpers.hpp"
+#include "sbcqueens-gui/binary_file_helpers.hpp"
 #include "sbcqueens-gui/timing_events.hpp"
 #include "sbcqueens-gui/armadillo_helpers.hpp"
+#include "sbcqueens-gui/file_migrator.hpp"
 
 #include "sbcqueens-gui/hardware_helpers/TeensyControllerData.hpp"
 
@@ -178,10 +180,19 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
     double _init_time;
 
     std::string _run_name     = "";
-    std::shared_ptr<DataFile<Peltiers>> _peltiers_file;
-    std::shared_ptr<DataFile<Pressures>> _pressures_file;
-    std::shared_ptr<DataFile<RawRTDs>> _RTDs_file;
-    std::shared_ptr<DataFile<BMEs>> _BMEs_file;
+    // Columns: time, current
+    using PeltiersFile = BinaryDataFile<Peltiers, double, double>;
+    // Columns: time, registers, resistances, temperatures
+    using RTDsFile = BinaryDataFile<RawRTDs, double, uint16_t, double, double>;
+    // Columns: time, pressure
+    using PressuresFile = BinaryDataFile<Pressures, double, double>;
+    // Columns: time, temperature, pressure, humidity
+    using BMEsFile = BinaryDataFile<BMEs, double, double, double, double>;
+
+    std::shared_ptr<PeltiersFile> _peltiers_file;
+    std::shared_ptr<PressuresFile> _pressures_file;
+    std::shared_ptr<RTDsFile> _RTDs_file;
+    std::shared_ptr<BMEsFile> _BMEs_file;
 
     serial_ptr _port;
 
@@ -252,6 +263,7 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
                         "Teensy with port {}", _doe.Port);
 
                     disconnect(_port);
+                    _release_files();
 
                     // Move to standby
                     _doe.CurrentState
@@ -287,28 +299,32 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
                                 + "/" + _run_name);
 
                             // Open files to start saving!
-                            _pressures_file = std::make_shared<DataFile<Pressures>>(
+                            _pressures_file = std::make_shared<PressuresFile>(
                                 _doe.RunDir
                                 + "/" + _run_name
-                                + "/Pressures.txt");
+                                + "/Pressures.bin",
+                                std::array<std::string, 2>{"time", "pressure"});
                             bool s = _pressures_file->isOpen();
 
-                            _RTDs_file = std::make_shared<DataFile<RawRTDs>>(
+                            _RTDs_file = std::make_shared<RTDsFile>(
                                 _doe.RunDir
                                 + "/" + _run_name
-                                + "/RTDs.txt");
+                                + "/RTDs.bin",
+                                std::array<std::string, 4>{"time", "rtd_regs", "resistances", "temperatures"});
                             s = _RTDs_file->isOpen() && s;
 
-                            _peltiers_file = std::make_shared<DataFile<Peltiers>>(
+                            _peltiers_file = std::make_shared<PeltiersFile>(
                                 _doe.RunDir
                                 + "/" + _run_name
-                                + "/Peltiers.txt");
+                                + "/Peltiers.bin",
+                                std::array<std::string, 2>{"time", "current"});
                             s = _peltiers_file->isOpen() && s;
 
-                            _BMEs_file = std::make_shared<DataFile<BMEs>>(
+                            _BMEs_file = std::make_shared<BMEsFile>(
                                 _doe.RunDir
                                 + "/" + _run_name
-                                + "/BMEs.txt");
+                                + "/BMEs.bin",
+                                std::array<std::string, 4>{"time", "temperature", "pressure", "humidity"});
                             s = _BMEs_file->isOpen() && s;
 
 
@@ -345,6 +361,7 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
                 case TeensyControllerStates::Closing:
                     _logger->info("Going to close the Teensy thread.");
                     disconnect(_port);
+                    _release_files();
                     return false;
 
                 default:
@@ -553,6 +570,64 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
         });
     }
 
+    // Writes everything queued
+    void _save_files() {
+        _logger->info("Saving teensy data...");
+
+        try {
+            _RTDs_file->save([](RawRTDs& rtds) {
+                return std::make_tuple(std::span<double>(&rtds.time, 1),
+                                       std::span<uint16_t>(rtds.RTDREGS),
+                                       std::span<double>(rtds.Resistances),
+                                       std::span<double>(rtds.Temps));
+            });
+
+            if (!_doe.SystemParameters.InRTDOnlyMode) {
+                _peltiers_file->save([](Peltiers& pid) {
+                    return std::make_tuple(std::span<double>(&pid.time, 1),
+                                           std::span<double>(&pid.PID.Current, 1));
+                });
+
+                _pressures_file->save([](Pressures& press) {
+                    return std::make_tuple(std::span<double>(&press.time, 1),
+                        std::span<double>(&press.Vacuum.Pressure, 1));
+                });
+
+                _BMEs_file->save([](BMEs& bme) {
+                    return std::make_tuple(std::span<double>(&bme.time, 1),
+                        std::span<double>(&bme.LocalBME.Temperature, 1),
+                        std::span<double>(&bme.LocalBME.Pressure, 1),
+                        std::span<double>(&bme.LocalBME.Humidity, 1));
+                });
+            }
+        } catch (const std::exception& err) {
+            _logger->error("Failed to save teensy data: {}", err.what());
+        }
+    }
+
+    // Saves and closes the files of the connection and, if there is a
+    // migrator, queues them for the archive
+    void _release_files() {
+        if (!_RTDs_file) {
+            return;
+        }
+
+        _save_files();
+        const std::vector<std::string> names = {_RTDs_file->getFileName(),
+            _peltiers_file->getFileName(), _pressures_file->getFileName(),
+            _BMEs_file->getFileName()};
+        _RTDs_file.reset();
+        _peltiers_file.reset();
+        _pressures_file.reset();
+        _BMEs_file.reset();
+
+        for (const auto& name : names) {
+            if (_doe.Migrator && !name.empty()) {
+                _doe.Migrator->submit(name, _doe.RunDir);
+            }
+        }
+    }
+
     // It continuosly polls the Teensy for the latest data and saves it
     // to the file and updates the GUI graphs
     void update() {
@@ -590,57 +665,12 @@ class TeensyControllerManager : public ThreadManager<Pipes> {
         //         retrieve_bmes();
         // });
 
-        // This looks intimidating but it is actually pretty simple once
-        // broken down. First, by make_total_timed_event it is going to call
-        // every 60 seconds the lambda that has been passed to it.
-        // Inside this lambda, there are two functions: async_save but twice
-        // One for PIDs, other for BMEs
+        // Every 30 seconds the queued values are written as binary lines,
+        // one typed column per value. Readable with the SBC binary readers.
         static auto save_files = make_total_timed_event(
             std::chrono::seconds(30),
             [&]() {
-                _logger->info("Saving teensy data...");
-
-                _RTDs_file->async_save([](const RawRTDs& rtds) {
-                    std::ostringstream out;
-                    for (std::size_t i = 0; i < rtds.RTDREGS.size(); i++) {
-                        out << rtds.Resistances[i] << ","
-                            << rtds.Temps[i];
-
-                        if (i == rtds.RTDREGS.size() - 1) {
-                            out << '\n';
-                        } else {
-                            out << ',';
-                        }
-                    }
-
-                    return  std::to_string(rtds.time) + "," + out.str();
-                });
-
-
-                if (!_doe.SystemParameters.InRTDOnlyMode){
-                    _peltiers_file->async_save(
-                        [](const Peltiers& pid) {
-                                 return  std::to_string(pid.time) + "," +
-                                         std::to_string(pid.PID.Current) + "\n";
-                        }
-                    );
-
-                    _pressures_file->async_save(
-                        [](const Pressures& press) {
-                             return  std::to_string(press.time) + "," +
-                                     std::to_string(press.Vacuum.Pressure) + "\n";
-                        }
-                    );
-
-                    _BMEs_file->async_save(
-                        [](const BMEs& bme) {
-                             return  std::to_string(bme.time) + "," +
-                                     std::to_string(bme.LocalBME.Temperature) + "," +
-                                     std::to_string(bme.LocalBME.Pressure) + "," +
-                                     std::to_string(bme.LocalBME.Humidity) + "\n";
-                        }
-                    );
-                }
+                _save_files();
             });
 
         // TODO(Hector): add a function that every long time
@@ -0,0 +1,213 @@
+#ifndef SBCBINARYCODEC_H
+#define SBCBINARYCODEC_H
+#pragma once
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+// How a column is stored in the events. It is written in the header next
+// to the type, ex: "sipm_traces;uint16:dzbp;2,500;". Raw columns only
+// have the type.
+enum class ColumnEncoding {
+    Raw,
+    // Delta + zig-zag + bit-packing, see DeltaZigZagCodec
+    DeltaZigZagBitPack,
+    // Not in the events: every row (ex: a channel) is a stream of its own
+    // written in chunks of many events, see BlockWriter
+    ChannelChunked
+};
+
+constexpr std::string_view encoding_to_string(const ColumnEncoding& encoding) {
+    switch (encoding) {
+        case ColumnEncoding::DeltaZigZagBitPack:
+            return "dzbp";
+        case ColumnEncoding::ChannelChunked:
+            return "chunked";
+        case ColumnEncoding::Raw:
+        default:
+            return "";
+    }
+}
+
+// Throws if the encoding is unknown
+inline ColumnEncoding encoding_from_string(std::string_view encoding) {
+    if (encoding.empty() or encoding == "raw") {
+        return ColumnEncoding::Raw;
+    } else if (encoding == "dzbp") {
+        return ColumnEncoding::DeltaZigZagBitPack;
+    } else if (encoding == "chunked") {
+        return ColumnEncoding::ChannelChunked;
+    }
+
+    throw std::runtime_error("Unknown column encoding " + std::string(encoding));
+}
+
+/* Lossless codec for uint16 waveforms ("dzbp").
+ * Every row (last dimension of the column, a channel for sipm_traces) is
+ * encoded on its own:
+ * 1.- Delta with the previous sample, the first one with 0. Wraps around.
+ * 2.- Zig-zag, so small negative deltas become small numbers.
+ * 3.- Blocks of 128 values are bit-packed with the bit width of their
+ * largest value: 1 byte with the width b, then b groups of 8 uint16.
+ * Value j of a block goes to lane j % 8 of the groups, so the 8 lanes are
+ * unpacked with the same shifts and the decode loop is vectorized by the
+ * compiler. The last block of a row is padded with zeros.
+*/
+struct DeltaZigZagCodec {
+    constexpr static std::size_t kLanes = 8;
+    constexpr static std::size_t kBlockSize = 128;
+    constexpr static std::size_t kValuesPerLane = kBlockSize / kLanes;
+    constexpr static std::size_t kMaxBlockBytes = 1 + 16*kLanes*sizeof(uint16_t);
+
+    static std::size_t max_encoded_size(const std::size_t& length,
+                                        const std::size_t& row_length) {
+        if (row_length == 0) {
+            return 0;
+        }
+
+        const std::size_t blocks_per_row = (row_length + kBlockSize - 1) / kBlockSize;
+        return (length / row_length)*blocks_per_row*kMaxBlockBytes;
+    }
+
+    // Encodes in into out, which must be max_encoded_size() bytes long.
+    // Returns the number of bytes used.
+    static std::size_t encode(std::span<const uint16_t> in, const std::size_t& row_length,
+                              char* out) {
+        _check_rows(in.size(), row_length);
+
+        char* pos = out;
+        for (std::size_t row = 0; row < in.size(); row += row_length) {
+            uint16_t previous = 0;
+            for (std::size_t start = 0; start < row_length; start += kBlockSize) {
+                std::array<uint16_t, kBlockSize> values = {};
+                const std::size_t count = std::min(kBlockSize, row_length - start);
+                uint16_t max_value = 0;
+                for (std::size_t j = 0; j < count; j++) {
+                    const uint16_t sample = in[row + start + j];
+                    const auto delta = static_cast<int16_t>(sample - previous);
+                    values[j] = static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+                    max_value |= values[j];
+                    previous = sample;
+                }
+
+                pos += _pack_block(values, static_cast<uint8_t>(std::bit_width(max_value)), pos);
+            }
+        }
+
+        return static_cast<std::size_t>(pos - out);
+    }
+
+    // Decodes in into out. Throws if in is not the encoding of exactly
+    // out.size() values.
+    static void decode(std::string_view in, const std::size_t& row_length,
+                       std::span<uint16_t> out) {
+        _check_rows(out.size(), row_length);
+
+        std::size_t pos = 0;
+        for (std::size_t row = 0; row < out.size(); row += row_length) {
+            uint16_t previous = 0;
+            for (std::size_t start = 0; start < row_length; start += kBlockSize) {
+                std::array<uint16_t, kBlockSize> values;
+                pos += _unpack_block(in.substr(std::min(pos, in.size())), values);
+
+                const std::size_t count = std::min(kBlockSize, row_length - start);
+                for (std::size_t j = 0; j < count; j++) {
+                    const auto delta = static_cast<uint16_t>((values[j] >> 1)
+                        ^ (0 - (values[j] & 1)));
+                    previous = static_cast<uint16_t>(previous + delta);
+                    out[row + start + j] = previous;
+                }
+            }
+        }
+
+        if (pos != in.size()) {
+            throw std::runtime_error("Encoded column is longer than expected");
+        }
+    }
+
+ private:
+    using Lanes = std::array<uint16_t, kLanes>;
+
+    static void _check_rows(const std::size_t& length, const std::size_t& row_length) {
+        if (row_length == 0 or length % row_length != 0) {
+            throw std::invalid_argument("Column length is not a multiple of its rows");
+        }
+    }
+
+    static std::size_t _pack_block(const std::array<uint16_t, kBlockSize>& values,
+                                   const uint8_t& width, char* out) {
+        std::array<Lanes, 16> words = {};
+        for (std::size_t k = 0; k < kValuesPerLane and width > 0; k++) {
+            const std::size_t bit = k*width;
+            const std::size_t word = bit / 16;
+            const std::size_t shift = bit % 16;
+            for (std::size_t lane = 0; lane < kLanes; lane++) {
+                const uint32_t value = values[k*kLanes + lane];
+                words[word][lane] |= static_cast<uint16_t>(value << shift);
+                if (shift + width > 16) {
+                    words[word + 1][lane] |= static_cast<uint16_t>(value >> (16 - shift));
+                }
+            }
+        }
+
+        out[0] = static_cast<char>(width);
+        std::memcpy(out + 1, words.data(), width*sizeof(Lanes));
+        return 1 + width*sizeof(Lanes);
+    }
+
+    // Returns the number of bytes read from in
+    static std::size_t _unpack_block(std::string_view in,
+                                     std::array<uint16_t, kBlockSize>& values) {
+        if (in.empty()) {
+            throw std::runtime_error("Encoded column is shorter than expected");
+        }
+
+        const auto width = static_cast<uint8_t>(in[0]);
+        const std::size_t size = 1 + width*sizeof(Lanes);
+        if (width > 16 or in.size() < size) {
+            throw std::runtime_error("Encoded column is corrupted");
+        }
+
+        std::array<Lanes, 16> words;
+        std::memcpy(words.data(), in.data() + 1, width*sizeof(Lanes));
+
+        values.fill(0);
+        const uint32_t mask = (uint32_t{1} << width) - 1;
+        for (std::size_t k = 0; k < kValuesPerLane and width > 0; k++) {
+            const std::size_t bit = k*width;
+            const std::size_t word = bit / 16;
+            const std::size_t shift = bit % 16;
+            const bool spills = shift + width > 16;
+            // Same shifts for every lane
+            for (std::size_t lane = 0; lane < kLanes; lane++) {
+                uint32_t value = words[word][lane] >> shift;
+                if (spills) {
+                    value |= uint32_t{words[word + 1][lane]} << (16 - shift);
+                }
+                values[k*kLanes + lane] = static_cast<uint16_t>(value & mask);
+            }
+        }
+
+        return size;
+    }
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -10,24 +10,47 @@
 #pragma once
 
 // C STD includes
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 // C 3rd party includes
 // C++ STD includes
 #include <bit>
 #include <cinttypes>
+#include <cstring>
+#include <new>
 #include <numeric>
+#include <span>
+#include <string_view>
+#include <vector>
 #include <fstream>
 #include <type_traits>
 #include <filesystem>
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
 
 // C++ 3rd party includes
 #include <concurrentqueue.h>
+#include <readerwriterqueue.h>
 #include <spdlog/spdlog.h>
 
 // my includes
 #include "sbcqueens-gui/file_helpers.hpp"
 #include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryCodec.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCChecksum.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCFileSink.hpp"
 
 namespace SBCQueens::BinaryFormat {
 namespace Tools {
@@ -81,8 +104,287 @@ namespace Tools {
         // TODO(All): maybe the default should be uint32? or no default?
     }
 
+    // Returns false if file_name does not exist or is empty, and true if
+    // it starts with header. Only the first compare_size bytes of header
+    // are compared. Throws if the header is different.
+    inline bool check_header(const std::string& file_name,
+                             const std::string& header,
+                             const std::size_t& compare_size) {
+        if (not std::filesystem::exists(file_name)
+            or std::filesystem::is_empty(file_name)) {
+            return false;
+        }
+
+        std::ifstream peeker(file_name, std::ofstream::binary);
+
+        std::string current_file_header(compare_size, '\0');
+        peeker.seekg(0);
+        peeker.read(&current_file_header[0], static_cast<std::streamsize>(compare_size));
+
+        if (current_file_header != header.substr(0, compare_size)) {
+            throw std::runtime_error("File being written to has an "
+                                     "incompatible header format. "
+                                     "Details:\n\t File = " + file_name);
+        }
+
+        return true;
+    }
+
+    // Opens file_name to write at its end. If the file does not exist or is
+    // empty, header is written first. If it exists, its header must be
+    // header or it throws. The last count_size bytes of the header are
+    // the number of records, which is patched when the file is closed, so
+    // they are not compared and are set to 0 (unknown) until then.
+    // Returns true if the file is open.
+    inline bool open_or_check_header(std::fstream& stream,
+                                     const std::string& file_name,
+                                     const std::string& header,
+                                     const std::size_t& count_size) {
+        const std::size_t count_offset = header.size() - count_size;
+        if (check_header(file_name, header, count_offset)) {
+            stream.open(file_name, std::ios::in | std::ios::out | std::ofstream::binary);
+            if (not stream.is_open()) {
+                return false;
+            }
+
+            stream.seekp(static_cast<std::streamoff>(count_offset));
+            stream.write(header.data() + count_offset,
+                         static_cast<std::streamsize>(count_size));
+            stream.seekp(0, std::ios::end);
+            return true;
+        }
+
+        // If file is empty or does not exist, then we
+        // open it and write to it.
+        stream.open(file_name, std::ios::out | std::ofstream::binary);
+        if (not stream.is_open()) {
+            return false;
+        }
+
+        stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+        return true;
+    }
+
+    // Overwrites the record count at offset and goes back to where the
+    // stream was.
+    template<typename T>
+    void patch_count(std::fstream& stream, const std::size_t& offset, const T& count) {
+        const auto position = stream.tellp();
+        stream.seekp(static_cast<std::streamoff>(offset));
+        stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        stream.seekp(position);
+    }
+
+    // Reserves size bytes of disk for file_name without changing its size,
+    // so it is written in large contiguous extents. Returns false if the
+    // OS or the file system does not support it.
+    inline bool preallocate_file(const std::string& file_name, const uint64_t& size) {
+#if defined(__linux__)
+        int fd = ::open(file_name.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        bool ok = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == 0;
+        ::close(fd);
+        return ok;
+#elif defined(__APPLE__)
+        int fd = ::open(file_name.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0,
+                          static_cast<off_t>(size), 0};
+        bool ok = ::fcntl(fd, F_PREALLOCATE, &store) != -1;
+        if (not ok) {
+            store.fst_flags = F_ALLOCATEALL;
+            ok = ::fcntl(fd, F_PREALLOCATE, &store) != -1;
+        }
+        ::close(fd);
+        return ok;
+#else
+        static_cast<void>(file_name);
+        static_cast<void>(size);
+        return false;
+#endif
+    }
+
+    // Truncates file_name to size and gives back the disk reserved by
+    // preallocate_file(file_name, reserved) past it.
+    inline void release_preallocation(const std::string& file_name, const uint64_t& size,
+                                      const uint64_t& reserved) {
+        std::error_code err;
+        std::filesystem::resize_file(file_name, size, err);
+#if defined(__linux__)
+        // Some file systems keep the blocks past the end of the file
+        // if the size did not change.
+        int fd = ::open(file_name.c_str(), O_WRONLY);
+        if (fd >= 0 and reserved > size) {
+            ::fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                        static_cast<off_t>(size), static_cast<off_t>(reserved - size));
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#else
+        static_cast<void>(reserved);
+#endif
+    }
+
+    // File seq of a rotated sequence: "name.bin" -> "name_{seq:04d}.bin"
+    inline std::string sequenced_file_name(const std::string& base_name, const uint32_t& seq) {
+        const auto path = std::filesystem::path(base_name);
+        const auto name = fmt::format("{}_{:04d}{}", path.stem().string(), seq,
+                                      path.extension().string());
+        return (path.parent_path() / name).string();
+    }
+
 } // namespace Tools
 
+// Byte layout of a record (line) made of the columns DataTypes. The offset
+// and length of each column are computed once at construction so packing
+// a record is a single memcpy per column.
+// Only the last column can be encoded (and only if it is uint16), so the
+// others keep a fixed offset and the record size varies.
+template<typename... DataTypes>
+requires Tools::is_arithmetic_ptr_unpack<DataTypes...>
+class RecordLayout {
+ public:
+    using tuple_type = std::tuple<std::span<DataTypes>...>;
+    constexpr static std::size_t n_cols = sizeof...(DataTypes);
+    constexpr static std::array<std::size_t, n_cols> size_of_types = { sizeof(DataTypes)... };
+    constexpr static std::array<std::string_view, n_cols> parameters_types_str = { Tools::type_to_string<DataTypes>()... };
+    constexpr static std::array<bool, n_cols> is_uint16 = {
+        std::is_same_v<std::remove_cvref_t<DataTypes>, uint16_t>... };
+
+ private:
+    const std::array<std::string, n_cols> _names;
+    const std::array<std::size_t, n_cols> _ranks;
+    const std::vector<std::size_t> _sizes;
+    const std::array<ColumnEncoding, n_cols> _encodings;
+
+    std::array<std::size_t, n_cols> _offsets = {};
+    std::array<std::size_t, n_cols> _lengths = {};
+    // Size of the last dimension
+    std::array<std::size_t, n_cols> _row_lengths = {};
+    std::size_t _byte_size = 0;
+
+    template<std::size_t i>
+    std::size_t _pack_item(char* out, const tuple_type& items) const {
+        const auto& item = std::get<i>(items);
+
+        if (_lengths[i] != item.size()) {
+            throw std::out_of_range("memory is out of range");
+        }
+
+        // Saved apart by the writer
+        if (_encodings[i] == ColumnEncoding::ChannelChunked) {
+            return 0;
+        }
+
+        if constexpr (is_uint16[i]) {
+            if (_encodings[i] == ColumnEncoding::DeltaZigZagBitPack) {
+                return DeltaZigZagCodec::encode(item, _row_lengths[i], out + _offsets[i]);
+            }
+        }
+
+        std::memcpy(out + _offsets[i], item.data(), item.size_bytes());
+        return item.size_bytes();
+    }
+
+    template<std::size_t... I>
+    std::size_t _pack_helper(char* out, const tuple_type& items, std::index_sequence<I...>) const {
+        std::array<std::size_t, n_cols> bytes = {_pack_item<I>(out, items)...};
+        return _offsets.back() + bytes.back();
+    }
+
+ public:
+    RecordLayout(const std::array<std::string, n_cols>& columns_names,
+                 const std::array<std::size_t, n_cols>& columns_ranks,
+                 const std::vector<std::size_t>& columns_sizes,
+                 const std::array<ColumnEncoding, n_cols>& columns_encodings = {}) :
+        _names{columns_names},
+        _ranks{columns_ranks},
+        _sizes{columns_sizes},
+        _encodings{columns_encodings}
+    {
+        std::size_t total_ranks_so_far = 0;
+        for (std::size_t i = 0; i < n_cols; i++) {
+            if (_encodings[i] != ColumnEncoding::Raw
+                and (i != n_cols - 1 or not is_uint16[i])) {
+                throw std::invalid_argument("Only the last column can be encoded "
+                                            "and only if it is uint16");
+            }
+
+            _lengths[i] = std::accumulate(_sizes.begin() + total_ranks_so_far,
+                                          _sizes.begin() + total_ranks_so_far + _ranks[i],
+                                          std::size_t{1},
+                                          std::multiplies<std::size_t>());
+            _row_lengths[i] = _ranks[i] > 0 ? _sizes[total_ranks_so_far + _ranks[i] - 1] : 1;
+            _offsets[i] = _byte_size;
+            if (_encodings[i] != ColumnEncoding::ChannelChunked) {
+                _byte_size += size_of_types[i]*_lengths[i];
+            }
+            total_ranks_so_far += _ranks[i];
+        }
+    }
+
+    // Size in bytes of a record without encoding
+    std::size_t size() const { return _byte_size; }
+
+    // True if the size of the records changes
+    bool isEncoded() const { return _encodings.back() == ColumnEncoding::DeltaZigZagBitPack; }
+
+    // True if the last column is saved by rows apart from the records
+    bool isChunked() const { return _encodings.back() == ColumnEncoding::ChannelChunked; }
+
+    const std::array<std::string, n_cols>& names() const { return _names; }
+
+    // Rows of the last column (ex: channels) and their length
+    std::size_t num_rows() const { return _lengths.back() / _row_lengths.back(); }
+    std::size_t row_length() const { return _row_lengths.back(); }
+
+    // Largest size in bytes a record can take
+    std::size_t max_size() const {
+        if (not isEncoded()) {
+            return _byte_size;
+        }
+
+        return _offsets.back()
+            + DeltaZigZagCodec::max_encoded_size(_lengths.back(), _row_lengths.back());
+    }
+
+    // The record description in the form "{name_col};{type_col};{size1},{size2}...;"
+    std::string schema() const {
+        std::string out;
+        std::size_t total_ranks_so_far = 0;
+        for (std::size_t i = 0; i < n_cols; i++) {
+            out += _names[i] + ";";
+            out += std::string(parameters_types_str[i]);
+            if (_encodings[i] != ColumnEncoding::Raw) {
+                out += ":" + std::string(encoding_to_string(_encodings[i]));
+            }
+            out += ";";
+            for (std::size_t j = 0; j < _ranks[i]; j++) {
+                out += std::to_string(_sizes[total_ranks_so_far + j]);
+                out += j != _ranks[i] - 1 ? "," : ";";
+            }
+
+            total_ranks_so_far += _ranks[i];
+        }
+
+        return out;
+    }
+
+    // Copies data into out which must be at least max_size() bytes long.
+    // Returns the size of the record. Throws if any of the columns does not
+    // have the expected length.
+    std::size_t pack(char* out, std::span<DataTypes>... data) const {
+        return _pack_helper(out, std::make_tuple(data...), std::make_index_sequence<n_cols>{});
+    }
+};
+
 /*  SBC Binary Header description:
  * Header of a binary format is divided in 4 parts:
  * 1.- Edianess            - always 4 bits long (uint32_t)
@@ -93,7 +395,9 @@ namespace Tools {
  * string in the form "{name_col};{type_col};{size1},{size2}...;...;
  * Cannot be longer than 65536 bytes.
  * 4.- Number of lines     - always 4 bits long (int32_t)
- * Number of lines in the file. If 0, it is indefinitely long.
+ * Number of lines in the file. Written when the file is closed, so if 0
+ * the file is still being written (or was not closed) and its length
+ * is what fits in the file.
 */
 template<typename... DataTypes>
 requires Tools::is_arithmetic_ptr_unpack<DataTypes...>
@@ -102,45 +406,21 @@ struct DynamicWriter {
     //  - and their corresponding array types Ex: int and int[]
     //  - that is to assume that if int is passed, it mean we want a scalar
     //  - and int[] would mean an array.
-    using tuple_type = std::tuple<std::span<DataTypes>...>;
+    using layout_type = RecordLayout<DataTypes...>;
     constexpr static std::size_t n_cols = sizeof...(DataTypes);
-    constexpr static std::array<std::size_t, n_cols> size_of_types = { sizeof(DataTypes)... };
-    constexpr static std::array<std::string_view, n_cols> parameters_types_str = { Tools::type_to_string<DataTypes>()... };
+    constexpr static std::array<std::size_t, n_cols> size_of_types = layout_type::size_of_types;
+    constexpr static std::array<std::string_view, n_cols> parameters_types_str = layout_type::parameters_types_str;
 
  private:
     const std::string _file_name;
-    const std::array<std::string, n_cols> _names;
-    const std::array<std::size_t, n_cols> _ranks;
-    const std::vector<std::size_t> _sizes;
+    const layout_type _layout;
 
-    std::size_t total_ranks = 0;
     bool _open = false;
     std::fstream _stream;
+    std::size_t _header_size = 0;
+    uint64_t _num_lines = 0;
 
-    std::size_t _line_byte_size = 0;
-    std::size_t _line_param_order = 0;
-    std::size_t _line_buffer_loc = 0;
-    std::string _line_buffer;
-
-    template<typename T>
-    void _copy_number_to_buff(const T& num,
-                              std::string& buffer,
-                              std::size_t& loc,
-                              const std::size_t& size = sizeof(T)) {
-        const char* tmpstr = reinterpret_cast<const char*>(&num);
-        for(std::size_t i = 0; i < size; i++) {
-            buffer[i + loc] = tmpstr[i];
-        }
-
-        loc += size;
-    }
-
-    void _copy_str_to_buff(std::string_view source,
-                           std::string& buffer,
-                           std::size_t& loc) {
-        source.copy(&buffer[loc], source.length(), 0);
-        loc += source.length();
-    }
+    AlignedBuffer _line_buffer;
 
     std::string _build_header() {
         // Edianess first
@@ -151,169 +431,62 @@ struct DynamicWriter {
             endianess = 0x01020304;
         }
 
-        // calculates
-        std::size_t total_header_size = 0;
         // has to be uint16_t because we are saving it to the file later
+        const std::string data_header = _layout.schema();
+        const auto binary_header_size = static_cast<uint16_t>(data_header.length());
 
-        uint16_t binary_header_size = 0;
-        std::size_t total_ranks_so_far = 0;
-        for (std::size_t i = 0; i < n_cols; i++) {
-            auto column_rank = _ranks[i];
-            // + 1 for the ; character
-            binary_header_size += _names[i].length() + 1;
-            // + 1 for the ; character
-            binary_header_size += parameters_types_str[i].length() + 1;
-
-            std::size_t total_rank_size = 1;
-            for(std::size_t j = 0; j < column_rank; j ++) {
-                auto size = _sizes[total_ranks_so_far + j];
-                total_rank_size *= size;
-                // It is always + 1 because there is either a ',' or a ';'
-                binary_header_size += std::to_string(size).length() + 1;
-            }
-
-            total_ranks_so_far += column_rank;
-            _line_byte_size += size_of_types[i]*total_rank_size;
-        }
-
-        // We also calculate the line size very useful when we start data saving
-        total_header_size += sizeof(uint32_t); // 1.
-        total_header_size += sizeof(uint16_t); // 2.
-        total_header_size += binary_header_size; // 3.
-        total_header_size += sizeof(int32_t); // 4.
-
-        // Now we allocate the memory!
-        std::size_t buffer_loc = 0;
-        auto buffer = std::string(total_header_size, 'A');
-        _line_buffer = std::string(_line_byte_size, 'A');
-
-        // Now we fill buffer.
-        total_ranks_so_far = 0;
-        _copy_number_to_buff(endianess, buffer, buffer_loc); // 1.
-        _copy_number_to_buff(binary_header_size, buffer, buffer_loc); // 2.
-        for (std::size_t i = 0; i < n_cols; i++) { // 3.
-            auto column_name = _names[i];
-            auto column_type = parameters_types_str[i];
-            auto column_rank = _ranks[i];
-
-            _copy_str_to_buff(column_name, buffer, buffer_loc);
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            _copy_str_to_buff(column_type, buffer, buffer_loc);
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            for(std::size_t size_j = 0; size_j < column_rank; size_j++) {
-                _copy_str_to_buff(std::to_string(_sizes[total_ranks_so_far + size_j]),
-                                  buffer, buffer_loc);
-
-                if(size_j != column_rank - 1) {
-                    _copy_str_to_buff(",", buffer, buffer_loc);
-                }
-            }
-
-            _copy_str_to_buff(";", buffer, buffer_loc);
-            total_ranks_so_far += column_rank;
-        }
+        std::string buffer;
+        buffer.append(reinterpret_cast<const char*>(&endianess), sizeof(endianess)); // 1.
+        buffer.append(reinterpret_cast<const char*>(&binary_header_size),
+                      sizeof(binary_header_size)); // 2.
+        buffer += data_header; // 3.
 
-        // For dynamic files, this is always 0!
+        // Unknown until the file is closed
         const int32_t num_lines = 0x00000000;
-        _copy_number_to_buff(num_lines, buffer, buffer_loc); // 4.
+        buffer.append(reinterpret_cast<const char*>(&num_lines), sizeof(num_lines)); // 4.
         // Done!
         return buffer;
     }
 
-    // Save item from tuple in position i
-    template<std::size_t i>
-    void _save_item(const tuple_type& items, std::size_t& loc) {
-        auto item = std::get<i>(items);
-
-        auto rank = _ranks[i];
-        auto total_rank_up_to_i = std::accumulate(_ranks.begin(),
-                                                  &_ranks[i],
-                                                  0);
-
-        const auto& size_index_start = total_rank_up_to_i;
-        const std::size_t expected_size = std::accumulate(&_sizes[size_index_start],
-                                                 &_sizes[size_index_start + rank],
-                                                 1,
-                                                std::multiplies<std::size_t>());
-
-        if (expected_size != item.size()) {
-            throw std::out_of_range("memory is out of range");
-        }
-
-//        std::memcpy(&_line_buffer[loc], item.data(), item.size_bytes());
-        auto item_bytes =  std::as_bytes(item);
-        for(std::size_t byte = 0; byte < item.size_bytes(); byte++) {
-            _line_buffer.at(loc + byte) = static_cast<char>(item_bytes[byte]);
-        }
-        loc += item.size_bytes();
-    }
-
-    // Think of t his function as a wrapper between _save_item
-    // and _save_data
-    template<std::size_t... I>
-    void _save_item_helper(const tuple_type& data, std::index_sequence<I...>) {
-        (_save_item<I>(data, _line_buffer_loc),...);
-    }
-
-    void _save_event(const tuple_type& data) {
-        _line_buffer_loc = 0;
-        _save_item_helper(data, std::make_index_sequence<n_cols>{});
-        _stream << _line_buffer;
-    }
-
  public:
     DynamicWriter(std::string_view file_name,
                   const std::array<std::string, n_cols>& columns_names,
                   const std::array<std::size_t, n_cols>& columns_ranks,
                   const std::vector<std::size_t>& columns_sizes) :
         _file_name{file_name},
-        _names{columns_names},
-        _ranks{columns_ranks},
-        _sizes{columns_sizes}
+        _layout{columns_names, columns_ranks, columns_sizes},
+        _line_buffer{_layout.size()}
     {
-        total_ranks = std::accumulate(columns_ranks.begin(),
-                                      columns_ranks.end(), 0);
-
-        if (std::filesystem::exists(file_name)) {
-            if (std::filesystem::is_empty(file_name)) {
-                // If file is empty or does not exist, then we
-                // open it and write to it.
-                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-                if (_stream.is_open()) {
-                    _open = true;
-                    _stream << _build_header();
-                }
-            } else {
-                std::ifstream peeker(_file_name, std::ofstream::binary);
-
-                std::string header = _build_header();
-                std::string current_file_header(header.length(), '\0');
-                peeker.seekg(0);
-                peeker.read(&current_file_header[0], header.length());
-
-                if (current_file_header != header) {
-                    throw std::runtime_error("File being written to has an "
-                                             "incompatible header format. "
-                                             "Details:\n\t File = " + _file_name);
-                }
-
-                // We do not write anything.
-                _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-                _open = _stream.is_open();
+        const auto header = _build_header();
+        _header_size = header.size();
+
+        // A partial line at the end (ex: after a crash) is removed so the
+        // new lines stay aligned
+        if (_layout.size() > 0 and Tools::check_header(_file_name, header,
+                                                       _header_size - sizeof(int32_t))) {
+            const uint64_t file_size = std::filesystem::file_size(_file_name);
+            const uint64_t lines = file_size > _header_size ?
+                (file_size - _header_size) / _layout.size() : 0;
+            std::filesystem::resize_file(_file_name, _header_size + lines*_layout.size());
+        }
 
-            }
-        } else {
-            _stream.open(_file_name, std::ios::app | std::ofstream::binary);
-            if (_stream.is_open()) {
-                _open = true;
-                _stream << _build_header();
-            }
+        _open = Tools::open_or_check_header(_stream, _file_name, header,
+                                            sizeof(int32_t));
+        // Lines already in the file when appending to it
+        if (_open and _layout.size() > 0) {
+            _num_lines = (static_cast<uint64_t>(_stream.tellp()) - _header_size)
+                / _layout.size();
         }
     }
 
     bool isOpen() { return _open; }
 
     ~DynamicWriter() {
+        if (_open) {
+            Tools::patch_count(_stream, _header_size - sizeof(int32_t),
+                static_cast<int32_t>(std::min<uint64_t>(_num_lines, INT32_MAX)));
+        }
+
         _open = false;
         _stream.flush();
         _stream.close();
@@ -321,172 +494,1886 @@ struct DynamicWriter {
 
     void save(std::span<DataTypes>... data) {
         if(_open) {
-            _save_event(std::make_tuple(data...));
+            _layout.pack(_line_buffer.data(), data...);
+            _stream.write(_line_buffer.data(),
+                          static_cast<std::streamsize>(_layout.size()));
+            _num_lines++;
         }
     }
-};
 
-// TODO(Hector): we need this!
-template<typename... DataTypes>
-struct Reader {
+    // Writes the buffered lines and the current number of lines, so the
+    // file can be read while it is still open
+    void flush() {
+        if (_open) {
+            Tools::patch_count(_stream, _header_size - sizeof(int32_t),
+                static_cast<int32_t>(std::min<uint64_t>(_num_lines, INT32_MAX)));
+            _stream.flush();
+        }
+    }
+};
 
+/*  SBC Binary version 2 description:
+ * Values that do not change between events are not repeated in every
+ * event, they are stored in blocks. The file is:
+ * 1.- Magic               - "SBC2" (4 bytes). Never a valid v1 endianess.
+ * 2.- Edianess            - uint32_t, same as version 1.
+ * 3.- Version             - uint16_t, 2.
+ * 4.- Event Header size   - uint16_t
+ * 5.- Event Header        - structure of each event, same format as the
+ * version 1 data header.
+ * 6.- Number of events    - uint64_t. Written when the file is closed,
+ * if 0 it is unknown.
+ * 7.- Blocks until the end of the file. Each block is:
+ *      Tag (4 chars) | Payload size (uint32_t) | Payload
+ * Known tags:
+ *  "EVNT" - an event with the layout of the event header.
+ *  "CONF" - the run constants: uint16_t header size, the header (same
+ *  format as the event header), and a single line of values.
+ *  Applies to all the events after it.
+ *  "INDX" - the footer written when the file is closed, see EventIndex.
+ *  "TRLR" - always the last 16 bytes of a closed file. Its payload is
+ *  the uint64_t offset of the INDX block.
+ *  "CRCS" - optional checksums of the blocks before it: the uint64_t
+ *  offset of the first block it covers, then the uint32_t CRC32C of
+ *  each block (header + payload) from there on. INDX, TRLR and CRCS
+ *  blocks are not covered.
+ *  "STRM" - declares a stream of records saved next to the events (ex:
+ *  temperatures): uint16_t stream id, uint16_t name size, the name,
+ *  uint16_t header size and the header of its records.
+ *  "SDAT" - a chunk of records of a stream: uint16_t stream id, uint16_t
+ *  0, uint32_t number of records and the records one after the other.
+ * Readers must skip the blocks they do not know. A file without a TRLR
+ * block (e.g. after a crash) can still be read block by block.
+*/
+constexpr static std::array<char, 4> kSBCv2Magic = {'S', 'B', 'C', '2'};
+constexpr static uint16_t kSBCv2Version = 2;
+
+using BlockTag = std::array<char, 4>;
+constexpr static BlockTag kEventBlockTag = {'E', 'V', 'N', 'T'};
+constexpr static BlockTag kConfigBlockTag = {'C', 'O', 'N', 'F'};
+constexpr static BlockTag kIndexBlockTag = {'I', 'N', 'D', 'X'};
+constexpr static BlockTag kTrailerBlockTag = {'T', 'R', 'L', 'R'};
+constexpr static BlockTag kChecksumBlockTag = {'C', 'R', 'C', 'S'};
+constexpr static BlockTag kStreamBlockTag = {'S', 'T', 'R', 'M'};
+constexpr static BlockTag kStreamDataBlockTag = {'S', 'D', 'A', 'T'};
+// Stream id + 0 + number of records
+constexpr static std::size_t kStreamDataHeaderSize = 8;
+// Tag + payload size
+constexpr static std::size_t kBlockHeaderSize = 8;
+constexpr static std::size_t kTrailerSize = kBlockHeaderSize + sizeof(uint64_t);
+
+// Offsets of the blocks of a version 2 file. Its INDX payload is:
+//  uint64_t number of events | uint64_t number of configs |
+//  EventOffsets | EventKeys | ConfigOffsets | ConfigFirstEvents
+// all of them uint64_t arrays. Files with streams add after them:
+//  uint64_t number of streams | uint64_t number of chunks |
+//  StreamOffsets | ChunkOffsets
+struct EventIndex {
+    // Offset of each EVNT block from the start of the file
+    std::vector<uint64_t> EventOffsets;
+    // Sort key of each event, the time stamp for SiPM files
+    std::vector<uint64_t> EventKeys;
+    // Offset of each CONF block
+    std::vector<uint64_t> ConfigOffsets;
+    // Number of events before each CONF block
+    std::vector<uint64_t> ConfigFirstEvents;
+    // Offset of each STRM block, in stream id order
+    std::vector<uint64_t> StreamOffsets;
+    // Offset of each SDAT block
+    std::vector<uint64_t> ChunkOffsets;
+
+    std::size_t payload_size() const {
+        std::size_t size = sizeof(uint64_t)*(2 + 2*EventOffsets.size()
+                                             + 2*ConfigOffsets.size());
+        if (not StreamOffsets.empty()) {
+            size += sizeof(uint64_t)*(2 + StreamOffsets.size() + ChunkOffsets.size());
+        }
+        return size;
+    }
 
+    std::string serialize() const {
+        std::string out(payload_size(), '\0');
+        const uint64_t counts[2] = {EventOffsets.size(), ConfigOffsets.size()};
+        const uint64_t stream_counts[2] = {StreamOffsets.size(), ChunkOffsets.size()};
+        std::vector<std::span<const uint64_t>> sections = {std::span<const uint64_t>(counts),
+            std::span<const uint64_t>(EventOffsets), std::span<const uint64_t>(EventKeys),
+            std::span<const uint64_t>(ConfigOffsets),
+            std::span<const uint64_t>(ConfigFirstEvents)};
+        if (not StreamOffsets.empty()) {
+            sections.insert(sections.end(), {std::span<const uint64_t>(stream_counts),
+                std::span<const uint64_t>(StreamOffsets),
+                std::span<const uint64_t>(ChunkOffsets)});
+        }
 
- private:
-};
+        char* pos = out.data();
+        for (const auto& items : sections) {
+            std::memcpy(pos, items.data(), items.size_bytes());
+            pos += items.size_bytes();
+        }
+        return out;
+    }
 
-class SiPMDynamicWriter {
-    using SiPMDW = DynamicWriter<   double,    // sample rate
-                                    uint8_t,   // Enabled Channels
-                                    uint64_t,  // Trigger Mask
-                                    uint16_t,  // Thresholds
-                                    uint16_t,  // DC Offsets
-                                    uint8_t,   // DC Corrections
-                                    float,     // DC Range
-                                    uint32_t,  // Time stamp
-                                    uint32_t,  // Trigger source
-                                    uint16_t>; // Waveforms
-
-    constexpr static std::size_t num_cols = 10;
-    constexpr static std::array<std::size_t, num_cols> sipm_ranks =
-                                    {1, 1, 1, 1, 1, 1, 1, 1, 1, 2};
-    const inline static std::array<std::string, num_cols> column_names =
-            {"sample_rate", "en_chs", "trg_mask", "thresholds", "dc_offsets",
-             "dc_corrections", "dc_range", "time_stamp", "trg_source", "sipm_traces"};
+    // Returns false if payload is not a valid index.
+    bool parse(std::string_view payload) {
+        uint64_t counts[2];
+        if (payload.size() < sizeof(counts)) {
+            return false;
+        }
 
+        // Bounded first so a corrupted count cannot overflow the sizes
+        const uint64_t max_items = payload.size() / sizeof(uint64_t);
+        std::memcpy(counts, payload.data(), sizeof(counts));
+        if (counts[0] > max_items or counts[1] > max_items) {
+            return false;
+        }
 
-    double _sample_rate[1] = {0.0};
-    std::vector<std::uint8_t> _en_chs;
-    uint64_t _trigger_mask[1] = {0};
-    std::vector<uint16_t> _thresholds;
-    std::vector<uint16_t> _dc_offsets;
-    std::vector<uint8_t> _dc_corrections;
-    std::vector<float> _dc_ranges;
+        const std::size_t events_size = sizeof(uint64_t)*(2 + 2*counts[0] + 2*counts[1]);
+        if (payload.size() < events_size) {
+            return false;
+        }
 
-    uint32_t _trigger_tag[1] = {0};
-    uint32_t _trigger_source[1] = {0};
+        uint64_t stream_counts[2] = {0, 0};
+        if (payload.size() != events_size) {
+            if (payload.size() < events_size + sizeof(stream_counts)) {
+                return false;
+            }
 
-    uint32_t _record_length;
-    SiPMDW _streamer;
- public:
-    /* Details of each parameters:
-    Name          | type      | length (in Bytes) | is a constant?|
-    ---------------------------------------------------------------
-    sample_rate   | double    | 8                 | Y
-    en_chs        | uint8     | 1*ch_size         | Y
-    trg_mask      | uint64    | 8                 | Y
-    thresholds    | uint16    | 2*ch_size         | Y
-    dc_offsets    | uint16    | 2*ch_size         | Y
-    dc_corrections| uint8     | 1*ch_size         | Y
-    dc_range      | single    | 4*ch_size         | Y
-    time_stamp    | uint32    | 4                 | N
-    trg_source    | uint32    | 4                 | N
-    data          | uint16    | 2*rl*ch_size      | N
-    ---------------------------------------------------------------
-    rl -> record length of the waveforms
-    ch_size -> number of enabled channels
-    en_chs  -> the channels # that were enabled
+            std::memcpy(stream_counts, payload.data() + events_size, sizeof(stream_counts));
+            if (stream_counts[0] > max_items or stream_counts[1] > max_items
+                or payload.size() != events_size + sizeof(uint64_t)*(2 + stream_counts[0]
+                                                                  + stream_counts[1])) {
+                return false;
+            }
+        }
 
-    Total length = 24 + ch_size*(10 + 2*record_length)
-    */
+        EventOffsets.resize(counts[0]);
+        EventKeys.resize(counts[0]);
+        ConfigOffsets.resize(counts[1]);
+        ConfigFirstEvents.resize(counts[1]);
+        StreamOffsets.resize(stream_counts[0]);
+        ChunkOffsets.resize(stream_counts[1]);
+        const char* pos = payload.data() + sizeof(counts);
+        for (auto* items : {&EventOffsets, &EventKeys, &ConfigOffsets, &ConfigFirstEvents}) {
+            std::memcpy(items->data(), pos, items->size()*sizeof(uint64_t));
+            pos += items->size()*sizeof(uint64_t);
+        }
 
-    SiPMDynamicWriter(std::string_view file_name,
-                      const CAENDigitizerFamilies& fam,
-                      const CAENDigitizerModelConstants& model_consts,
-                      const CAENGlobalConfig& global_config,
-                      const std::array<CAENGroupConfig, 8>& group_configs) :
-        _sample_rate{model_consts.AcquisitionRate},
-        _en_chs{_get_en_chs(model_consts, group_configs)},
-        _record_length{global_config.RecordLength},
-        _streamer{file_name, column_names,  sipm_ranks, _form_sizes(global_config)}
-    {
-        // Only for these families there is a decimation factor
-        if (fam == CAENDigitizerFamilies::x740 or fam == CAENDigitizerFamilies::x724) {
-            _sample_rate[0] /= global_config.DecimationFactor;
+        pos += StreamOffsets.empty() and ChunkOffsets.empty() ? 0 : sizeof(stream_counts);
+        for (auto* items : {&StreamOffsets, &ChunkOffsets}) {
+            std::memcpy(items->data(), pos, items->size()*sizeof(uint64_t));
+            pos += items->size()*sizeof(uint64_t);
         }
+        return true;
+    }
+};
 
-        for(auto ch : _en_chs) {
-            CAENGroupConfig group;
-            if (model_consts.NumberOfGroups == 0) {
-                group = group_configs[ch];
-                _dc_corrections.push_back(group.DCCorrections[0]);
-            } else {
-                group = group_configs[ch % 8];
-                _dc_corrections.push_back(group.DCCorrections[ch % 8]);
-            }
+// Payload of a STRM block
+struct StreamDeclaration {
+    uint16_t Id = 0;
+    std::string Name;
+    // Header of the records, same format as the event header
+    std::string Header;
+
+    std::string serialize() const {
+        const auto name_size = static_cast<uint16_t>(Name.size());
+        const auto header_size = static_cast<uint16_t>(Header.size());
+        std::string out(reinterpret_cast<const char*>(&Id), sizeof(Id));
+        out.append(reinterpret_cast<const char*>(&name_size), sizeof(name_size));
+        out += Name;
+        out.append(reinterpret_cast<const char*>(&header_size), sizeof(header_size));
+        out += Header;
+        return out;
+    }
 
-            _thresholds.push_back(group.TriggerThreshold);
-            _dc_offsets.push_back(group.DCOffset);
-            _dc_ranges.push_back(static_cast<float>(
-                    model_consts.VoltageRanges.at(group.DCRange)));
+    // Returns false if payload is not a valid declaration.
+    bool parse(std::string_view payload) {
+        uint16_t name_size = 0;
+        uint16_t header_size = 0;
+        if (payload.size() < sizeof(Id) + sizeof(name_size)) {
+            return false;
         }
-        // _trigger_mask[0] is set in _get_en_chs
-    }
 
-    ~SiPMDynamicWriter() = default;
+        std::memcpy(&Id, payload.data(), sizeof(Id));
+        std::memcpy(&name_size, payload.data() + sizeof(Id), sizeof(name_size));
+        const std::size_t header_pos = sizeof(Id) + sizeof(name_size) + name_size;
+        if (payload.size() < header_pos + sizeof(header_size)) {
+            return false;
+        }
 
-    bool isOpen() { return _streamer.isOpen(); }
+        std::memcpy(&header_size, payload.data() + header_pos, sizeof(header_size));
+        if (payload.size() != header_pos + sizeof(header_size) + header_size) {
+            return false;
+        }
 
-    void save_waveform(const std::shared_ptr<CAENWaveforms<uint16_t>>& waveform) {
-        _trigger_tag[0] = waveform->getInfo().TriggerTimeTag;
-        _trigger_source[0] = waveform->getInfo().Pattern;
-        _streamer.save(_sample_rate,
-                       _en_chs,
-                       _trigger_mask,
-                       _thresholds,
-                       _dc_offsets,
-                       _dc_corrections,
-                       _dc_ranges,
-                       _trigger_tag,
-                       _trigger_source,
-                       waveform->getData());
+        Name = payload.substr(sizeof(Id) + sizeof(name_size), name_size);
+        Header = payload.substr(header_pos + sizeof(header_size), header_size);
+        return true;
     }
+};
 
- private:
+// Files of a sharded run (see SiPMShardedWriter). Saved as text: a
+// "SBC shards 1" line and then the file of every shard, one per line.
+// Relative names are relative to the manifest.
+struct ShardManifest {
+    constexpr static std::string_view kMagic = "SBC shards 1";
+
+    std::vector<std::string> Files;
 
-    std::vector<std::size_t> _form_sizes(
-        const CAENGlobalConfig& caen_global_config) {
+    // Throws if it cannot be written
+    void write(const std::string& file_name) const {
+        std::ofstream out(file_name, std::ios::trunc);
+        out << kMagic << "\n";
+        for (const auto& file : Files) {
+            out << file << "\n";
+        }
 
-        auto num_en_chs = _en_chs.size();
-        return {1, num_en_chs, 1, num_en_chs, num_en_chs, num_en_chs, num_en_chs,
-                1, 1, num_en_chs, caen_global_config.RecordLength};
+        out.close();
+        if (not out) {
+            throw std::runtime_error("Could not write " + file_name);
+        }
     }
 
-    std::vector<std::uint8_t> _get_en_chs(
-            const CAENDigitizerModelConstants& model_constants,
-            const std::array<CAENGroupConfig, 8>& groups) {
-        std::vector<std::uint8_t> out;
-        for(std::size_t group_num = 0; group_num < groups.size(); group_num++) {
-            const auto& group = groups[group_num];
-            if (not group.Enabled) {
-                continue;
-            }
+    // Throws if file_name is not a manifest
+    static ShardManifest read(const std::string& file_name) {
+        std::ifstream in(file_name);
+        std::string line;
+        if (not std::getline(in, line) or line != kMagic) {
+            throw std::runtime_error(file_name + " is not a shard manifest");
+        }
 
-            // If the digitizer does not support groups, group_num = ch
-            if (model_constants.NumberOfGroups == 0) {
-                out.push_back(group_num);
+        ShardManifest out;
+        const auto dir = std::filesystem::path(file_name).parent_path();
+        while (std::getline(in, line)) {
+            if (line.empty()) {
                 continue;
             }
 
-            // Othewise, calculate using the AcquisitionMask
-            for (std::size_t ch = 0; ch < model_constants.NumChannelsPerGroup; ch++) {
-                // If the acq mask or trigg mask is enabled that means we are saving that ch
-                // to the file.
-                if (group.AcquisitionMask.at(ch) or group.TriggerMask.at(ch)) {
-                    out.push_back(ch + model_constants.NumChannelsPerGroup * group_num);
-                }
+            const std::filesystem::path path = line;
+            out.Files.push_back(path.is_relative() ? (dir / path).string() : line);
+        }
 
-                // However, only trg mask ones are saved to _trigger_mask duh
-                if (group.TriggerMask.at(ch)) {
-                    auto g_ch = ch + model_constants.NumChannelsPerGroup * group_num;
-                    _trigger_mask[0] |= (1 << g_ch);
-                }
-            }
+        if (out.Files.empty()) {
+            throw std::runtime_error(file_name + " has no shards");
         }
         return out;
     }
+};
+
+namespace Tools {
+
+    // Offset of the INDX block pointed by the last kTrailerSize bytes of a
+    // file of size file_size. Returns 0 if they are not a TRLR block.
+    inline uint64_t read_trailer(std::string_view trailer, const uint64_t& file_size) {
+        uint32_t payload_size = 0;
+        uint64_t index_offset = 0;
+        if (trailer.size() != kTrailerSize
+            or not std::equal(kTrailerBlockTag.begin(), kTrailerBlockTag.end(), trailer.begin())) {
+            return 0;
+        }
+
+        std::memcpy(&payload_size, trailer.data() + kTrailerBlockTag.size(), sizeof(payload_size));
+        std::memcpy(&index_offset, trailer.data() + kBlockHeaderSize, sizeof(index_offset));
+        if (payload_size != sizeof(uint64_t)
+            or index_offset + kBlockHeaderSize + kTrailerSize > file_size) {
+            return 0;
+        }
+
+        return index_offset;
+    }
+
+} // namespace Tools
 
+// Writes SBC binary version 2 files. Events have the DataTypes columns.
+// The offsets of the blocks are kept in memory and saved as the INDX
+// footer when the file is closed.
+template<typename... DataTypes>
+requires Tools::is_arithmetic_ptr_unpack<DataTypes...>
+class BlockWriter {
+ public:
+    using layout_type = RecordLayout<DataTypes...>;
+    constexpr static std::size_t n_cols = sizeof...(DataTypes);
+    // Events per chunk of a ChannelChunked column, see set_chunk_events()
+    constexpr static std::size_t kDefaultChunkEvents = 64;
 
+ private:
+    constexpr static bool kFirstColumnIsKey = std::is_same_v<
+        std::remove_cvref_t<std::tuple_element_t<0, std::tuple<DataTypes...>>>, uint64_t>;
+    using last_type = std::remove_cvref_t<std::tuple_element_t<n_cols - 1,
+                                                               std::tuple<DataTypes...>>>;
+
+    const std::string _file_name;
+    const layout_type _layout;
+
+    bool _open = false;
+    std::unique_ptr<FileSink> _sink;
+    std::size_t _header_size = 0;
+    // Where the next block goes
+    uint64_t _position = 0;
+    // Disk reserved by preallocate(), given back on close
+    uint64_t _reserved = 0;
+
+    // False if the index is too large for an INDX block
+    bool _index_valid = true;
+    EventIndex _index;
+
+    // Checksums of the blocks since the last CRCS block
+    constexpr static std::size_t kBlocksPerChecksum = 256;
+    bool _checksums = false;
+    uint64_t _checksums_start = 0;
+    std::vector<uint32_t> _pending_checksums;
+
+    DurabilityPolicy _durability;
+    uint64_t _unsynced_bytes = 0;
+    std::chrono::steady_clock::time_point _last_sync = std::chrono::steady_clock::now();
+
+    // Block header + event
+    AlignedBuffer _event_buffer;
+
+    // Streams of records saved next to the events, see add_stream(). The
+    // id of a stream is its position.
+    constexpr static std::size_t kMaxChunkSize = 1024*1024;
+    struct StreamState {
+        std::string Name;
+        std::string Header;
+        // Already in the file
+        uint64_t NumRecords = 0;
+        std::size_t ChunkRecords = 1;
+        // The next SDAT payload
+        std::string Pending;
+        uint32_t NumPending = 0;
+    };
+    std::vector<StreamState> _streams;
+
+    // A ChannelChunked last column is saved as one stream per row, named
+    // "{column}/{row}", with a chunk every _chunk_events events
+    std::size_t _chunk_events = kDefaultChunkEvents;
+    std::vector<uint16_t> _row_streams;
+
+    std::string _row_stream_name(const std::size_t& row) const {
+        return _layout.names().back() + "/" + std::to_string(row);
+    }
+
+    void _push_stream(std::string name, std::string header) {
+        StreamState stream;
+        stream.Name = std::move(name);
+        stream.Header = std::move(header);
+        _streams.push_back(std::move(stream));
+    }
+
+    std::string _build_header() const {
+        uint32_t endianess = 0x01020304;
+        if constexpr (std::endian::native == std::endian::big) {
+            endianess = 0x04030201;
+        }
+
+        const std::string event_header = _layout.schema();
+        const auto event_header_size = static_cast<uint16_t>(event_header.length());
+        const uint64_t num_events = 0;
+
+        std::string buffer(kSBCv2Magic.begin(), kSBCv2Magic.end()); // 1.
+        buffer.append(reinterpret_cast<const char*>(&endianess), sizeof(endianess)); // 2.
+        buffer.append(reinterpret_cast<const char*>(&kSBCv2Version),
+                      sizeof(kSBCv2Version)); // 3.
+        buffer.append(reinterpret_cast<const char*>(&event_header_size),
+                      sizeof(event_header_size)); // 4.
+        buffer += event_header; // 5.
+        buffer.append(reinterpret_cast<const char*>(&num_events), sizeof(num_events)); // 6.
+        return buffer;
+    }
+
+    static void _write_block_header(char* out, const BlockTag& tag, const uint32_t& size) {
+        std::memcpy(out, tag.data(), tag.size());
+        std::memcpy(out + tag.size(), &size, sizeof(size));
+    }
+
+    // When appending to a closed file, its index is loaded and the
+    // footer removed so the new blocks go after the old ones. If it was
+    // not closed, see _recover().
+    void _load_index() {
+        const uint64_t file_size = std::filesystem::file_size(_file_name);
+        if (file_size < _header_size + kTrailerSize) {
+            _recover(file_size);
+            return;
+        }
+
+        std::ifstream peeker(_file_name, std::ios::binary);
+        std::string trailer(kTrailerSize, '\0');
+        peeker.seekg(static_cast<std::streamoff>(file_size - kTrailerSize));
+        peeker.read(trailer.data(), static_cast<std::streamsize>(kTrailerSize));
+
+        const uint64_t index_offset = Tools::read_trailer(trailer, file_size);
+        char block_header[kBlockHeaderSize];
+        peeker.seekg(static_cast<std::streamoff>(index_offset));
+        peeker.read(block_header, kBlockHeaderSize);
+
+        uint32_t payload_size = 0;
+        std::memcpy(&payload_size, block_header + kIndexBlockTag.size(), sizeof(payload_size));
+        if (index_offset < _header_size
+            or not std::equal(kIndexBlockTag.begin(), kIndexBlockTag.end(), block_header)
+            or index_offset + kBlockHeaderSize + payload_size + kTrailerSize != file_size) {
+            peeker.close();
+            _recover(file_size);
+            return;
+        }
+
+        std::string payload(payload_size, '\0');
+        peeker.read(payload.data(), payload_size);
+        const bool parsed = _index.parse(payload) and _load_streams(peeker, index_offset);
+        peeker.close();
+
+        if (not parsed) {
+            _recover(file_size);
+            return;
+        }
+
+        std::filesystem::resize_file(_file_name, index_offset);
+    }
+
+    // Declarations and number of records of the streams in the index
+    bool _load_streams(std::ifstream& peeker, const uint64_t& index_offset) {
+        _streams.clear();
+        for (const auto& offset : _index.StreamOffsets) {
+            char block_header[kBlockHeaderSize] = {};
+            peeker.seekg(static_cast<std::streamoff>(offset));
+            peeker.read(block_header, kBlockHeaderSize);
+
+            uint32_t payload_size = 0;
+            std::memcpy(&payload_size, block_header + kStreamBlockTag.size(),
+                        sizeof(payload_size));
+            if (offset + kBlockHeaderSize + payload_size > index_offset) {
+                return false;
+            }
+
+            std::string payload(payload_size, '\0');
+            peeker.read(payload.data(), payload_size);
+            StreamDeclaration declaration;
+            if (not peeker or not declaration.parse(payload)
+                or declaration.Id != _streams.size()) {
+                return false;
+            }
+            _push_stream(declaration.Name, declaration.Header);
+        }
+
+        for (const auto& offset : _index.ChunkOffsets) {
+            char chunk_header[kStreamDataHeaderSize] = {};
+            peeker.seekg(static_cast<std::streamoff>(offset + kBlockHeaderSize));
+            peeker.read(chunk_header, kStreamDataHeaderSize);
+
+            uint16_t id = 0;
+            uint32_t num_records = 0;
+            std::memcpy(&id, chunk_header, sizeof(id));
+            std::memcpy(&num_records, chunk_header + sizeof(uint32_t), sizeof(num_records));
+            if (not peeker or id >= _streams.size()) {
+                return false;
+            }
+            _streams[id].NumRecords += num_records;
+        }
+        return true;
+    }
+
+    // The file was not closed (ex: a crash). The index is rebuilt from the
+    // blocks and the file is truncated after the last complete one, so a
+    // partial event is never followed by new ones. The key of the
+    // recovered events is their first column if it is uint64 (the time
+    // stamp of the SiPM files), otherwise their number.
+    void _recover(const uint64_t& file_size) {
+        _index = {};
+        _streams.clear();
+        // Stream and number of records of each SDAT block
+        std::vector<std::pair<uint16_t, uint32_t>> chunks;
+        std::ifstream peeker(_file_name, std::ios::binary);
+        uint64_t position = _header_size;
+        while (position + kBlockHeaderSize <= file_size) {
+            char block_header[kBlockHeaderSize + sizeof(uint64_t)] = {};
+            peeker.seekg(static_cast<std::streamoff>(position));
+            peeker.read(block_header, sizeof(block_header));
+            peeker.clear();
+
+            uint32_t payload_size = 0;
+            std::memcpy(&payload_size, block_header + kEventBlockTag.size(),
+                        sizeof(payload_size));
+            const uint64_t next = position + kBlockHeaderSize + payload_size;
+            if (next > file_size) {
+                break;
+            }
+
+            if (std::equal(kEventBlockTag.begin(), kEventBlockTag.end(), block_header)) {
+                // A wrong size means garbage (ex: zeros after a power cut)
+                if (payload_size > _layout.max_size()
+                    or (not _layout.isEncoded() and payload_size != _layout.size())) {
+                    break;
+                }
+
+                uint64_t key = _index.EventOffsets.size();
+                if constexpr (kFirstColumnIsKey) {
+                    std::memcpy(&key, block_header + kBlockHeaderSize, sizeof(key));
+                }
+                _index.EventOffsets.push_back(position);
+                _index.EventKeys.push_back(key);
+            } else if (std::equal(kConfigBlockTag.begin(), kConfigBlockTag.end(),
+                                  block_header)) {
+                _index.ConfigOffsets.push_back(position);
+                _index.ConfigFirstEvents.push_back(_index.EventOffsets.size());
+            } else if (std::equal(kStreamBlockTag.begin(), kStreamBlockTag.end(),
+                                  block_header)) {
+                std::string payload(payload_size, '\0');
+                peeker.seekg(static_cast<std::streamoff>(position + kBlockHeaderSize));
+                peeker.read(payload.data(), payload_size);
+                StreamDeclaration declaration;
+                if (not peeker or not declaration.parse(payload)
+                    or declaration.Id != _streams.size()) {
+                    break;
+                }
+
+                _index.StreamOffsets.push_back(position);
+                _push_stream(declaration.Name, declaration.Header);
+            } else if (std::equal(kStreamDataBlockTag.begin(), kStreamDataBlockTag.end(),
+                                  block_header)) {
+                uint16_t id = 0;
+                uint32_t num_records = 0;
+                std::memcpy(&id, block_header + kBlockHeaderSize, sizeof(id));
+                std::memcpy(&num_records, block_header + kBlockHeaderSize + sizeof(uint32_t),
+                            sizeof(num_records));
+                if (payload_size < kStreamDataHeaderSize or id >= _streams.size()) {
+                    break;
+                }
+
+                _index.ChunkOffsets.push_back(position);
+                _streams[id].NumRecords += num_records;
+                chunks.emplace_back(id, num_records);
+            } else if (not std::equal(kChecksumBlockTag.begin(), kChecksumBlockTag.end(),
+                                      block_header)) {
+                // This writer never writes anything else, so it is either
+                // garbage or a footer that was not finished
+                break;
+            }
+
+            position = next;
+        }
+        peeker.close();
+
+        // The last events can be missing their rows, they are removed
+        // with everything after them
+        if (_layout.isChunked()) {
+            uint64_t complete = _index.EventOffsets.size();
+            for (std::size_t row = 0; row < _layout.num_rows(); row++) {
+                auto it = std::find_if(_streams.begin(), _streams.end(),
+                    [&](const StreamState& stream) { return stream.Name == _row_stream_name(row); });
+                complete = std::min<uint64_t>(complete, it == _streams.end() ? 0 : it->NumRecords);
+            }
+
+            if (complete < _index.EventOffsets.size()) {
+                position = _index.EventOffsets[complete];
+                _index.EventOffsets.resize(complete);
+                _index.EventKeys.resize(complete);
+                while (not _index.ConfigOffsets.empty() and _index.ConfigOffsets.back() >= position) {
+                    _index.ConfigOffsets.pop_back();
+                    _index.ConfigFirstEvents.pop_back();
+                }
+
+                while (not _index.ChunkOffsets.empty() and _index.ChunkOffsets.back() >= position) {
+                    _streams[chunks.back().first].NumRecords -= chunks.back().second;
+                    _index.ChunkOffsets.pop_back();
+                    chunks.pop_back();
+                }
+
+                while (not _index.StreamOffsets.empty() and _index.StreamOffsets.back() >= position) {
+                    _index.StreamOffsets.pop_back();
+                    _streams.pop_back();
+                }
+            }
+        }
+
+        std::filesystem::resize_file(_file_name, std::max<uint64_t>(position, _header_size));
+    }
+
+    // Syncs the file if the durability policy asks for it. Called after
+    // every block so the synced part ends at a block boundary.
+    void _after_block(const std::size_t& size) {
+        _unsynced_bytes += size;
+        if (_durability.Mode != DurabilityMode::Periodic) {
+            return;
+        }
+
+        const bool bytes_due = _durability.SyncBytes > 0
+            and _unsynced_bytes >= _durability.SyncBytes;
+        const bool time_due = _durability.SyncTime.count() > 0
+            and std::chrono::steady_clock::now() - _last_sync >= _durability.SyncTime;
+        if (bytes_due or time_due) {
+            sync();
+        }
+    }
+
+    void _write(const char* data, const std::size_t& size) {
+        _sink->write(data, size);
+        _position += size;
+    }
+
+    // Block without checksum or durability bookkeeping
+    void _write_block(const BlockTag& tag, std::string_view payload) {
+        char block_header[kBlockHeaderSize];
+        _write_block_header(block_header, tag, static_cast<uint32_t>(payload.size()));
+        _write(block_header, kBlockHeaderSize);
+        _write(payload.data(), payload.size());
+    }
+
+    void _add_checksum(const uint64_t& offset, const uint32_t& crc) {
+        if (_pending_checksums.empty()) {
+            _checksums_start = offset;
+        }
+
+        _pending_checksums.push_back(crc);
+        if (_pending_checksums.size() >= kBlocksPerChecksum) {
+            _write_checksums();
+        }
+    }
+
+    void _write_checksums() {
+        if (_pending_checksums.empty()) {
+            return;
+        }
+
+        std::string payload(sizeof(uint64_t)
+                            + _pending_checksums.size()*sizeof(uint32_t), '\0');
+        std::memcpy(payload.data(), &_checksums_start, sizeof(uint64_t));
+        std::memcpy(payload.data() + sizeof(uint64_t), _pending_checksums.data(),
+                    _pending_checksums.size()*sizeof(uint32_t));
+        _write_block(kChecksumBlockTag, payload);
+        _pending_checksums.clear();
+    }
+
+    void _add_record(const uint16_t& id, const char* record, const std::size_t& size) {
+        if (not _open) {
+            return;
+        }
+
+        auto& stream = _streams[id];
+        if (stream.Pending.empty()) {
+            stream.Pending.resize(kStreamDataHeaderSize);
+        }
+
+        stream.Pending.append(record, size);
+        stream.NumPending++;
+        if (stream.NumPending >= stream.ChunkRecords or stream.Pending.size() >= kMaxChunkSize) {
+            _write_chunk(id);
+        }
+    }
+
+    void _write_chunk(const uint16_t& id) {
+        auto& stream = _streams[id];
+        if (stream.NumPending == 0) {
+            return;
+        }
+
+        std::memset(stream.Pending.data(), 0, kStreamDataHeaderSize);
+        std::memcpy(stream.Pending.data(), &id, sizeof(id));
+        std::memcpy(stream.Pending.data() + sizeof(uint32_t), &stream.NumPending,
+                    sizeof(stream.NumPending));
+
+        // Taken out before saving: a sync after the block flushes the
+        // streams again and must not see this chunk
+        const std::string chunk = std::move(stream.Pending);
+        stream.NumRecords += stream.NumPending;
+        stream.NumPending = 0;
+        stream.Pending.clear();
+
+        _index.ChunkOffsets.push_back(_position);
+        save_block(kStreamDataBlockTag, chunk);
+    }
+
+ public:
+    BlockWriter(std::string_view file_name,
+                const std::array<std::string, n_cols>& columns_names,
+                const std::array<std::size_t, n_cols>& columns_ranks,
+                const std::vector<std::size_t>& columns_sizes,
+                const std::array<ColumnEncoding, n_cols>& columns_encodings = {},
+                const IOBackend& backend = IOBackend::Buffered) :
+        _file_name{file_name},
+        _layout{columns_names, columns_ranks, columns_sizes, columns_encodings},
+        _event_buffer{kBlockHeaderSize + _layout.max_size()}
+    {
+        _write_block_header(_event_buffer.data(), kEventBlockTag,
+                            static_cast<uint32_t>(_layout.size()));
+
+        const auto header = _build_header();
+        _header_size = header.size();
+        const std::size_t count_offset = _header_size - sizeof(uint64_t);
+        const bool append = Tools::check_header(_file_name, header, count_offset);
+        if (append) {
+            _load_index();
+        }
+
+        _sink = make_file_sink(_file_name, append, backend);
+        _open = true;
+        if (append) {
+            // The number of events is unknown until it is closed again
+            _sink->write_at(count_offset, header.data() + count_offset, sizeof(uint64_t));
+        } else {
+            _sink->write(header.data(), header.size());
+        }
+        _position = _sink->size();
+
+        if (_layout.isChunked()) {
+            for (std::size_t row = 0; row < _layout.num_rows(); row++) {
+                _row_streams.push_back(add_stream<last_type>(_row_stream_name(row),
+                    {_layout.names().back()}, {1}, {_layout.row_length()}, _chunk_events).id());
+            }
+        }
+    }
+
+    ~BlockWriter() {
+        try {
+            close();
+        } catch (const std::exception&) {}
+    }
+
+    // The backend actually used, it falls back to Buffered if the
+    // requested one is not available
+    IOBackend backend() const { return _sink->backend(); }
+
+    // Writes the footer, the number of events and closes the file
+    void close() {
+        if (not _open) {
+            return;
+        }
+
+        flush_streams();
+        _write_checksums();
+        if (_index_valid and _index.payload_size() <= UINT32_MAX) {
+            const uint64_t index_offset = _position;
+            _write_block(kIndexBlockTag, _index.serialize());
+            _write_block(kTrailerBlockTag, std::string_view(
+                reinterpret_cast<const char*>(&index_offset), sizeof(index_offset)));
+            const auto num_events = static_cast<uint64_t>(_index.EventOffsets.size());
+            _sink->write_at(_header_size - sizeof(uint64_t),
+                            reinterpret_cast<const char*>(&num_events), sizeof(num_events));
+        }
+
+        _open = false;
+        if (_durability.Mode != DurabilityMode::None) {
+            _sink->sync();
+        }
+        _sink->close();
+
+        if (_reserved > 0) {
+            Tools::release_preallocation(_file_name, _position, _reserved);
+        }
+    }
+
+    bool isOpen() { return _open; }
+
+    void set_durability(const DurabilityPolicy& durability) { _durability = durability; }
+
+    // Events in each chunk of the rows of a ChannelChunked column. Reading
+    // a row of many events is faster with larger chunks, but the events
+    // are not complete in the file until their chunk is written.
+    void set_chunk_events(const std::size_t& events) {
+        _chunk_events = std::max<std::size_t>(events, 1);
+        for (const auto& id : _row_streams) {
+            _streams[id].ChunkRecords = _chunk_events;
+        }
+    }
+
+    // If enabled, the CRC32C of every block from now on is saved in CRCS
+    // blocks, see Reader::verify_checksums().
+    void set_checksums(const bool& enabled) {
+        if (_open and not enabled) {
+            _write_checksums();
+        }
+        _checksums = enabled;
+    }
+
+    // Writes everything so far to the disk
+    void sync() {
+        if (not _open) {
+            return;
+        }
+
+        // Reset first, the blocks written by flush_streams() call
+        // _after_block() and would sync again
+        _unsynced_bytes = 0;
+        _last_sync = std::chrono::steady_clock::now();
+
+        // So everything in the disk can be verified
+        flush_streams();
+        _write_checksums();
+        _sink->sync();
+        _unsynced_bytes = 0;
+    }
+
+    // Marks the end of a batch of blocks that should reach the disk
+    // together, they are synced in the Batch mode.
+    void end_batch() {
+        if (_durability.Mode == DurabilityMode::Batch and _unsynced_bytes > 0) {
+            sync();
+        }
+    }
+
+    // Reserves disk for a file of size bytes, the part not used is given
+    // back on close. Returns false if it is not supported.
+    bool preallocate(const uint64_t& size) {
+        if (not _open or size <= _position) {
+            return false;
+        }
+
+        _sink->flush();
+        if (not Tools::preallocate_file(_file_name, size)) {
+            return false;
+        }
+
+        _reserved = size;
+        return true;
+    }
+
+    // Largest size of an event block in bytes
+    std::size_t event_block_size() const { return _event_buffer.size(); }
+
+    // Events in the file, including the ones before it was opened
+    std::size_t num_events() const { return _index.EventOffsets.size(); }
+
+    // Writes a block with any tag. The payload is written as is.
+    void save_block(const BlockTag& tag, std::string_view payload) {
+        if (not _open) {
+            return;
+        }
+
+        const uint64_t offset = _position;
+        char block_header[kBlockHeaderSize];
+        _write_block_header(block_header, tag, static_cast<uint32_t>(payload.size()));
+        _write(block_header, kBlockHeaderSize);
+        _write(payload.data(), payload.size());
+        if (_checksums) {
+            _add_checksum(offset, crc32c(payload.data(), payload.size(),
+                                         crc32c(block_header, kBlockHeaderSize)));
+        }
+        _after_block(kBlockHeaderSize + payload.size());
+    }
+
+    // Writes a CONF block with a single line of values of the given layout
+    template<typename... ConfigTypes>
+    void save_config(const RecordLayout<ConfigTypes...>& config_layout,
+                     std::type_identity_t<std::span<ConfigTypes>>... values) {
+        const std::string config_header = config_layout.schema();
+        const auto config_header_size = static_cast<uint16_t>(config_header.length());
+
+        std::string payload(sizeof(config_header_size) + config_header.length()
+                            + config_layout.size(), '\0');
+        std::memcpy(payload.data(), &config_header_size, sizeof(config_header_size));
+        std::memcpy(payload.data() + sizeof(config_header_size),
+                    config_header.data(), config_header.length());
+        config_layout.pack(payload.data() + sizeof(config_header_size)
+                           + config_header.length(), values...);
+
+        if (_open) {
+            _index.ConfigOffsets.push_back(_position);
+            _index.ConfigFirstEvents.push_back(_index.EventOffsets.size());
+        }
+        save_block(kConfigBlockTag, payload);
+    }
+
+    // Writes an EVNT block. key is saved in the index, it is the event
+    // number if not given. Returns the size of the block.
+    std::size_t save_with_key(const uint64_t& key, std::span<DataTypes>... data) {
+        if (not _open) {
+            return 0;
+        }
+
+        const auto size = _layout.pack(_event_buffer.data() + kBlockHeaderSize, data...);
+        // Encoded events do not have a fixed size
+        if (_layout.isEncoded()) {
+            _write_block_header(_event_buffer.data(), kEventBlockTag,
+                                static_cast<uint32_t>(size));
+        }
+
+        const uint64_t offset = _position;
+        _index.EventOffsets.push_back(offset);
+        _index.EventKeys.push_back(key);
+        _write(_event_buffer.data(), kBlockHeaderSize + size);
+        if (_checksums) {
+            _add_checksum(offset, crc32c(_event_buffer.data(), kBlockHeaderSize + size));
+        }
+        _after_block(kBlockHeaderSize + size);
+
+        std::size_t rows_size = 0;
+        if (_layout.isChunked()) {
+            const auto& rows = std::get<n_cols - 1>(std::forward_as_tuple(data...));
+            const std::size_t row_size = _layout.row_length()*sizeof(last_type);
+            for (std::size_t row = 0; row < _row_streams.size(); row++) {
+                _add_record(_row_streams[row],
+                            reinterpret_cast<const char*>(rows.data()) + row*row_size, row_size);
+            }
+            rows_size = _row_streams.size()*row_size;
+        }
+        return kBlockHeaderSize + size + rows_size;
+    }
+
+    std::size_t save(std::span<DataTypes>... data) {
+        return save_with_key(_index.EventOffsets.size(), data...);
+    }
+
+    // Typed handle to a stream of this writer, see add_stream(). It cannot
+    // be used after the writer is destroyed.
+    template<typename... StreamTypes>
+    class Stream {
+        BlockWriter* _writer;
+        uint16_t _id;
+        RecordLayout<StreamTypes...> _layout;
+        std::vector<char> _buffer;
+
+     public:
+        Stream(BlockWriter* writer, const uint16_t& id, RecordLayout<StreamTypes...> layout) :
+            _writer{writer}, _id{id}, _layout{std::move(layout)}, _buffer(_layout.size()) {}
+
+        uint16_t id() const { return _id; }
+
+        // Records in the stream, including the ones not written yet
+        uint64_t size() const {
+            const auto& stream = _writer->_streams[_id];
+            return stream.NumRecords + stream.NumPending;
+        }
+
+        // Queues a record, it is written when its chunk is full. Throws if
+        // a column does not have the expected length.
+        void save(std::span<StreamTypes>... data) {
+            _layout.pack(_buffer.data(), data...);
+            _writer->_add_record(_id, _buffer.data(), _buffer.size());
+        }
+    };
+
+    // Adds a stream of records with the StreamTypes columns (ex: the RTD
+    // temperatures) saved in SDAT blocks of up to chunk_records records
+    // between the events. Pending records are written on sync() and
+    // close(). If the file already has a stream called name, its records
+    // continue; it throws if its columns are different.
+    template<typename... StreamTypes>
+    Stream<StreamTypes...> add_stream(std::string_view name,
+            const std::array<std::string, sizeof...(StreamTypes)>& columns_names,
+            const std::array<std::size_t, sizeof...(StreamTypes)>& columns_ranks,
+            const std::vector<std::size_t>& columns_sizes,
+            const std::size_t& chunk_records = 1024) {
+        RecordLayout<StreamTypes...> layout(columns_names, columns_ranks, columns_sizes);
+        const auto header = layout.schema();
+
+        auto it = std::find_if(_streams.begin(), _streams.end(),
+            [&](const StreamState& stream) { return stream.Name == name; });
+        if (it != _streams.end() and it->Header != header) {
+            throw std::runtime_error("Stream " + std::string(name)
+                                     + " already has other columns");
+        }
+
+        if (it == _streams.end()) {
+            if (_streams.size() > UINT16_MAX) {
+                throw std::runtime_error("Too many streams");
+            }
+
+            const auto id = static_cast<uint16_t>(_streams.size());
+            if (_open) {
+                _index.StreamOffsets.push_back(_position);
+                save_block(kStreamBlockTag,
+                           StreamDeclaration{id, std::string(name), header}.serialize());
+            }
+            _push_stream(std::string(name), header);
+            it = _streams.end() - 1;
+        }
+
+        it->ChunkRecords = std::max<std::size_t>(chunk_records, 1);
+        return {this, static_cast<uint16_t>(std::distance(_streams.begin(), it)),
+                std::move(layout)};
+    }
+
+    // Writes the records of every stream that are not in the file yet
+    void flush_streams() {
+        for (std::size_t id = 0; id < _streams.size(); id++) {
+            _write_chunk(static_cast<uint16_t>(id));
+        }
+    }
+};
+
+// Limits at which SiPMDynamicWriter moves on to the next file. A limit of
+// 0 is ignored and if all of them are 0 everything goes to a single file.
+struct RolloverPolicy {
+    // In bytes, only counts the events and not the header
+    uint64_t MaxBytes = 0;
+    uint64_t MaxEvents = 0;
+    std::chrono::seconds MaxTime{0};
+    // If true, the disk for each file is reserved when it is opened. Only
+    // with MaxBytes or MaxEvents as otherwise the size is not known.
+    bool Preallocate = true;
+    // The first file is the first free sequence number from this one on
+    // (ex: after the files of the run already moved to the archive)
+    uint32_t FirstSequence = 0;
+
+    bool isEnabled() const {
+        return MaxBytes > 0 or MaxEvents > 0 or MaxTime.count() > 0;
+    }
+};
+
+// What the async writer does with new events when all its batches are
+// waiting to be written.
+enum class WriterFullPolicy {
+    // Waits for the writer thread. No events are lost but the caller stalls.
+    Block,
+    // Drops the whole batch.
+    Drop,
+    // Keeps 1 of every PrescaleFactor events while the queue is 3/4 full,
+    // and blocks if it is completely full.
+    Prescale
+};
+
+struct AsyncWriterConfig {
+    // If false, the events are written by the caller thread.
+    bool Enabled = false;
+    // Number of event batches that can be waiting to be written.
+    std::size_t QueueSize = 64;
+    WriterFullPolicy FullPolicy = WriterFullPolicy::Block;
+    uint32_t PrescaleFactor = 10;
+};
+
+struct AsyncWriterStats {
+    // Batches waiting to be written
+    std::size_t QueueDepth = 0;
+    std::size_t QueueSize = 0;
+    // Time between a batch is queued and it is written, in ms
+    double LastLatency = 0.0;
+    double MaxLatency = 0.0;
+    uint64_t WrittenEvents = 0;
+    // Dropped by the Drop or Prescale policies
+    uint64_t DroppedEvents = 0;
+};
+
+// Saves the SiPM waveforms in SBC binary version 2 files. The values
+// that only change with the configuration go to the CONF block written at
+// the start of each file.
+class SiPMDynamicWriter {
+    using SiPMDW = BlockWriter<uint64_t,  // Time stamp
+                               int64_t,   // Host time
+                               uint32_t,  // Trigger source
+                               uint16_t>; // Waveforms
+
+    using SiPMConfigLayout = RecordLayout<uint32_t,  // File sequence
+                                          uint64_t,  // First event
+                                          double,    // sample rate
+                                          double,    // Time stamp period
+                                          uint8_t,   // Enabled Channels
+                                          uint64_t,  // Trigger Mask
+                                          uint16_t,  // Thresholds
+                                          uint16_t,  // DC Offsets
+                                          uint8_t,   // DC Corrections
+                                          float>;    // DC Range
+
+    constexpr static std::size_t num_cols = 4;
+    constexpr static std::array<std::size_t, num_cols> sipm_ranks = {1, 1, 1, 2};
+    const inline static std::array<std::string, num_cols> column_names =
+            {"time_stamp", "host_time", "trg_source", "sipm_traces"};
+
+    constexpr static std::size_t num_config_cols = 10;
+    constexpr static std::array<std::size_t, num_config_cols> config_ranks =
+                                    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+    const inline static std::array<std::string, num_config_cols> config_column_names =
+            {"file_sequence", "first_event", "sample_rate", "ttt_period",
+             "en_chs", "trg_mask", "thresholds", "dc_offsets",
+             "dc_corrections", "dc_range"};
+
+    double _sample_rate[1] = {0.0};
+    double _ttt_period[1] = {0.0};
+    std::vector<std::uint8_t> _en_chs;
+    uint64_t _trigger_mask[1] = {0};
+    std::vector<uint16_t> _thresholds;
+    std::vector<uint16_t> _dc_offsets;
+    std::vector<uint8_t> _dc_corrections;
+    std::vector<float> _dc_ranges;
+    const SiPMConfigLayout _config_layout;
+
+    uint64_t _trigger_tag[1] = {0};
+    int64_t _host_time[1] = {0};
+    uint32_t _trigger_source[1] = {0};
+
+    uint32_t _record_length;
+
+    const std::string _base_file_name;
+    const RolloverPolicy _policy;
+    const std::vector<std::size_t> _sizes;
+    const std::array<ColumnEncoding, num_cols> _encodings;
+    // Disk reserved for every new file, 0 = none
+    const uint64_t _preallocation;
+    const IOBackend _io_backend;
+    const DurabilityPolicy _durability;
+    const bool _checksums;
+
+    // Current file and its statistics
+    std::atomic<uint32_t> _file_sequence = 0;
+    uint64_t _file_events = 0;
+    uint64_t _file_bytes = 0;
+    // Events saved in all the files
+    uint64_t _total_events = 0;
+    std::chrono::steady_clock::time_point _file_start;
+    std::unique_ptr<SiPMDW> _streamer;
+
+    // The next file is opened (and its header written) while the current
+    // one is still being written, and the old one is closed in the
+    // background, so the switch costs just a pointer swap.
+    std::future<std::unique_ptr<SiPMDW>> _next_streamer;
+    std::future<void> _closing_streamer;
+    std::function<void(const std::string&)> _on_file_closed;
+
+    // In async mode the errors come from the writer thread
+    std::mutex _error_mutex;
+    std::string _rollover_error;
+    std::string _write_error;
+
+    // Async mode items. The batches go around in a loop: the caller takes
+    // a free batch, fills it and queues it, and the writer thread writes
+    // it and gives it back. Once all of them are allocated, nothing else
+    // is allocated while acquiring.
+    struct EventBatch {
+        std::vector<uint16_t> Data;
+        std::vector<CAENEventTime> Times;
+        std::vector<uint32_t> Patterns;
+        std::size_t NumEvents = 0;
+        std::chrono::steady_clock::time_point QueuedAt;
+    };
+    using EventBatch_ptr = std::unique_ptr<EventBatch>;
+
+    const AsyncWriterConfig _async_config;
+    // A nullptr batch stops the writer thread
+    moodycamel::BlockingReaderWriterQueue<EventBatch_ptr> _batch_queue;
+    moodycamel::BlockingReaderWriterQueue<EventBatch_ptr> _free_batches;
+    std::thread _writer_thread;
+    uint64_t _prescale_count = 0;
+
+    std::atomic<uint64_t> _written_events = 0;
+    std::atomic<uint64_t> _dropped_events = 0;
+    std::atomic<double> _last_latency = 0.0;
+    std::atomic<double> _max_latency = 0.0;
+ public:
+    /* Details of each parameters:
+    Name          | type      | length (in Bytes) | block
+    ---------------------------------------------------------------
+    file_sequence | uint32    | 4                 | CONF
+    first_event   | uint64    | 8                 | CONF
+    sample_rate   | double    | 8                 | CONF
+    ttt_period    | double    | 8                 | CONF
+    en_chs        | uint8     | 1*ch_size         | CONF
+    trg_mask      | uint64    | 8                 | CONF
+    thresholds    | uint16    | 2*ch_size         | CONF
+    dc_offsets    | uint16    | 2*ch_size         | CONF
+    dc_corrections| uint8     | 1*ch_size         | CONF
+    dc_range      | single    | 4*ch_size         | CONF
+    time_stamp    | uint64    | 8                 | EVNT
+    host_time     | int64     | 8                 | EVNT
+    trg_source    | uint32    | 4                 | EVNT
+    sipm_traces   | uint16    | 2*rl*ch_size      | EVNT
+    ---------------------------------------------------------------
+    rl -> record length of the waveforms
+    ch_size -> number of enabled channels
+    en_chs  -> the channels # that were enabled
+    first_event -> number of events in the previous files of the sequence
+    time_stamp -> trigger time tag with its rollovers, in ttt_period ns
+    host_time  -> estimated host time of the trigger, ns since unix epoch
+
+    Total length of an event = 8 (block header) + 20 + 2*ch_size*record_length
+    If sipm_traces is encoded ("uint16:dzbp"), its length varies per event.
+    If it is chunked ("uint16:chunked"), it is not in the events but in the
+    "sipm_traces/{channel}" streams.
+    */
+
+    // If the policy is enabled, file_name is used as the base of the
+    // sequenced names: "name.bin" becomes "name_0000.bin", "name_0001.bin"...
+    // starting from the first sequence number not in the disk.
+    // If async_config is enabled, the events are written by its own thread.
+    // traces_encoding is the encoding of the sipm_traces column,
+    // io_backend how the files are written, durability when they are
+    // synced to the disk (a batch is a call to save_waveforms) and
+    // checksums if the blocks have CRC32C checksums.
+    SiPMDynamicWriter(std::string_view file_name,
+                      const CAENDigitizerFamilies& fam,
+                      const CAENDigitizerModelConstants& model_consts,
+                      const CAENGlobalConfig& global_config,
+                      const std::array<CAENGroupConfig, 8>& group_configs,
+                      const RolloverPolicy& policy = {},
+                      const AsyncWriterConfig& async_config = {},
+                      const ColumnEncoding& traces_encoding = ColumnEncoding::Raw,
+                      const IOBackend& io_backend = IOBackend::Buffered,
+                      const DurabilityPolicy& durability = {},
+                      const bool& checksums = false) :
+        _sample_rate{model_consts.AcquisitionRate},
+        _ttt_period{model_consts.TriggerTimeTagPeriod},
+        _en_chs{get_enabled_channels(model_consts, group_configs)},
+        _trigger_mask{_get_trigger_mask(model_consts, group_configs)},
+        _config_layout{config_column_names, config_ranks, _form_config_sizes(_en_chs.size())},
+        _record_length{global_config.RecordLength},
+        _base_file_name{file_name},
+        _policy{policy},
+        _sizes{_form_sizes(_en_chs.size(), global_config.RecordLength)},
+        _encodings{ColumnEncoding::Raw, ColumnEncoding::Raw, ColumnEncoding::Raw,
+                   traces_encoding},
+        _preallocation{_get_preallocation(policy, _sizes, _encodings)},
+        _io_backend{io_backend},
+        _durability{durability},
+        _checksums{checksums},
+        _async_config{async_config},
+        _batch_queue(async_config.QueueSize + 1),
+        _free_batches(async_config.QueueSize)
+    {
+        // Only for these families there is a decimation factor
+        if (fam == CAENDigitizerFamilies::x740 or fam == CAENDigitizerFamilies::x724) {
+            _sample_rate[0] /= global_config.DecimationFactor;
+        }
+
+        // In DES mode the x751 samples twice as fast
+        if (fam == CAENDigitizerFamilies::x751 and global_config.DESMode) {
+            _sample_rate[0] *= 2.0;
+        }
+
+        for(auto ch : _en_chs) {
+            CAENGroupConfig group;
+            if (model_consts.NumberOfGroups == 0) {
+                group = group_configs[ch];
+                _dc_corrections.push_back(group.DCCorrections[0]);
+            } else {
+                group = group_configs[ch / model_consts.NumChannelsPerGroup];
+                _dc_corrections.push_back(
+                    group.DCCorrections[ch % model_consts.NumChannelsPerGroup]);
+            }
+
+            _thresholds.push_back(group.TriggerThreshold);
+            _dc_offsets.push_back(group.DCOffset);
+            _dc_ranges.push_back(static_cast<float>(
+                    model_consts.VoltageRanges.at(group.DCRange)));
+        }
+
+        if (_policy.isEnabled()) {
+            _file_sequence = _policy.FirstSequence;
+            while (std::filesystem::exists(get_file_name(_file_sequence))) {
+                _file_sequence++;
+            }
+        }
+
+        // The first file is opened here so any error reaches the caller
+        _streamer = _open_file(get_file_name(_file_sequence), _sizes, _encodings,
+                               _preallocation, _io_backend, _durability, _checksums);
+        _write_config();
+        _file_start = std::chrono::steady_clock::now();
+
+        if (_policy.isEnabled()) {
+            _prepare_next_file();
+        }
+
+        if (_async_config.Enabled) {
+            for (std::size_t i = 0; i < _async_config.QueueSize; i++) {
+                _free_batches.enqueue(std::make_unique<EventBatch>());
+            }
+
+            _writer_thread = std::thread(&SiPMDynamicWriter::_writer_loop, this);
+        }
+    }
+
+    ~SiPMDynamicWriter() {
+        // Everything queued is written before closing
+        if (_writer_thread.joinable()) {
+            _batch_queue.enqueue(nullptr);
+            _writer_thread.join();
+        }
+
+        // The next file is removed if it was not used
+        if (_next_streamer.valid()) {
+            try {
+                if (auto unused = _next_streamer.get(); unused and unused->num_events() == 0) {
+                    unused->close();
+                    std::filesystem::remove(get_file_name(_file_sequence + 1));
+                }
+            } catch (const std::exception&) {}
+        }
+
+        if (_closing_streamer.valid()) {
+            _closing_streamer.wait();
+        }
+
+        if (_streamer) {
+            _streamer.reset();
+            if (_on_file_closed) {
+                try {
+                    _on_file_closed(get_current_file_name());
+                } catch (const std::exception&) {}
+            }
+        }
+    }
+
+    bool isOpen() { return _streamer and _streamer->isOpen(); }
+
+    // on_closed is called with the name of every file once it is closed
+    // (ex: to move it to the archive, see FileMigrator). For the rotated
+    // files it is called from another thread. Set it before saving events.
+    void set_on_file_closed(std::function<void(const std::string&)> on_closed) {
+        _on_file_closed = std::move(on_closed);
+    }
+
+    // Name of the file with sequence number seq
+    std::string get_file_name(const uint32_t& seq) const {
+        if (not _policy.isEnabled()) {
+            return _base_file_name;
+        }
+
+        return Tools::sequenced_file_name(_base_file_name, seq);
+    }
+
+    std::string get_current_file_name() const {
+        return get_file_name(_file_sequence);
+    }
+
+    uint32_t get_file_sequence() const { return _file_sequence; }
+
+    // Returns (and clears) the error of the last failed rollover.
+    // Empty if there was none.
+    std::string pop_rollover_error() {
+        std::lock_guard lock(_error_mutex);
+        return std::exchange(_rollover_error, "");
+    }
+
+    // Returns (and clears) the last error of the writer thread.
+    // Empty if there was none.
+    std::string pop_write_error() {
+        std::lock_guard lock(_error_mutex);
+        return std::exchange(_write_error, "");
+    }
+
+    bool isAsync() const { return _async_config.Enabled; }
+
+    // The backend of the current file, it is Buffered if io_backend was
+    // not available
+    IOBackend get_io_backend() const { return _streamer->backend(); }
+
+    AsyncWriterStats get_async_stats() const {
+        return AsyncWriterStats {
+            _batch_queue.size_approx(),
+            _async_config.QueueSize,
+            _last_latency.load(),
+            _max_latency.load(),
+            _written_events.load(),
+            _dropped_events.load()
+        };
+    }
+
+    // Bytes a single event takes in the file for the given digitizer
+    // configuration, including its index entry, checksum and, if chunked,
+    // its share of the chunks. For dzbp it is an upper bound, the real size
+    // depends on the waveforms. The fixed blocks of each file (header,
+    // CONF, trailer) are not included.
+    static std::size_t event_size(const CAENDigitizerModelConstants& model_consts,
+                                  const CAENGlobalConfig& global_config,
+                                  const std::array<CAENGroupConfig, 8>& group_configs,
+                                  const ColumnEncoding& traces_encoding = ColumnEncoding::Raw,
+                                  const bool& checksums = false) {
+        auto num_en_chs = get_enabled_channels(model_consts, group_configs).size();
+        auto sizes = _form_sizes(num_en_chs, global_config.RecordLength);
+        const SiPMDW::layout_type layout(column_names, sipm_ranks, sizes,
+            {ColumnEncoding::Raw, ColumnEncoding::Raw, ColumnEncoding::Raw,
+             traces_encoding});
+
+        // INDX offset and key
+        constexpr std::size_t kIndexEntrySize = 2*sizeof(uint64_t);
+        constexpr std::size_t kChecksumSize = sizeof(uint32_t);
+        std::size_t out = kBlockHeaderSize + layout.max_size() + kIndexEntrySize
+            + (checksums ? kChecksumSize : 0);
+        if (layout.isChunked()) {
+            // One record per row, and every row stream has a SDAT block
+            // (header, chunk header and INDX offset) every kChunkEvents
+            constexpr std::size_t kChunkEvents = SiPMDW::kDefaultChunkEvents;
+            const std::size_t chunk_overhead = kBlockHeaderSize + kStreamDataHeaderSize
+                + sizeof(uint64_t) + (checksums ? kChecksumSize : 0);
+            out += layout.num_rows()*(layout.row_length()*sizeof(uint16_t)
+                + (chunk_overhead + kChunkEvents - 1) / kChunkEvents);
+        }
+        return out;
+    }
+
+    // Gets a vector with the numbers of the channels that are saved to the
+    // file. Takes into account if the digitizer has groups or not.
+    static std::vector<std::uint8_t> get_enabled_channels(
+            const CAENDigitizerModelConstants& model_constants,
+            const std::array<CAENGroupConfig, 8>& groups) {
+        std::vector<std::uint8_t> out;
+        for(std::size_t group_num = 0; group_num < groups.size(); group_num++) {
+            const auto& group = groups[group_num];
+            if (not group.Enabled) {
+                continue;
+            }
+
+            // If the digitizer does not support groups, group_num = ch
+            if (model_constants.NumberOfGroups == 0) {
+                if (group_num < model_constants.NumChannels) {
+                    out.push_back(group_num);
+                }
+                continue;
+            }
+
+            // Othewise, calculate using the AcquisitionMask
+            for (std::size_t ch = 0; ch < model_constants.NumChannelsPerGroup; ch++) {
+                // If the acq mask or trigg mask is enabled that means we are saving that ch
+                // to the file.
+                if (group.AcquisitionMask.at(ch) or group.TriggerMask.at(ch)) {
+                    out.push_back(ch + model_constants.NumChannelsPerGroup * group_num);
+                }
+            }
+        }
+        return out;
+    }
+
+    void save_waveform(const std::shared_ptr<CAENWaveforms<uint16_t>>& waveform) {
+        _save_event(waveform->getData(), waveform->getTime(),
+                    waveform->getInfo().Pattern);
+    }
+
+    // Saves n waveforms starting from first. In async mode they are copied
+    // to a batch that is written by the writer thread, and the queue full
+    // policy is applied here.
+    template<typename Iter>
+    void save_waveforms(Iter first, const std::size_t& n) {
+        if (not _async_config.Enabled) {
+            try {
+                std::for_each_n(first, n, [&](const auto& waveform) {
+                    save_waveform(waveform);
+                });
+                _streamer->end_batch();
+            } catch (const std::runtime_error& err) {
+                std::lock_guard lock(_error_mutex);
+                _write_error = err.what();
+            }
+            return;
+        }
+
+        if (n == 0) {
+            return;
+        }
+
+        EventBatch_ptr batch;
+        if (_async_config.FullPolicy == WriterFullPolicy::Drop) {
+            if (not _free_batches.try_dequeue(batch)) {
+                _dropped_events += n;
+                return;
+            }
+        } else {
+            _free_batches.wait_dequeue(batch);
+        }
+
+        uint64_t keep_one_in = 1;
+        if (_async_config.FullPolicy == WriterFullPolicy::Prescale
+            and 4*_batch_queue.size_approx() >= 3*_async_config.QueueSize) {
+            keep_one_in = std::max<uint64_t>(_async_config.PrescaleFactor, 1);
+        }
+
+        const std::size_t event_samples = _en_chs.size()*_record_length;
+        batch->Data.resize(n*event_samples);
+        batch->Times.resize(n);
+        batch->Patterns.resize(n);
+        batch->NumEvents = 0;
+
+        for (std::size_t i = 0; i < n; i++, ++first) {
+            if (_prescale_count++ % keep_one_in != 0) {
+                _dropped_events++;
+                continue;
+            }
+
+            const auto& waveform = *first;
+            auto data = waveform->getData();
+            if (data.size() != event_samples) {
+                _free_batches.enqueue(std::move(batch));
+                throw std::out_of_range("memory is out of range");
+            }
+
+            std::copy_n(data.begin(), event_samples,
+                        batch->Data.begin() + batch->NumEvents*event_samples);
+            batch->Times[batch->NumEvents] = waveform->getTime();
+            batch->Patterns[batch->NumEvents] = waveform->getInfo().Pattern;
+            batch->NumEvents++;
+        }
+
+        batch->QueuedAt = std::chrono::steady_clock::now();
+        _batch_queue.enqueue(std::move(batch));
+    }
+
+ private:
+    void _save_event(std::span<uint16_t> data, const CAENEventTime& time,
+                     const uint32_t& pattern) {
+        if (_should_rollover()) {
+            _rollover();
+        }
+
+        _trigger_tag[0] = time.ExtendedTimeTag;
+        _host_time[0] = time.HostTime;
+        _trigger_source[0] = pattern;
+        _file_bytes += _streamer->save_with_key(_trigger_tag[0],
+                                               _trigger_tag,
+                                               _host_time,
+                                               _trigger_source,
+                                               data);
+        _file_events++;
+        _total_events++;
+        _written_events.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Writes the queued batches until a nullptr batch arrives
+    void _writer_loop() {
+        const std::size_t event_samples = _en_chs.size()*_record_length;
+        EventBatch_ptr batch;
+        while (true) {
+            _batch_queue.wait_dequeue(batch);
+            if (not batch) {
+                return;
+            }
+
+            try {
+                for (std::size_t i = 0; i < batch->NumEvents; i++) {
+                    _save_event(std::span<uint16_t>(batch->Data.data() + i*event_samples,
+                                                    event_samples),
+                                batch->Times[i], batch->Patterns[i]);
+                }
+                _streamer->end_batch();
+            } catch (const std::exception& err) {
+                std::lock_guard lock(_error_mutex);
+                _write_error = err.what();
+            }
+
+            std::chrono::duration<double, std::milli> latency
+                = std::chrono::steady_clock::now() - batch->QueuedAt;
+            _last_latency = latency.count();
+            if (latency.count() > _max_latency) {
+                _max_latency = latency.count();
+            }
+
+            _free_batches.enqueue(std::move(batch));
+        }
+    }
+
+    // Writes the CONF block of the current file
+    void _write_config() {
+        uint32_t file_sequence[1] = {_file_sequence};
+        uint64_t first_event[1] = {_total_events};
+        _streamer->save_config(_config_layout,
+                               file_sequence,
+                               first_event,
+                               _sample_rate,
+                               _ttt_period,
+                               _en_chs,
+                               _trigger_mask,
+                               _thresholds,
+                               _dc_offsets,
+                               _dc_corrections,
+                               _dc_ranges);
+    }
+
+    static std::unique_ptr<SiPMDW> _open_file(const std::string& file_name,
+                                              const std::vector<std::size_t>& sizes,
+                                              const std::array<ColumnEncoding, num_cols>& encodings,
+                                              const uint64_t& preallocation,
+                                              const IOBackend& io_backend,
+                                              const DurabilityPolicy& durability,
+                                              const bool& checksums) {
+        auto streamer = std::make_unique<SiPMDW>(file_name, column_names, sipm_ranks,
+                                                 sizes, encodings, io_backend);
+        streamer->set_durability(durability);
+        streamer->set_checksums(checksums);
+        if (preallocation > 0) {
+            streamer->preallocate(preallocation);
+        }
+        return streamer;
+    }
+
+    // Expected size of a full file of the sequence, including its footer.
+    // 0 if it is not known or preallocation is disabled.
+    static uint64_t _get_preallocation(const RolloverPolicy& policy,
+                                       const std::vector<std::size_t>& sizes,
+                                       const std::array<ColumnEncoding, num_cols>& encodings) {
+        if (not policy.Preallocate or (policy.MaxBytes == 0 and policy.MaxEvents == 0)) {
+            return 0;
+        }
+
+        const SiPMDW::layout_type layout(column_names, sipm_ranks, sizes, encodings);
+        // Chunked traces are not in the EVNT blocks but still in the file
+        const uint64_t max_event_size = kBlockHeaderSize + layout.max_size()
+            + (layout.isChunked() ? layout.num_rows()*layout.row_length()*sizeof(uint16_t) : 0);
+        // A file closes after the event that reaches the limit
+        uint64_t events = policy.MaxEvents > 0 ? policy.MaxEvents
+                          : policy.MaxBytes / max_event_size + 1;
+        uint64_t bytes = events*max_event_size;
+        if (policy.MaxBytes > 0) {
+            bytes = std::min(bytes, policy.MaxBytes + max_event_size);
+            events = std::min(events, policy.MaxBytes / max_event_size + 1);
+        }
+
+        // Header, CONF and INDX blocks
+        constexpr uint64_t kHeaderAndConfig = 64*1024;
+        return bytes + kHeaderAndConfig + 2*sizeof(uint64_t)*events;
+    }
+
+    // Opens the file after the current one in another thread.
+    void _prepare_next_file() {
+        _next_streamer = std::async(std::launch::async,
+            [name = get_file_name(_file_sequence + 1), sizes = _sizes,
+             encodings = _encodings, preallocation = _preallocation,
+             io_backend = _io_backend, durability = _durability,
+             checksums = _checksums]() {
+                return _open_file(name, sizes, encodings, preallocation, io_backend,
+                                  durability, checksums);
+            });
+    }
+
+    bool _should_rollover() const {
+        if (not _policy.isEnabled() or _file_events == 0) {
+            return false;
+        }
+
+        if (_policy.MaxEvents > 0 and _file_events >= _policy.MaxEvents) {
+            return true;
+        }
+
+        if (_policy.MaxBytes > 0 and _file_bytes >= _policy.MaxBytes) {
+            return true;
+        }
+
+        return _policy.MaxTime.count() > 0
+            and std::chrono::steady_clock::now() - _file_start >= _policy.MaxTime;
+    }
+
+    // Switches to the already opened next file. If the next file could
+    // not be opened, we keep writing to the current one so no events are
+    // lost and try again at the next boundary.
+    void _rollover() {
+        std::unique_ptr<SiPMDW> next;
+        std::string error;
+        try {
+            next = _next_streamer.get();
+        } catch (const std::exception& err) {
+            error = err.what();
+        }
+
+        if (not next or not next->isOpen()) {
+            std::lock_guard lock(_error_mutex);
+            _rollover_error = error.empty() ?
+                "Could not open " + get_file_name(_file_sequence + 1) : error;
+
+            _file_events = 0;
+            _file_bytes = 0;
+            _file_start = std::chrono::steady_clock::now();
+            _prepare_next_file();
+            return;
+        }
+
+        // Only one file is closed at the time
+        if (_closing_streamer.valid()) {
+            _closing_streamer.wait();
+        }
+
+        _closing_streamer = std::async(std::launch::async,
+            [old = std::move(_streamer), name = get_current_file_name(),
+             on_closed = _on_file_closed]() mutable {
+                old.reset();
+                if (on_closed) {
+                    on_closed(name);
+                }
+            });
+
+        _streamer = std::move(next);
+        _file_sequence++;
+        _write_config();
+        _file_events = 0;
+        _file_bytes = 0;
+        _file_start = std::chrono::steady_clock::now();
+
+        _prepare_next_file();
+    }
+
+    static std::vector<std::size_t> _form_sizes(const std::size_t& num_en_chs,
+                                                const uint32_t& record_length) {
+        return {1, 1, 1, num_en_chs, record_length};
+    }
+
+    static std::vector<std::size_t> _form_config_sizes(const std::size_t& num_en_chs) {
+        return {1, 1, 1, 1, num_en_chs, 1, num_en_chs, num_en_chs, num_en_chs, num_en_chs};
+    }
+
+    // Only the channels in the trigger mask of each group are part of it.
+    static uint64_t _get_trigger_mask(
+            const CAENDigitizerModelConstants& model_constants,
+            const std::array<CAENGroupConfig, 8>& groups) {
+        uint64_t out = 0;
+        // Digitizers without groups do not have a trigger mask per channel
+        if (model_constants.NumberOfGroups == 0) {
+            return out;
+        }
+
+        for(std::size_t group_num = 0; group_num < groups.size(); group_num++) {
+            const auto& group = groups[group_num];
+            if (not group.Enabled) {
+                continue;
+            }
+
+            for (std::size_t ch = 0; ch < model_constants.NumChannelsPerGroup; ch++) {
+                if (group.TriggerMask.at(ch)) {
+                    auto g_ch = ch + model_constants.NumChannelsPerGroup * group_num;
+                    out |= (uint64_t{1} << g_ch);
+                }
+            }
+        }
+        return out;
+    }
+
+
+};
+
+// Stripes the SiPM events over several files, usually on different disks,
+// so their write bandwidths add up. Every shard is a SiPMDynamicWriter
+// with its own writer thread and the events go to them in turn. As the
+// events of a shard are in order, readers merge the shards by time stamp
+// (see ShardedReader).
+class SiPMShardedWriter {
+    using waveform_ptr = std::shared_ptr<CAENWaveforms<uint16_t>>;
+
+    std::vector<std::unique_ptr<SiPMDynamicWriter>> _shards;
+    // Events of every shard in the current save_waveforms()
+    std::vector<std::vector<waveform_ptr>> _shard_events;
+    std::size_t _next_shard = 0;
+    std::string _manifest_name;
+
+ public:
+    // file_names has the file of each shard, their directories are created
+    // if needed. With more than one, the files are listed in manifest_name
+    // and are always written asynchronously. The rest of the arguments are
+    // those of SiPMDynamicWriter, the rollover policy applies to each shard.
+    SiPMShardedWriter(std::string_view manifest_name,
+                      const std::vector<std::string>& file_names,
+                      const CAENDigitizerFamilies& fam,
+                      const CAENDigitizerModelConstants& model_consts,
+                      const CAENGlobalConfig& global_config,
+                      const std::array<CAENGroupConfig, 8>& group_configs,
+                      const RolloverPolicy& policy = {},
+                      AsyncWriterConfig async_config = {},
+                      const ColumnEncoding& traces_encoding = ColumnEncoding::Raw,
+                      const IOBackend& io_backend = IOBackend::Buffered,
+                      const DurabilityPolicy& durability = {},
+                      const bool& checksums = false) :
+        _shard_events(file_names.size())
+    {
+        if (file_names.empty()) {
+            throw std::invalid_argument("A sharded writer needs at least one file");
+        }
+
+        if (file_names.size() > 1) {
+            _manifest_name = manifest_name;
+            async_config.Enabled = true;
+        }
+
+        ShardManifest manifest;
+        for (const auto& file_name : file_names) {
+            const auto dir = std::filesystem::path(file_name).parent_path();
+            if (not dir.empty()) {
+                std::filesystem::create_directories(dir);
+            }
+
+            _shards.push_back(std::make_unique<SiPMDynamicWriter>(file_name, fam,
+                model_consts, global_config, group_configs, policy, async_config,
+                traces_encoding, io_backend, durability, checksums));
+            manifest.Files.push_back(std::filesystem::absolute(file_name).string());
+        }
+
+        if (not _manifest_name.empty()) {
+            manifest.write(_manifest_name);
+        }
+    }
+
+    std::size_t num_shards() const { return _shards.size(); }
+
+    // Empty if there is a single shard
+    const std::string& get_manifest_name() const { return _manifest_name; }
+
+    bool isOpen() {
+        return std::all_of(_shards.begin(), _shards.end(),
+                           [](const auto& shard) { return shard->isOpen(); });
+    }
+
+    // See SiPMDynamicWriter::set_on_file_closed
+    void set_on_file_closed(const std::function<void(const std::string&)>& on_closed) {
+        for (auto& shard : _shards) {
+            shard->set_on_file_closed(on_closed);
+        }
+    }
+
+    // Of the first shard, the others follow the same sequence
+    std::string get_current_file_name() const { return _shards.front()->get_current_file_name(); }
+    uint32_t get_file_sequence() const { return _shards.front()->get_file_sequence(); }
+    IOBackend get_io_backend() const { return _shards.front()->get_io_backend(); }
+
+    // Returns (and clears) the errors of all the shards, empty if there
+    // were none
+    std::string pop_rollover_error() {
+        return _pop_errors([](SiPMDynamicWriter& shard) { return shard.pop_rollover_error(); });
+    }
+
+    std::string pop_write_error() {
+        return _pop_errors([](SiPMDynamicWriter& shard) { return shard.pop_write_error(); });
+    }
+
+    // Queues and events of all the shards, the latencies are the largest
+    AsyncWriterStats get_async_stats() const {
+        AsyncWriterStats out;
+        for (const auto& shard : _shards) {
+            const auto stats = shard->get_async_stats();
+            out.QueueDepth += stats.QueueDepth;
+            out.QueueSize += stats.QueueSize;
+            out.LastLatency = std::max(out.LastLatency, stats.LastLatency);
+            out.MaxLatency = std::max(out.MaxLatency, stats.MaxLatency);
+            out.WrittenEvents += stats.WrittenEvents;
+            out.DroppedEvents += stats.DroppedEvents;
+        }
+        return out;
+    }
+
+    // Saves n waveforms starting from first, one to each shard in turn
+    template<typename Iter>
+    void save_waveforms(Iter first, const std::size_t& n) {
+        if (_shards.size() == 1) {
+            _shards.front()->save_waveforms(first, n);
+            return;
+        }
+
+        for (std::size_t i = 0; i < n; i++, ++first) {
+            _shard_events[_next_shard].push_back(*first);
+            _next_shard = (_next_shard + 1) % _shards.size();
+        }
+
+        // The shards copy the events to their batches, so the waveforms
+        // are not kept after this
+        for (std::size_t shard = 0; shard < _shards.size(); shard++) {
+            auto& events = _shard_events[shard];
+            try {
+                _shards[shard]->save_waveforms(events.begin(), events.size());
+            } catch (...) {
+                for (auto& other : _shard_events) {
+                    other.clear();
+                }
+                throw;
+            }
+            events.clear();
+        }
+    }
+
+ private:
+    template<typename PopFunc>
+    std::string _pop_errors(PopFunc&& pop) {
+        std::string out;
+        for (std::size_t shard = 0; shard < _shards.size(); shard++) {
+            auto err = pop(*_shards[shard]);
+            if (err.empty()) {
+                continue;
+            }
+
+            if (not out.empty()) {
+                out += "; ";
+            }
+            out += _shards.size() == 1 ? err : fmt::format("shard {}: {}", shard, err);
+        }
+        return out;
+    }
 };
 
 } // namespace SBCQueens::BinaryFormat
@@ -0,0 +1,1149 @@
+#ifndef SBCBINARYREADER_H
+#define SBCBINARYREADER_H
+#pragma once
+
+// C STD includes
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+namespace SBCQueens::BinaryFormat {
+
+// Read only memory map of a whole file. Throws if it cannot be mapped.
+class MappedFile {
+    const std::byte* _data = nullptr;
+    std::size_t _size = 0;
+#ifdef _WIN32
+    HANDLE _file = INVALID_HANDLE_VALUE;
+    HANDLE _mapping = nullptr;
+#endif
+
+ public:
+    explicit MappedFile(const std::string& file_name) {
+#ifdef _WIN32
+        _file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Could not open " + file_name);
+        }
+
+        LARGE_INTEGER size;
+        GetFileSizeEx(_file, &size);
+        _size = static_cast<std::size_t>(size.QuadPart);
+        if (_size == 0) {
+            return;
+        }
+
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (not _mapping) {
+            CloseHandle(_file);
+            throw std::runtime_error("Could not map " + file_name);
+        }
+
+        _data = static_cast<const std::byte*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (not _data) {
+            CloseHandle(_mapping);
+            CloseHandle(_file);
+            throw std::runtime_error("Could not map " + file_name);
+        }
+#else
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + file_name);
+        }
+
+        struct stat file_stat{};
+        fstat(fd, &file_stat);
+        _size = static_cast<std::size_t>(file_stat.st_size);
+        if (_size == 0) {
+            ::close(fd);
+            return;
+        }
+
+        void* ptr = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        // The map keeps the file alive
+        ::close(fd);
+        if (ptr == MAP_FAILED) {
+            throw std::runtime_error("Could not map " + file_name);
+        }
+
+        _data = static_cast<const std::byte*>(ptr);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (_data) {
+            UnmapViewOfFile(_data);
+        }
+        if (_mapping) {
+            CloseHandle(_mapping);
+        }
+        if (_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(_file);
+        }
+#else
+        if (_data) {
+            munmap(const_cast<std::byte*>(_data), _size);
+        }
+#endif
+    }
+
+    std::span<const std::byte> data() const { return {_data, _size}; }
+    std::size_t size() const { return _size; }
+};
+
+// A single column of a record as described by the header.
+struct ColumnInfo {
+    std::string Name;
+    // As in the header, ex: "uint16"
+    std::string Type;
+    std::vector<std::size_t> Shape;
+    // In bytes from the start of the record
+    std::size_t Offset = 0;
+    // Number of items
+    std::size_t Length = 0;
+    std::size_t TypeSize = 0;
+    // Encoded columns are always the last one of the record and their
+    // size changes from record to record
+    ColumnEncoding Encoding = ColumnEncoding::Raw;
+};
+
+// Typed version of a "{name_col};{type_col};{size1},{size2}...;" header
+class Schema {
+    std::vector<ColumnInfo> _columns;
+    std::size_t _record_size = 0;
+
+    static std::size_t _type_size(std::string_view type) {
+        if (type == "char" or type == "uint8" or type == "int8") {
+            return 1;
+        } else if (type == "uint16" or type == "int16") {
+            return 2;
+        } else if (type == "uint32" or type == "int32" or type == "single") {
+            return 4;
+        } else if (type == "uint64" or type == "int64" or type == "double") {
+            return 8;
+        } else if (type == "float128") {
+            return 16;
+        }
+
+        throw std::runtime_error("Unknown column type " + std::string(type));
+    }
+
+ public:
+    Schema() = default;
+
+    // Throws if the header is malformed
+    explicit Schema(std::string_view header) {
+        std::vector<std::string_view> parts;
+        std::size_t start = 0;
+        for (auto end = header.find(';'); end != std::string_view::npos;
+             end = header.find(';', start)) {
+            parts.push_back(header.substr(start, end - start));
+            start = end + 1;
+        }
+
+        if (parts.size() % 3 != 0) {
+            throw std::runtime_error("Malformed header: " + std::string(header));
+        }
+
+        for (std::size_t i = 0; i < parts.size(); i += 3) {
+            if (not _columns.empty() and _columns.back().Encoding != ColumnEncoding::Raw) {
+                throw std::runtime_error("Only the last column can be encoded: "
+                                         + std::string(header));
+            }
+
+            ColumnInfo col;
+            col.Name = parts[i];
+            // "type:encoding"
+            const auto type = parts[i + 1];
+            const auto colon = type.find(':');
+            col.Type = type.substr(0, colon);
+            if (colon != std::string_view::npos) {
+                col.Encoding = encoding_from_string(type.substr(colon + 1));
+                if (col.Type != "uint16") {
+                    throw std::runtime_error("Only uint16 columns can be encoded: "
+                                             + std::string(header));
+                }
+            }
+            col.TypeSize = _type_size(col.Type);
+
+            auto sizes = parts[i + 2];
+            std::size_t size_start = 0;
+            while (not sizes.empty() and size_start <= sizes.size()) {
+                auto size_end = std::min(sizes.find(',', size_start), sizes.size());
+                col.Shape.push_back(std::stoull(
+                    std::string(sizes.substr(size_start, size_end - size_start))));
+                size_start = size_end + 1;
+            }
+
+            if (col.Shape.empty()) {
+                col.Shape.push_back(1);
+            }
+
+            col.Length = std::accumulate(col.Shape.begin(), col.Shape.end(),
+                                         std::size_t{1}, std::multiplies<std::size_t>());
+            col.Offset = _record_size;
+            if (col.Encoding == ColumnEncoding::Raw) {
+                _record_size += col.Length*col.TypeSize;
+            }
+            _columns.push_back(std::move(col));
+        }
+    }
+
+    const std::vector<ColumnInfo>& columns() const { return _columns; }
+    // Without the encoded column, if there is one
+    std::size_t record_size() const { return _record_size; }
+
+    bool isEncoded() const {
+        return not _columns.empty() and _columns.back().Encoding != ColumnEncoding::Raw;
+    }
+
+    // True if the last column is not in the records but in streams,
+    // see Reader::read_chunked()
+    bool isChunked() const {
+        return not _columns.empty()
+            and _columns.back().Encoding == ColumnEncoding::ChannelChunked;
+    }
+
+    // Throws if there is no column named name
+    const ColumnInfo& at(std::string_view name) const {
+        auto it = std::find_if(_columns.begin(), _columns.end(),
+            [&](const ColumnInfo& col) { return col.Name == name; });
+        if (it == _columns.end()) {
+            throw std::out_of_range("No column named " + std::string(name));
+        }
+
+        return *it;
+    }
+};
+
+// A record (an event or a configuration) inside the mapped file.
+class RecordView {
+    const Schema* _schema = nullptr;
+    const std::byte* _data = nullptr;
+    // In bytes
+    std::size_t _size = 0;
+
+    template<typename T>
+    const ColumnInfo& _typed_column(std::string_view name) const {
+        const auto& col = _schema->at(name);
+        if (col.Type != Tools::type_to_string<T>()) {
+            throw std::runtime_error("Column " + col.Name + " is " + col.Type
+                + " not " + std::string(Tools::type_to_string<T>()));
+        }
+
+        return col;
+    }
+
+    static void _check_not_chunked(const ColumnInfo& col) {
+        if (col.Encoding == ColumnEncoding::ChannelChunked) {
+            throw std::runtime_error("Column " + col.Name
+                + " is saved by rows, use Reader::read_chunked()");
+        }
+    }
+
+    // A damaged file can have records shorter than their schema
+    void _check_in_record(const ColumnInfo& col) const {
+        const std::size_t size = col.Encoding == ColumnEncoding::Raw ?
+            col.Length*col.TypeSize : 0;
+        if (col.Offset + size > _size) {
+            throw std::runtime_error("Column " + col.Name
+                + " goes past the end of the record");
+        }
+    }
+
+ public:
+    RecordView(const Schema& schema, const std::byte* data, const std::size_t& size) :
+        _schema{&schema}, _data{data}, _size{size} {}
+
+    const Schema& schema() const { return *_schema; }
+
+    // Bytes of the column, still encoded if it is. Never copies.
+    std::span<const std::byte> raw(std::string_view name) const {
+        const auto& col = _schema->at(name);
+        _check_in_record(col);
+        if (col.Encoding != ColumnEncoding::Raw) {
+            return {_data + col.Offset, _size - std::min(_size, col.Offset)};
+        }
+
+        return {_data + col.Offset, col.Length*col.TypeSize};
+    }
+
+    // Column as T without copying. The files are packed, so it throws if
+    // the column is not aligned for T or is encoded; use read() in that case.
+    template<typename T>
+    std::span<const T> get(std::string_view name) const {
+        const auto& col = _typed_column<T>(name);
+        _check_not_chunked(col);
+        if (col.Encoding != ColumnEncoding::Raw) {
+            throw std::runtime_error("Column " + col.Name + " is encoded");
+        }
+
+        _check_in_record(col);
+        const std::byte* ptr = _data + col.Offset;
+        if (reinterpret_cast<std::uintptr_t>(ptr) % alignof(T) != 0) {
+            throw std::runtime_error("Column " + col.Name + " is not aligned");
+        }
+
+        return {reinterpret_cast<const T*>(ptr), col.Length};
+    }
+
+    // Copy of the column as T, decoded if it is encoded.
+    template<typename T>
+    std::vector<T> read(std::string_view name) const {
+        const auto& col = _typed_column<T>(name);
+        _check_not_chunked(col);
+        std::vector<T> out(col.Length);
+        if constexpr (std::is_same_v<T, uint16_t>) {
+            if (col.Encoding == ColumnEncoding::DeltaZigZagBitPack) {
+                const auto encoded = raw(name);
+                DeltaZigZagCodec::decode(
+                    {reinterpret_cast<const char*>(encoded.data()), encoded.size()},
+                    col.Shape.back(), out);
+                return out;
+            }
+        }
+
+        _check_in_record(col);
+        std::memcpy(out.data(), _data + col.Offset, col.Length*sizeof(T));
+        return out;
+    }
+
+    // First item of the column, for scalars.
+    template<typename T>
+    T value(std::string_view name) const {
+        const auto& col = _typed_column<T>(name);
+        if (col.Encoding != ColumnEncoding::Raw) {
+            return read<T>(name).at(0);
+        }
+
+        _check_in_record(col);
+        T out;
+        std::memcpy(&out, _data + col.Offset, sizeof(T));
+        return out;
+    }
+};
+
+// Result of Reader::verify_checksums()
+struct ChecksumReport {
+    // Bytes of the file that are corrupted and the events in them
+    struct BadRange {
+        uint64_t Offset = 0;
+        uint64_t Size = 0;
+        std::size_t FirstEvent = 0;
+        // 0 if only other blocks (ex: CONF) are corrupted
+        std::size_t NumEvents = 0;
+    };
+
+    uint64_t GoodBlocks = 0;
+    uint64_t BadBlocks = 0;
+    // Blocks without a checksum: written with them disabled, or after the
+    // last CRCS block of a file that was not closed
+    uint64_t UncheckedBlocks = 0;
+    std::vector<BadRange> BadRanges;
+
+    bool isOk() const { return BadRanges.empty(); }
+};
+
+// Reads SBC binary files (version 1 and 2) through a memory map.
+// Events are accessed by index without reading the rest of the file.
+class Reader {
+    MappedFile _file;
+    uint16_t _version = 1;
+    Schema _event_schema;
+    // Offset of every event in the file
+    std::vector<std::size_t> _event_offsets;
+    // From the INDX footer, empty if the file does not have one
+    std::vector<uint64_t> _event_keys;
+    bool _has_index = false;
+    // Where the blocks of a version 2 file start
+    std::size_t _blocks_start = 0;
+
+    struct ConfigBlock {
+        std::size_t FirstEvent;
+        Schema Layout;
+        std::size_t Offset;
+    };
+    std::vector<ConfigBlock> _configs;
+
+    // Streams of records next to the events, by id
+    struct StreamChunk {
+        uint16_t Stream;
+        // Of the first record
+        std::size_t Offset;
+        uint64_t FirstRecord;
+        uint32_t NumRecords;
+    };
+    struct RecordStream {
+        std::string Name;
+        Schema Layout;
+        uint64_t NumRecords = 0;
+        // Positions in _chunks
+        std::vector<std::size_t> Chunks;
+    };
+    std::vector<RecordStream> _streams;
+    // In file order
+    std::vector<StreamChunk> _chunks;
+
+    template<typename T>
+    T _read_at(const std::size_t& offset) const {
+        if (offset + sizeof(T) > _file.size()) {
+            throw std::runtime_error("File is too short");
+        }
+
+        T out;
+        std::memcpy(&out, _file.data().data() + offset, sizeof(T));
+        return out;
+    }
+
+    std::string_view _string_at(const std::size_t& offset, const std::size_t& size) const {
+        if (offset + size > _file.size()) {
+            throw std::runtime_error("File is too short");
+        }
+
+        return {reinterpret_cast<const char*>(_file.data().data()) + offset, size};
+    }
+
+    // Version 2 events are blocks, so their size is in the block header
+    std::size_t _event_size(const std::size_t& offset) const {
+        if (_version == 1) {
+            return _event_schema.record_size();
+        }
+
+        uint32_t size;
+        std::memcpy(&size, _file.data().data() + offset - sizeof(size), sizeof(size));
+        return size;
+    }
+
+    // Only encoded events change their size
+    bool _valid_event_size(const std::size_t& size) const {
+        if (_event_schema.isEncoded() and not _event_schema.isChunked()) {
+            return size >= _event_schema.record_size();
+        }
+        return size == _event_schema.record_size();
+    }
+
+    static void _check_endianess(const uint32_t& endianess) {
+        if (endianess != 0x01020304) {
+            throw std::runtime_error("File endianess is different than this computer");
+        }
+    }
+
+    void _read_v1() {
+        _check_endianess(_read_at<uint32_t>(0));
+        const auto header_size = _read_at<uint16_t>(4);
+        _event_schema = Schema(_string_at(6, header_size));
+        if (_event_schema.isEncoded()) {
+            throw std::runtime_error("Version 1 files cannot have encoded columns");
+        }
+
+        // num_lines is only written on close, so the events are what fits
+        const std::size_t data_start = 6 + header_size + sizeof(int32_t);
+        const std::size_t event_size = _event_schema.record_size();
+        if (event_size == 0 or data_start > _file.size()) {
+            return;
+        }
+
+        const std::size_t num_events = (_file.size() - data_start) / event_size;
+        _event_offsets.resize(num_events);
+        for (std::size_t i = 0; i < num_events; i++) {
+            _event_offsets[i] = data_start + i*event_size;
+        }
+    }
+
+    void _add_config(const std::size_t& first_event, const std::size_t& payload) {
+        const auto config_header_size = _read_at<uint16_t>(payload);
+        _configs.push_back(ConfigBlock{
+            first_event,
+            Schema(_string_at(payload + sizeof(uint16_t), config_header_size)),
+            payload + sizeof(uint16_t) + config_header_size});
+    }
+
+    // Returns false if the STRM block at offset is not the next stream
+    bool _add_stream(const std::size_t& offset) {
+        const auto payload_size = _read_at<uint32_t>(offset + kStreamBlockTag.size());
+        StreamDeclaration declaration;
+        if (not declaration.parse(_string_at(offset + kBlockHeaderSize, payload_size))
+            or declaration.Id != _streams.size()) {
+            return false;
+        }
+
+        RecordStream stream;
+        stream.Name = declaration.Name;
+        try {
+            stream.Layout = Schema(declaration.Header);
+        } catch (const std::exception&) {
+            return false;
+        }
+
+        if (stream.Layout.isEncoded()) {
+            return false;
+        }
+        _streams.push_back(std::move(stream));
+        return true;
+    }
+
+    // Returns false if the SDAT block at offset does not fit its stream
+    bool _add_chunk(const std::size_t& offset) {
+        const auto payload_size = _read_at<uint32_t>(offset + kStreamDataBlockTag.size());
+        const std::size_t payload = offset + kBlockHeaderSize;
+        if (payload_size < kStreamDataHeaderSize) {
+            return false;
+        }
+
+        const auto id = _read_at<uint16_t>(payload);
+        const auto num_records = _read_at<uint32_t>(payload + sizeof(uint32_t));
+        if (id >= _streams.size() or payload_size - kStreamDataHeaderSize
+                != uint64_t{num_records}*_streams[id].Layout.record_size()) {
+            return false;
+        }
+
+        auto& stream = _streams[id];
+        stream.Chunks.push_back(_chunks.size());
+        _chunks.push_back({id, payload + kStreamDataHeaderSize, stream.NumRecords, num_records});
+        stream.NumRecords += num_records;
+        return true;
+    }
+
+    // Uses the INDX footer. Returns false if the file does not have one.
+    bool _read_index() {
+        if (_file.size() < kTrailerSize) {
+            return false;
+        }
+
+        const uint64_t index_offset = Tools::read_trailer(
+            _string_at(_file.size() - kTrailerSize, kTrailerSize), _file.size());
+        if (index_offset == 0 or _string_at(index_offset, kIndexBlockTag.size())
+                != std::string_view(kIndexBlockTag.data(), kIndexBlockTag.size())) {
+            return false;
+        }
+
+        const auto payload_size = _read_at<uint32_t>(index_offset + kIndexBlockTag.size());
+        EventIndex index;
+        if (not index.parse(_string_at(index_offset + kBlockHeaderSize, payload_size))) {
+            return false;
+        }
+
+        // The events are not read, but at least they must be in the file
+        const std::size_t event_size = kBlockHeaderSize + _event_schema.record_size();
+        if (std::any_of(index.EventOffsets.begin(), index.EventOffsets.end(),
+                [&](const uint64_t& offset) { return offset + event_size > index_offset; })) {
+            return false;
+        }
+
+        _event_offsets.resize(index.EventOffsets.size());
+        std::transform(index.EventOffsets.begin(), index.EventOffsets.end(),
+                       _event_offsets.begin(),
+                       [](const uint64_t& offset) { return offset + kBlockHeaderSize; });
+        _event_keys = std::move(index.EventKeys);
+
+        for (std::size_t i = 0; i < index.ConfigOffsets.size(); i++) {
+            _add_config(index.ConfigFirstEvents[i], index.ConfigOffsets[i] + kBlockHeaderSize);
+        }
+
+        const bool streams_ok = std::all_of(index.StreamOffsets.begin(),
+                index.StreamOffsets.end(), [&](const uint64_t& offset) {
+                    return offset < index_offset and _add_stream(offset);
+                }) and std::all_of(index.ChunkOffsets.begin(), index.ChunkOffsets.end(),
+                [&](const uint64_t& offset) {
+                    return offset < index_offset and _add_chunk(offset);
+                });
+        if (not streams_ok) {
+            _event_offsets.clear();
+            _event_keys.clear();
+            _configs.clear();
+            _streams.clear();
+            _chunks.clear();
+            return false;
+        }
+
+        _has_index = true;
+        return true;
+    }
+
+    void _read_v2() {
+        _check_endianess(_read_at<uint32_t>(4));
+        _version = _read_at<uint16_t>(8);
+        const auto header_size = _read_at<uint16_t>(10);
+        _event_schema = Schema(_string_at(12, header_size));
+        _blocks_start = 12 + header_size + sizeof(uint64_t);
+
+        if (_read_index()) {
+            return;
+        }
+
+        // Not closed, every block has to be visited
+        std::size_t pos = _blocks_start;
+        while (pos + kBlockHeaderSize <= _file.size()) {
+            BlockTag tag;
+            std::memcpy(tag.data(), _file.data().data() + pos, tag.size());
+            const auto payload_size = _read_at<uint32_t>(pos + tag.size());
+            const std::size_t payload = pos + kBlockHeaderSize;
+
+            // A block cut by a crash is ignored
+            if (payload + payload_size > _file.size()) {
+                break;
+            }
+
+            if (tag == kEventBlockTag) {
+                // Events of the wrong size (ex: damaged disks) are skipped
+                if (_valid_event_size(payload_size)) {
+                    _event_offsets.push_back(payload);
+                }
+            } else if (tag == kConfigBlockTag) {
+                _add_config(_event_offsets.size(), payload);
+            } else if (tag == kStreamBlockTag) {
+                _add_stream(pos);
+            } else if (tag == kStreamDataBlockTag) {
+                _add_chunk(pos);
+            }
+
+            pos = payload + payload_size;
+        }
+    }
+
+ public:
+    explicit Reader(const std::string& file_name) : _file{file_name} {
+        if (_file.size() >= kSBCv2Magic.size() and std::memcmp(
+                _file.data().data(), kSBCv2Magic.data(), kSBCv2Magic.size()) == 0) {
+            _read_v2();
+        } else {
+            _read_v1();
+        }
+    }
+
+    uint16_t version() const { return _version; }
+    const Schema& event_schema() const { return _event_schema; }
+
+    std::size_t size() const { return _event_offsets.size(); }
+
+    // True if the events were found through the INDX footer
+    bool has_index() const { return _has_index; }
+
+    // Index key of event i (its time stamp for SiPM files).
+    // Throws if the file has no index.
+    uint64_t key(const std::size_t& i) const {
+        if (not _has_index) {
+            throw std::runtime_error("File has no index");
+        }
+
+        return _event_keys.at(i);
+    }
+
+    // First event with a key not less than key, size() if there is none.
+    // The keys must be sorted. Throws if the file has no index.
+    std::size_t find_key(const uint64_t& key) const {
+        if (not _has_index) {
+            throw std::runtime_error("File has no index");
+        }
+
+        return static_cast<std::size_t>(std::distance(_event_keys.begin(),
+            std::lower_bound(_event_keys.begin(), _event_keys.end(), key)));
+    }
+
+    RecordView operator[](const std::size_t& i) const {
+        return {_event_schema, _file.data().data() + _event_offsets[i],
+                _event_size(_event_offsets[i])};
+    }
+
+    // Throws if i is out of range
+    RecordView event(const std::size_t& i) const {
+        if (i >= size()) {
+            throw std::out_of_range("No event " + std::to_string(i));
+        }
+
+        return (*this)[i];
+    }
+
+    // Configuration blocks, version 2 only
+    std::size_t num_configs() const { return _configs.size(); }
+
+    RecordView config(const std::size_t& i) const {
+        const auto& conf = _configs.at(i);
+        return {conf.Layout, _file.data().data() + conf.Offset, conf.Layout.record_size()};
+    }
+
+    // Index of the configuration that applies to event i.
+    // Throws if there is none.
+    std::size_t config_index_for(const std::size_t& i) const {
+        auto it = std::upper_bound(_configs.begin(), _configs.end(), i,
+            [](const std::size_t& event, const ConfigBlock& conf) {
+                return event < conf.FirstEvent;
+            });
+        if (it == _configs.begin()) {
+            throw std::out_of_range("No configuration before event "
+                                    + std::to_string(i));
+        }
+
+        return static_cast<std::size_t>(std::distance(_configs.begin(), it)) - 1;
+    }
+
+    // Streams of records saved next to the events, version 2 only
+    std::size_t num_streams() const { return _streams.size(); }
+
+    const std::string& stream_name(const std::size_t& stream) const {
+        return _streams.at(stream).Name;
+    }
+
+    // Throws if there is no stream called name
+    std::size_t stream_index(std::string_view name) const {
+        auto it = std::find_if(_streams.begin(), _streams.end(),
+            [&](const RecordStream& stream) { return stream.Name == name; });
+        if (it == _streams.end()) {
+            throw std::out_of_range("No stream named " + std::string(name));
+        }
+
+        return static_cast<std::size_t>(std::distance(_streams.begin(), it));
+    }
+
+    const Schema& stream_schema(const std::size_t& stream) const {
+        return _streams.at(stream).Layout;
+    }
+
+    std::size_t stream_size(const std::size_t& stream) const {
+        return _streams.at(stream).NumRecords;
+    }
+
+    // Record i of a stream. Throws if it is out of range.
+    RecordView stream_record(const std::size_t& stream, const std::size_t& i) const {
+        const auto& info = _streams.at(stream);
+        if (i >= info.NumRecords) {
+            throw std::out_of_range("No record " + std::to_string(i) + " in " + info.Name);
+        }
+
+        auto it = std::upper_bound(info.Chunks.begin(), info.Chunks.end(), i,
+            [&](const std::size_t& record, const std::size_t& chunk) {
+                return record < _chunks[chunk].FirstRecord;
+            });
+        const auto& chunk = _chunks[*std::prev(it)];
+        const std::size_t record_size = info.Layout.record_size();
+        return {info.Layout, _file.data().data() + chunk.Offset
+                + (i - chunk.FirstRecord)*record_size, record_size};
+    }
+
+    // Copy of the ChannelChunked column of event i. Its rows are the
+    // records i of the "{column}/{row}" streams. Throws if a row of the
+    // event is not in the file.
+    template<typename T>
+    std::vector<T> read_chunked(std::string_view column, const std::size_t& i) const {
+        const auto& col = _event_schema.at(column);
+        if (col.Encoding != ColumnEncoding::ChannelChunked) {
+            throw std::runtime_error("Column " + col.Name + " is not saved by rows");
+        }
+
+        if (col.Type != Tools::type_to_string<T>()) {
+            throw std::runtime_error("Column " + col.Name + " is " + col.Type
+                + " not " + std::string(Tools::type_to_string<T>()));
+        }
+
+        const std::size_t row_length = col.Shape.back();
+        std::vector<T> out(col.Length);
+        for (std::size_t row = 0; row < col.Length / row_length; row++) {
+            const auto record = stream_record(
+                stream_index(col.Name + "/" + std::to_string(row)), i);
+            const auto bytes = record.raw(col.Name);
+            if (bytes.size() != row_length*sizeof(T)) {
+                throw std::runtime_error("Row " + std::to_string(row) + " of "
+                                         + col.Name + " has the wrong size");
+            }
+
+            std::memcpy(out.data() + row*row_length, bytes.data(), bytes.size());
+        }
+        return out;
+    }
+
+    // Calls on_event(i, event) and on_record(stream, i, record) for all the
+    // events and stream records in the order they are in the file, so
+    // conditions and events can be read in a single pass.
+    template<typename EventFunc, typename RecordFunc>
+    void for_each_in_file_order(EventFunc&& on_event, RecordFunc&& on_record) const {
+        std::size_t event = 0;
+        for (const auto& chunk : _chunks) {
+            for (; event < size() and _event_offsets[event] < chunk.Offset; event++) {
+                on_event(event, (*this)[event]);
+            }
+
+            const auto& stream = _streams[chunk.Stream];
+            const std::size_t record_size = stream.Layout.record_size();
+            for (uint32_t j = 0; j < chunk.NumRecords; j++) {
+                on_record(std::size_t{chunk.Stream}, chunk.FirstRecord + j,
+                          RecordView(stream.Layout, _file.data().data() + chunk.Offset
+                                     + j*record_size, record_size));
+            }
+        }
+
+        for (; event < size(); event++) {
+            on_event(event, (*this)[event]);
+        }
+    }
+
+    class Iterator {
+        const Reader* _reader;
+        std::size_t _index;
+     public:
+        using value_type = RecordView;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator(const Reader* reader, const std::size_t& index) :
+            _reader{reader}, _index{index} {}
+
+        RecordView operator*() const { return (*_reader)[_index]; }
+        Iterator& operator++() { _index++; return *this; }
+        Iterator operator++(int) { auto tmp = *this; _index++; return tmp; }
+        bool operator==(const Iterator& other) const = default;
+    };
+
+    Iterator begin() const { return {this, 0}; }
+    Iterator end() const { return {this, size()}; }
+
+    // Calls func(index, event) for every event in [first, last) split in
+    // num_threads contiguous ranges, each in its own thread. func must
+    // be safe to call from several threads at once.
+    template<typename Func>
+    void for_each(std::size_t first, std::size_t last, Func&& func,
+                  std::size_t num_threads = std::thread::hardware_concurrency()) const {
+        last = std::min(last, size());
+        if (first >= last) {
+            return;
+        }
+
+        num_threads = std::clamp<std::size_t>(num_threads, 1, last - first);
+        const std::size_t chunk = (last - first + num_threads - 1) / num_threads;
+
+        std::vector<std::thread> workers;
+        for (std::size_t start = first; start < last; start += chunk) {
+            workers.emplace_back([&, start]() {
+                const std::size_t end = std::min(start + chunk, last);
+                for (std::size_t i = start; i < end; i++) {
+                    func(i, (*this)[i]);
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    template<typename Func>
+    void for_each(Func&& func,
+                  std::size_t num_threads = std::thread::hardware_concurrency()) const {
+        for_each(0, size(), std::forward<Func>(func), num_threads);
+    }
+
+    // Checks the CRC32C of every block covered by a CRCS block, with the
+    // groups of checksums split in num_threads threads. A block header
+    // that is corrupted can make the rest of its group be reported too.
+    // Version 1 files do not have checksums.
+    ChecksumReport verify_checksums(
+            std::size_t num_threads = std::thread::hardware_concurrency()) const {
+        ChecksumReport report;
+        if (_version == 1) {
+            report.UncheckedBlocks = size();
+            return report;
+        }
+
+        struct Block {
+            uint64_t Offset;
+            // Including the block header
+            uint64_t Size;
+        };
+        std::vector<Block> blocks;
+        std::vector<Block> checksum_blocks;
+        std::vector<ChecksumReport::BadRange> bad_ranges;
+
+        const auto data = _string_at(0, _file.size());
+        auto is_tag = [&](const std::size_t& pos) {
+            return std::all_of(data.begin() + pos, data.begin() + pos + 4,
+                [](const char& c) { return (c >= 'A' and c <= 'Z') or (c >= '0' and c <= '9'); });
+        };
+
+        // Next known block after pos, npos if there is none
+        auto find_next_block = [&](const std::size_t& pos) {
+            std::size_t next = std::string_view::npos;
+            for (const auto& tag : {kEventBlockTag, kConfigBlockTag, kChecksumBlockTag,
+                                    kIndexBlockTag, kStreamBlockTag, kStreamDataBlockTag}) {
+                next = std::min(next, data.find(std::string_view(tag.data(), tag.size()), pos));
+            }
+            return next;
+        };
+
+        std::size_t pos = _blocks_start;
+        while (pos + kBlockHeaderSize <= data.size()) {
+            const auto payload_size = _read_at<uint32_t>(pos + kBlockHeaderSize - sizeof(uint32_t));
+            const uint64_t block_size = kBlockHeaderSize + payload_size;
+            if (not is_tag(pos) or pos + block_size > data.size()) {
+                // Corrupted if there are blocks after it, otherwise the
+                // end of a file that was not closed
+                const auto next = find_next_block(pos + 1);
+                if (next == std::string_view::npos) {
+                    break;
+                }
+
+                bad_ranges.push_back({pos, next - pos, 0, 0});
+                pos = next;
+                continue;
+            }
+
+            const auto tag = data.substr(pos, 4);
+            if (tag == std::string_view(kChecksumBlockTag.data(), 4)) {
+                checksum_blocks.push_back({pos, block_size});
+            } else if (tag != std::string_view(kIndexBlockTag.data(), 4)
+                       and tag != std::string_view(kTrailerBlockTag.data(), 4)) {
+                blocks.push_back({pos, block_size});
+            }
+            pos += block_size;
+        }
+
+        // 0 = unchecked, 1 = good, 2 = bad. Every group has its own blocks.
+        std::vector<uint8_t> status(blocks.size(), 0);
+        auto verify_group = [&](const Block& group) {
+            const uint64_t count = (group.Size - kBlockHeaderSize - sizeof(uint64_t))
+                / sizeof(uint32_t);
+            const auto first = _read_at<uint64_t>(group.Offset + kBlockHeaderSize);
+            auto it = std::lower_bound(blocks.begin(), blocks.end(), first,
+                [](const Block& block, const uint64_t& offset) { return block.Offset < offset; });
+            auto k = static_cast<std::size_t>(std::distance(blocks.begin(), it));
+            for (uint64_t j = 0; j < count and k < blocks.size(); j++, k++) {
+                // Past the CRCS block means a block is missing
+                if (blocks[k].Offset >= group.Offset) {
+                    break;
+                }
+
+                const auto expected = _read_at<uint32_t>(group.Offset + kBlockHeaderSize
+                    + sizeof(uint64_t) + j*sizeof(uint32_t));
+                const auto crc = crc32c(data.data() + blocks[k].Offset, blocks[k].Size);
+                status[k] = crc == expected ? 1 : 2;
+            }
+        };
+
+        std::erase_if(checksum_blocks, [](const Block& group) {
+            return group.Size < kBlockHeaderSize + sizeof(uint64_t)
+                or (group.Size - kBlockHeaderSize - sizeof(uint64_t)) % sizeof(uint32_t) != 0;
+        });
+
+        num_threads = std::clamp<std::size_t>(num_threads, 1,
+                                              std::max<std::size_t>(checksum_blocks.size(), 1));
+        const std::size_t chunk = (checksum_blocks.size() + num_threads - 1) / num_threads;
+        std::vector<std::thread> workers;
+        for (std::size_t start = 0; start < checksum_blocks.size(); start += chunk) {
+            workers.emplace_back([&, start]() {
+                const std::size_t end = std::min(start + chunk, checksum_blocks.size());
+                for (std::size_t i = start; i < end; i++) {
+                    verify_group(checksum_blocks[i]);
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (std::size_t k = 0; k < blocks.size(); k++) {
+            if (status[k] == 0) {
+                report.UncheckedBlocks++;
+            } else if (status[k] == 1) {
+                report.GoodBlocks++;
+            } else {
+                report.BadBlocks++;
+                bad_ranges.push_back({blocks[k].Offset, blocks[k].Size, 0, 0});
+            }
+        }
+
+        // Touching ranges are merged and the events in them counted
+        std::sort(bad_ranges.begin(), bad_ranges.end(),
+                  [](const auto& a, const auto& b) { return a.Offset < b.Offset; });
+        for (const auto& range : bad_ranges) {
+            if (not report.BadRanges.empty()) {
+                auto& last = report.BadRanges.back();
+                if (range.Offset <= last.Offset + last.Size) {
+                    last.Size = std::max(last.Size, range.Offset + range.Size - last.Offset);
+                    continue;
+                }
+            }
+            report.BadRanges.push_back(range);
+        }
+
+        for (auto& range : report.BadRanges) {
+            const auto first = std::lower_bound(_event_offsets.begin(), _event_offsets.end(),
+                                                range.Offset);
+            const auto last = std::lower_bound(first, _event_offsets.end(),
+                                               range.Offset + range.Size);
+            range.FirstEvent = static_cast<std::size_t>(
+                std::distance(_event_offsets.begin(), first));
+            range.NumEvents = static_cast<std::size_t>(std::distance(first, last));
+        }
+
+        return report;
+    }
+};
+
+// The files of file_name: itself if it exists, otherwise the files of its
+// rotated sequence (run.bin -> run_0000.bin, run_0001.bin...) in order.
+// Throws if there are none.
+inline std::vector<std::string> find_file_sequence(const std::string& file_name) {
+    if (std::filesystem::exists(file_name)) {
+        return {file_name};
+    }
+
+    std::vector<std::string> out;
+    for (uint32_t seq = 0;; seq++) {
+        auto name = Tools::sequenced_file_name(file_name, seq);
+        if (not std::filesystem::exists(name)) {
+            break;
+        }
+        out.push_back(std::move(name));
+    }
+
+    if (out.empty()) {
+        throw std::runtime_error("Could not find " + file_name);
+    }
+    return out;
+}
+
+// Reads a sharded run (see SiPMShardedWriter) through its manifest as a
+// single sequence of events in time stamp order. Each shard can be a
+// rotated sequence of files. Events with the same time stamp are in the
+// order of their shards.
+class ShardedReader {
+    struct Location {
+        std::size_t File;
+        std::size_t Event;
+    };
+
+    std::vector<std::unique_ptr<Reader>> _files;
+    // Of every event, in order
+    std::vector<Location> _order;
+    std::vector<uint64_t> _keys;
+
+    // Files that were not closed have no index
+    static uint64_t _key(const Reader& reader, const std::size_t& i) {
+        return reader.has_index() ? reader.key(i) : reader[i].value<uint64_t>("time_stamp");
+    }
+
+ public:
+    // Throws if the manifest or any of its files cannot be read
+    explicit ShardedReader(const std::string& manifest_name) {
+        // The next event of every shard
+        struct Cursor {
+            std::vector<std::size_t> Files;
+            std::size_t File = 0;
+            std::size_t Event = 0;
+        };
+        std::vector<Cursor> cursors;
+        std::size_t num_events = 0;
+        for (const auto& shard : ShardManifest::read(manifest_name).Files) {
+            Cursor cursor;
+            for (const auto& file_name : find_file_sequence(shard)) {
+                cursor.Files.push_back(_files.size());
+                _files.push_back(std::make_unique<Reader>(file_name));
+                num_events += _files.back()->size();
+            }
+            cursors.push_back(std::move(cursor));
+        }
+
+        // The events of a shard are in order, so they are merged taking
+        // the earliest next event of all of them. There are a few shards
+        // only, so a plain search is enough.
+        _order.reserve(num_events);
+        _keys.reserve(num_events);
+        auto skip_empty = [&](Cursor& cursor) {
+            while (cursor.File < cursor.Files.size()
+                   and cursor.Event >= _files[cursor.Files[cursor.File]]->size()) {
+                cursor.File++;
+                cursor.Event = 0;
+            }
+        };
+        for (auto& cursor : cursors) {
+            skip_empty(cursor);
+        }
+
+        while (_order.size() < num_events) {
+            Cursor* next = nullptr;
+            uint64_t next_key = 0;
+            for (auto& cursor : cursors) {
+                if (cursor.File >= cursor.Files.size()) {
+                    continue;
+                }
+
+                const auto key = _key(*_files[cursor.Files[cursor.File]], cursor.Event);
+                if (not next or key < next_key) {
+                    next = &cursor;
+                    next_key = key;
+                }
+            }
+
+            _order.push_back({next->Files[next->File], next->Event});
+            _keys.push_back(next_key);
+            next->Event++;
+            skip_empty(*next);
+        }
+    }
+
+    std::size_t size() const { return _order.size(); }
+
+    const Schema& event_schema() const { return _files.front()->event_schema(); }
+
+    // All the files of all the shards
+    std::size_t num_files() const { return _files.size(); }
+    const Reader& file(const std::size_t& i) const { return *_files.at(i); }
+
+    // File of event i and its index in it, for the configurations and
+    // streams of the file
+    std::pair<const Reader&, std::size_t> locate(const std::size_t& i) const {
+        const auto& location = _order.at(i);
+        return {*_files[location.File], location.Event};
+    }
+
+    // Time stamp of event i
+    uint64_t key(const std::size_t& i) const { return _keys.at(i); }
+
+    // First event with a time stamp not less than key, size() if there is
+    // none
+    std::size_t find_key(const uint64_t& key) const {
+        return static_cast<std::size_t>(std::distance(_keys.begin(),
+            std::lower_bound(_keys.begin(), _keys.end(), key)));
+    }
+
+    RecordView operator[](const std::size_t& i) const {
+        const auto& location = _order[i];
+        return (*_files[location.File])[location.Event];
+    }
+};
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
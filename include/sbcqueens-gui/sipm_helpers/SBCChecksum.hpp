@@ -0,0 +1,168 @@
+#ifndef SBCCHECKSUM_H
+#define SBCCHECKSUM_H
+#pragma once
+
+// C STD includes
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define SBCQUEENS_CRC32C_SSE42
+#elif defined(_M_X64) && defined(_MSC_VER)
+#include <intrin.h>
+#include <nmmintrin.h>
+#define SBCQUEENS_CRC32C_SSE42
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define SBCQUEENS_CRC32C_ARMV8
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+namespace CRC32C {
+
+    // Castagnoli polynomial, reflected
+    constexpr uint32_t kPolynomial = 0x82F63B78;
+
+    // Slicing-by-8 tables, table[k][b] is the CRC of b followed by k zeros
+    constexpr std::array<std::array<uint32_t, 256>, 8> make_tables() {
+        std::array<std::array<uint32_t, 256>, 8> tables = {};
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = b;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+            }
+            tables[0][b] = crc;
+        }
+
+        for (std::size_t k = 1; k < 8; k++) {
+            for (uint32_t b = 0; b < 256; b++) {
+                const uint32_t prev = tables[k - 1][b];
+                tables[k][b] = (prev >> 8) ^ tables[0][prev & 0xff];
+            }
+        }
+        return tables;
+    }
+
+    inline constexpr auto kTables = make_tables();
+
+    // Portable version, crc is not inverted
+    inline uint32_t update_table(uint32_t crc, const unsigned char* data, std::size_t size) {
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            // Little endian only, like the SBC files
+            word ^= crc;
+            crc = kTables[7][word & 0xff] ^ kTables[6][(word >> 8) & 0xff]
+                ^ kTables[5][(word >> 16) & 0xff] ^ kTables[4][(word >> 24) & 0xff]
+                ^ kTables[3][(word >> 32) & 0xff] ^ kTables[2][(word >> 40) & 0xff]
+                ^ kTables[1][(word >> 48) & 0xff] ^ kTables[0][word >> 56];
+            data += 8;
+            size -= 8;
+        }
+
+        while (size-- > 0) {
+            crc = (crc >> 8) ^ kTables[0][(crc ^ *data++) & 0xff];
+        }
+        return crc;
+    }
+
+#if defined(SBCQUEENS_CRC32C_SSE42)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((target("sse4.2")))
+#endif
+    inline uint32_t update_sse42(uint32_t crc, const unsigned char* data, std::size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+        uint64_t crc64 = crc;
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += 8;
+            size -= 8;
+        }
+        crc = static_cast<uint32_t>(crc64);
+#endif
+        while (size >= 4) {
+            uint32_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc = _mm_crc32_u32(crc, word);
+            data += 4;
+            size -= 4;
+        }
+
+        while (size-- > 0) {
+            crc = _mm_crc32_u8(crc, *data++);
+        }
+        return crc;
+    }
+
+    inline bool has_sse42() {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("sse4.2");
+#else
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 20)) != 0;
+#endif
+    }
+#endif
+
+#if defined(SBCQUEENS_CRC32C_ARMV8)
+    inline uint32_t update_armv8(uint32_t crc, const unsigned char* data, std::size_t size) {
+        while (size >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            crc = __crc32cd(crc, word);
+            data += 8;
+            size -= 8;
+        }
+
+        while (size-- > 0) {
+            crc = __crc32cb(crc, *data++);
+        }
+        return crc;
+    }
+#endif
+
+    using update_func = uint32_t (*)(uint32_t, const unsigned char*, std::size_t);
+
+    // The fastest version this CPU supports, chosen once
+    inline update_func best_update() {
+#if defined(SBCQUEENS_CRC32C_SSE42)
+        if (has_sse42()) {
+            return update_sse42;
+        }
+#endif
+#if defined(SBCQUEENS_CRC32C_ARMV8)
+        return update_armv8;
+#else
+        return update_table;
+#endif
+    }
+
+    inline bool is_hardware_accelerated() {
+        return best_update() != update_table;
+    }
+
+}  // namespace CRC32C
+
+// CRC32C of size bytes of data. crc is the CRC of the data before it, so
+// crc32c(b, crc32c(a)) is the CRC of a followed by b.
+inline uint32_t crc32c(const void* data, const std::size_t& size, const uint32_t& crc = 0) {
+    static const CRC32C::update_func update = CRC32C::best_update();
+    return ~update(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
@@ -0,0 +1,628 @@
+#ifndef SBCFILESINK_H
+#define SBCFILESINK_H
+#pragma once
+
+// C STD includes
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define SBCQUEENS_HAS_IO_URING
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+
+namespace SBCQueens::BinaryFormat {
+
+// Aligned heap buffer. Cache line aligned by default so the copies of the
+// big columns are aligned, and page aligned for O_DIRECT.
+class AlignedBuffer {
+    struct Deleter {
+        std::align_val_t Alignment;
+        void operator()(char* ptr) const {
+            ::operator delete[](ptr, Alignment);
+        }
+    };
+    std::unique_ptr<char[], Deleter> _data;
+    std::size_t _size = 0;
+ public:
+    explicit AlignedBuffer(const std::size_t& size, const std::size_t& alignment = 64) :
+        _data{static_cast<char*>(::operator new[](std::max<std::size_t>(size, 1),
+                                                  std::align_val_t{alignment})),
+              Deleter{std::align_val_t{alignment}}},
+        _size{size} {}
+
+    char* data() { return _data.get(); }
+    const char* data() const { return _data.get(); }
+    std::size_t size() const { return _size; }
+};
+
+// How the SBC writers send their data to the disk.
+enum class IOBackend {
+    // std::fstream, goes through the page cache
+    Buffered,
+    // O_DIRECT writes of large aligned buffers, skips the page cache.
+    // Linux only.
+    Direct,
+    // O_DIRECT writes submitted through io_uring so several of them are in
+    // flight while the next buffer is filled. Linux only.
+    IOUring
+};
+
+constexpr std::string_view io_backend_to_string(const IOBackend& backend) {
+    switch (backend) {
+        case IOBackend::Direct:
+            return "Direct";
+        case IOBackend::IOUring:
+            return "IOUring";
+        case IOBackend::Buffered:
+        default:
+            return "Buffered";
+    }
+}
+
+// When the writers make sure their data is in the disk, not only in the
+// OS cache. A crash loses at most what was written after the last sync,
+// and the partial block at the end of the file is removed the next time
+// it is opened.
+enum class DurabilityMode {
+    // Only when the file is closed
+    None,
+    // Every SyncBytes or SyncTime, whatever comes first
+    Periodic,
+    // After every batch of blocks, ex: a digitizer read for SiPM files
+    Batch
+};
+
+struct DurabilityPolicy {
+    DurabilityMode Mode = DurabilityMode::None;
+    // Only for Periodic, 0 is ignored
+    uint64_t SyncBytes = 0;
+    std::chrono::seconds SyncTime{0};
+};
+
+// fdatasync of file_name. Throws if it fails.
+inline void sync_file_data(const std::string& file_name) {
+#if defined(__linux__) || defined(__APPLE__)
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + file_name + " to sync it: "
+                                 + std::strerror(errno));
+    }
+
+#if defined(__linux__)
+    const int result = ::fdatasync(fd);
+#else
+    const int result = ::fsync(fd);
+#endif
+    const int error = errno;
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync " + file_name + ": "
+                                 + std::strerror(error));
+    }
+#elif defined(_WIN32)
+    const int fd = ::_open(file_name.c_str(), _O_RDWR | _O_BINARY);
+    if (fd < 0 or ::_commit(fd) != 0) {
+        if (fd >= 0) {
+            ::_close(fd);
+        }
+        throw std::runtime_error("Failed to sync " + file_name);
+    }
+    ::_close(fd);
+#else
+    static_cast<void>(file_name);
+#endif
+}
+
+// Output file of a writer. Data is only appended, except for write_at()
+// which overwrites bytes already written (ex: a count in the header).
+// Throws std::runtime_error if the data could not be written.
+class FileSink {
+ public:
+    virtual ~FileSink() = default;
+
+    virtual IOBackend backend() const = 0;
+    // Size of the file including what is not in the disk yet
+    virtual uint64_t size() const = 0;
+
+    virtual void write(const char* data, const std::size_t& size) = 0;
+    virtual void write_at(const uint64_t& offset, const char* data,
+                          const std::size_t& size) = 0;
+    // Gives everything written so far to the OS
+    virtual void flush() = 0;
+    // Everything written so far is in the disk once it returns
+    virtual void sync() = 0;
+    virtual void close() = 0;
+};
+
+class BufferedFileSink : public FileSink {
+    const std::string _file_name;
+    std::fstream _stream;
+    uint64_t _size = 0;
+
+ public:
+    // If append, the data goes after the current end of the file,
+    // otherwise the file is truncated.
+    BufferedFileSink(const std::string& file_name, const bool& append) :
+        _file_name{file_name}
+    {
+        if (append) {
+            _stream.open(file_name, std::ios::in | std::ios::out | std::ios::binary);
+            _stream.seekp(0, std::ios::end);
+            _size = static_cast<uint64_t>(_stream.tellp());
+        } else {
+            _stream.open(file_name, std::ios::out | std::ios::binary);
+        }
+
+        if (not _stream.is_open()) {
+            throw std::runtime_error("Could not open " + file_name);
+        }
+    }
+
+    ~BufferedFileSink() override {
+        _stream.close();
+    }
+
+    IOBackend backend() const override { return IOBackend::Buffered; }
+    uint64_t size() const override { return _size; }
+
+    void write(const char* data, const std::size_t& size) override {
+        _stream.write(data, static_cast<std::streamsize>(size));
+        _size += size;
+    }
+
+    void write_at(const uint64_t& offset, const char* data,
+                  const std::size_t& size) override {
+        const auto position = _stream.tellp();
+        _stream.seekp(static_cast<std::streamoff>(offset));
+        _stream.write(data, static_cast<std::streamsize>(size));
+        _stream.seekp(position);
+    }
+
+    void flush() override {
+        _stream.flush();
+    }
+
+    void sync() override {
+        _stream.flush();
+        sync_file_data(_file_name);
+    }
+
+    void close() override {
+        _stream.flush();
+        _stream.close();
+    }
+};
+
+#if defined(__linux__)
+// O_DIRECT file. The data is copied to page aligned buffers and every
+// full buffer is written at once. The last, partial, buffer is written
+// without O_DIRECT on close.
+class DirectFileSink : public FileSink {
+ protected:
+    constexpr static std::size_t kAlignment = 4096;
+
+    const std::string _file_name;
+    int _fd = -1;
+    std::vector<AlignedBuffer> _buffers;
+    std::size_t _current = 0;
+    // Bytes in the current buffer
+    std::size_t _fill = 0;
+    // File offset of the start of the current buffer
+    uint64_t _buffer_offset = 0;
+    uint64_t _size = 0;
+
+    [[noreturn]] void _throw_error(const std::string& what) const {
+        throw std::runtime_error(what + " " + _file_name + ": " + std::strerror(errno));
+    }
+
+    // Writes buffer i of size bytes at offset. Once it returns, the
+    // buffer can be reused unless _wait_for() says otherwise.
+    virtual void _submit(const std::size_t& i, const uint64_t& offset,
+                         const std::size_t& size) {
+        if (::pwrite(_fd, _buffers[i].data(), size, static_cast<off_t>(offset))
+                != static_cast<ssize_t>(size)) {
+            _throw_error("Failed to write");
+        }
+    }
+
+    // Waits until buffer i can be filled again
+    virtual void _wait_for(const std::size_t&) {}
+    virtual void _wait_all() {}
+
+    // Write without O_DIRECT, for the parts that are not aligned
+    void _pwrite_unaligned(const uint64_t& offset, const char* data, const std::size_t& size) {
+        const int flags = ::fcntl(_fd, F_GETFL);
+        ::fcntl(_fd, F_SETFL, flags & ~O_DIRECT);
+        const auto written = ::pwrite(_fd, data, size, static_cast<off_t>(offset));
+        ::fcntl(_fd, F_SETFL, flags);
+        if (written != static_cast<ssize_t>(size)) {
+            _throw_error("Failed to write");
+        }
+    }
+
+ public:
+    DirectFileSink(const std::string& file_name, const bool& append,
+                   const std::size_t& buffer_size = 4*1024*1024,
+                   const std::size_t& num_buffers = 1) :
+        _file_name{file_name}
+    {
+        _fd = ::open(file_name.c_str(),
+                     O_RDWR | O_CREAT | O_DIRECT | (append ? 0 : O_TRUNC), 0644);
+        if (_fd < 0) {
+            _throw_error("Could not open with O_DIRECT");
+        }
+
+        const std::size_t aligned_size = std::max(kAlignment,
+            (buffer_size + kAlignment - 1) / kAlignment * kAlignment);
+        for (std::size_t i = 0; i < std::max<std::size_t>(num_buffers, 1); i++) {
+            _buffers.emplace_back(aligned_size, kAlignment);
+        }
+
+        struct stat st;
+        if (append and ::fstat(_fd, &st) == 0) {
+            _size = static_cast<uint64_t>(st.st_size);
+        }
+
+        // The unaligned end of the file is read back so the first buffer
+        // starts aligned
+        _buffer_offset = _size / kAlignment * kAlignment;
+        _fill = static_cast<std::size_t>(_size - _buffer_offset);
+        if (_fill > 0 and ::pread(_fd, _buffers[0].data(), kAlignment,
+                                  static_cast<off_t>(_buffer_offset))
+                < static_cast<ssize_t>(_fill)) {
+            ::close(_fd);
+            _throw_error("Could not read the end of");
+        }
+    }
+
+    ~DirectFileSink() override {
+        try {
+            close();
+        } catch (const std::exception&) {}
+    }
+
+    IOBackend backend() const override { return IOBackend::Direct; }
+    uint64_t size() const override { return _size; }
+
+    void write(const char* data, const std::size_t& size) override {
+        std::size_t done = 0;
+        while (done < size) {
+            auto& buffer = _buffers[_current];
+            const std::size_t n = std::min(size - done, buffer.size() - _fill);
+            std::memcpy(buffer.data() + _fill, data + done, n);
+            _fill += n;
+            done += n;
+
+            if (_fill == buffer.size()) {
+                _submit(_current, _buffer_offset, buffer.size());
+                _buffer_offset += buffer.size();
+                _current = (_current + 1) % _buffers.size();
+                _fill = 0;
+                _wait_for(_current);
+            }
+        }
+        _size += size;
+    }
+
+    void write_at(const uint64_t& offset, const char* data,
+                  const std::size_t& size) override {
+        // Still in memory
+        if (offset >= _buffer_offset) {
+            std::memcpy(_buffers[_current].data() + (offset - _buffer_offset), data, size);
+            return;
+        }
+
+        _wait_all();
+        const std::size_t in_disk = static_cast<std::size_t>(
+            std::min<uint64_t>(size, _buffer_offset - offset));
+        _pwrite_unaligned(offset, data, in_disk);
+        if (in_disk < size) {
+            std::memcpy(_buffers[_current].data(), data + in_disk, size - in_disk);
+        }
+    }
+
+    // The last partial buffer stays in memory until it is full or the
+    // file is closed, so this only waits for the writes in flight.
+    void flush() override {
+        _wait_all();
+    }
+
+    // The partial buffer is written without O_DIRECT, it is written again
+    // once it is full.
+    void sync() override {
+        _wait_all();
+        if (_fill > 0) {
+            _pwrite_unaligned(_buffer_offset, _buffers[_current].data(), _fill);
+        }
+
+        if (::fdatasync(_fd) != 0) {
+            _throw_error("Failed to sync");
+        }
+    }
+
+    void close() override {
+        if (_fd < 0) {
+            return;
+        }
+
+        try {
+            _wait_all();
+            if (_fill > 0) {
+                _pwrite_unaligned(_buffer_offset, _buffers[_current].data(), _fill);
+            }
+        } catch (const std::exception&) {
+            ::close(std::exchange(_fd, -1));
+            throw;
+        }
+
+        ::close(std::exchange(_fd, -1));
+    }
+};
+#endif
+
+#if defined(SBCQUEENS_HAS_IO_URING)
+// Minimal io_uring with only what IOUringFileSink needs, so there is no
+// dependency on liburing.
+class IOUring {
+    int _fd = -1;
+    io_uring_params _params = {};
+
+    void* _sq_ring = MAP_FAILED;
+    std::size_t _sq_ring_size = 0;
+    void* _cq_ring = MAP_FAILED;
+    std::size_t _cq_ring_size = 0;
+    io_uring_sqe* _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t _sqes_size = 0;
+
+    unsigned* _sq_tail = nullptr;
+    unsigned* _sq_mask = nullptr;
+    unsigned* _sq_array = nullptr;
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned* _cq_mask = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+
+    template<typename T>
+    static T* _at(void* ring, const uint32_t& offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+    }
+
+    int _enter(const unsigned& to_submit, const unsigned& min_complete,
+               const unsigned& flags) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, _fd, to_submit,
+                                          min_complete, flags, nullptr, 0));
+    }
+
+ public:
+    // Throws if io_uring is not available
+    explicit IOUring(const unsigned& entries) {
+        _fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &_params));
+        if (_fd < 0) {
+            throw std::runtime_error(std::string("io_uring is not available: ")
+                                     + std::strerror(errno));
+        }
+
+        _sq_ring_size = _params.sq_off.array + _params.sq_entries*sizeof(unsigned);
+        _cq_ring_size = _params.cq_off.cqes + _params.cq_entries*sizeof(io_uring_cqe);
+        if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        }
+
+        _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+        if (_params.features & IORING_FEAT_SINGLE_MMAP) {
+            _cq_ring = _sq_ring;
+        } else if (_sq_ring != MAP_FAILED) {
+            _cq_ring = ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+        }
+
+        _sqes_size = _params.sq_entries*sizeof(io_uring_sqe);
+        if (_cq_ring != MAP_FAILED) {
+            _sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, _sqes_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+        }
+
+        if (_sqes == MAP_FAILED) {
+            _unmap();
+            throw std::runtime_error("Could not map the io_uring rings");
+        }
+
+        _sq_tail = _at<unsigned>(_sq_ring, _params.sq_off.tail);
+        _sq_mask = _at<unsigned>(_sq_ring, _params.sq_off.ring_mask);
+        _sq_array = _at<unsigned>(_sq_ring, _params.sq_off.array);
+        _cq_head = _at<unsigned>(_cq_ring, _params.cq_off.head);
+        _cq_tail = _at<unsigned>(_cq_ring, _params.cq_off.tail);
+        _cq_mask = _at<unsigned>(_cq_ring, _params.cq_off.ring_mask);
+        _cqes = _at<io_uring_cqe>(_cq_ring, _params.cq_off.cqes);
+    }
+
+    IOUring(const IOUring&) = delete;
+    IOUring& operator=(const IOUring&) = delete;
+
+    ~IOUring() {
+        _unmap();
+    }
+
+    // Submits a write of size bytes of data at offset of fd. Returns
+    // false if it could not be submitted.
+    bool write(const int& fd, const char* data, const std::size_t& size,
+               const uint64_t& offset, const uint64_t& user_data) {
+        const unsigned tail = *_sq_tail;
+        const unsigned index = tail & *_sq_mask;
+
+        io_uring_sqe& sqe = _sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_WRITE;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = static_cast<uint32_t>(size);
+        sqe.off = offset;
+        sqe.user_data = user_data;
+        _sq_array[index] = index;
+
+        std::atomic_ref<unsigned>(*_sq_tail).store(tail + 1, std::memory_order_release);
+        return _enter(1, 0, 0) == 1;
+    }
+
+    // Waits for a write to finish. Returns its user_data and result
+    // (bytes written or -errno).
+    std::pair<uint64_t, int32_t> wait() {
+        std::atomic_ref<unsigned> cq_tail(*_cq_tail);
+        while (*_cq_head == cq_tail.load(std::memory_order_acquire)) {
+            if (_enter(0, 1, IORING_ENTER_GETEVENTS) < 0 and errno != EINTR) {
+                return {0, -errno};
+            }
+        }
+
+        const unsigned head = *_cq_head;
+        const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+        std::pair<uint64_t, int32_t> out = {cqe.user_data, cqe.res};
+        std::atomic_ref<unsigned>(*_cq_head).store(head + 1, std::memory_order_release);
+        return out;
+    }
+
+ private:
+    void _unmap() {
+        if (_sqes != MAP_FAILED) {
+            ::munmap(_sqes, _sqes_size);
+        }
+        if (_cq_ring != MAP_FAILED and _cq_ring != _sq_ring) {
+            ::munmap(_cq_ring, _cq_ring_size);
+        }
+        if (_sq_ring != MAP_FAILED) {
+            ::munmap(_sq_ring, _sq_ring_size);
+        }
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+};
+
+// DirectFileSink whose buffers are written through io_uring, so up to
+// num_buffers - 1 writes are in flight while the next buffer is filled.
+class IOUringFileSink : public DirectFileSink {
+    IOUring _ring;
+    std::vector<bool> _in_flight;
+    std::vector<std::size_t> _expected;
+
+    void _reap_one() {
+        const auto [i, result] = _ring.wait();
+        if (i >= _in_flight.size()) {
+            errno = -result;
+            _throw_error("Failed to wait for the writes of");
+        }
+
+        _in_flight[i] = false;
+        if (result < 0 or static_cast<std::size_t>(result) != _expected[i]) {
+            errno = result < 0 ? -result : EIO;
+            _throw_error("Failed to write");
+        }
+    }
+
+ protected:
+    void _submit(const std::size_t& i, const uint64_t& offset,
+                 const std::size_t& size) override {
+        _in_flight[i] = true;
+        _expected[i] = size;
+        if (not _ring.write(_fd, _buffers[i].data(), size, offset, i)) {
+            _in_flight[i] = false;
+            _throw_error("Failed to submit a write of");
+        }
+    }
+
+    void _wait_for(const std::size_t& i) override {
+        while (_in_flight[i]) {
+            _reap_one();
+        }
+    }
+
+    void _wait_all() override {
+        while (std::find(_in_flight.begin(), _in_flight.end(), true) != _in_flight.end()) {
+            _reap_one();
+        }
+    }
+
+ public:
+    IOUringFileSink(const std::string& file_name, const bool& append,
+                    const std::size_t& buffer_size = 4*1024*1024,
+                    const std::size_t& num_buffers = 8) :
+        DirectFileSink(file_name, append, buffer_size, std::max<std::size_t>(num_buffers, 2)),
+        _ring{static_cast<unsigned>(std::max<std::size_t>(num_buffers, 2))},
+        _in_flight(_buffers.size(), false),
+        _expected(_buffers.size(), 0) {}
+
+    // The ring has to be there to close
+    ~IOUringFileSink() override {
+        try {
+            close();
+        } catch (const std::exception&) {}
+    }
+
+    IOBackend backend() const override { return IOBackend::IOUring; }
+};
+#endif
+
+// Opens file_name with backend. If it is not available (other OS, a file
+// system without O_DIRECT, no io_uring...), falls back to the next one:
+// IOUring -> Direct -> Buffered. Throws if the file cannot be opened.
+inline std::unique_ptr<FileSink> make_file_sink(const std::string& file_name,
+                                                const bool& append,
+                                                const IOBackend& backend) {
+#if defined(SBCQUEENS_HAS_IO_URING)
+    if (backend == IOBackend::IOUring) {
+        try {
+            return std::make_unique<IOUringFileSink>(file_name, append);
+        } catch (const std::runtime_error&) {}
+    }
+#endif
+
+#if defined(__linux__)
+    if (backend == IOBackend::IOUring or backend == IOBackend::Direct) {
+        try {
+            return std::make_unique<DirectFileSink>(file_name, append);
+        } catch (const std::runtime_error&) {}
+    }
+#endif
+
+    return std::make_unique<BufferedFileSink>(file_name, append);
+}
+
+}  // namespace SBCQueens::BinaryFormat
+
+#endif
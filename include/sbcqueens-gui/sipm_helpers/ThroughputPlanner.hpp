@@ -0,0 +1,223 @@
+#ifndef THROUGHPUTPLANNER_H
+#define THROUGHPUTPLANNER_H
+#pragma once
+
+// C STD includes
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// C++ 3rd party includes
+// my includes
+#include "sbcqueens-gui/caen_helper.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+namespace SBCQueens {
+
+// Everything the planner predicts for a given configuration. Rates are in
+// bytes/s or events/s, and times in seconds.
+struct ThroughputPlan {
+    // Channels read out through the link. For digitizers with groups the
+    // whole group is read even if only one of its channels is enabled.
+    std::size_t NumLinkChannels = 0;
+    // Raw size of one event on the link
+    std::size_t LinkBytesPerEvent = 0;
+    // Size of one event inside the SiPMDynamicWriter file, with its index
+    // entry and checksum (see SiPMDynamicWriter::event_size)
+    std::size_t FileBytesPerEvent = 0;
+    // True for dzbp: the file sizes are the largest the encoding allows
+    // and the file rates and fill time are worst cases
+    bool FileSizeIsUpperBound = false;
+
+    // At the expected trigger rate
+    double LinkDataRate = 0.0;
+    double FileDataRate = 0.0;
+    // Time until the disk is full at the expected trigger rate.
+    // Infinite if there is nothing to write.
+    double DiskFillTime = std::numeric_limits<double>::infinity();
+
+    // Limits
+    double NominalLinkBandwidth = 0.0;
+    double MaxRateNominalLink = 0.0;
+    double MaxRateMeasuredLink = 0.0;
+    double MaxRateMeasuredDisk = 0.0;
+    // The lowest of all the known limits.
+    double MaxSustainableRate = 0.0;
+
+    // True if the expected rate goes over any of the known limits
+    bool LinkSaturated = false;
+    bool DiskSaturated = false;
+};
+
+// Bytes per sample as they travel through the link. x740 packs its 12-bit
+// samples and x751 three 10-bit samples per 32-bit word, everyone else
+// sends 16-bit words.
+constexpr double caen_link_bytes_per_sample(const CAENDigitizerFamilies& fam) {
+    if (fam == CAENDigitizerFamilies::x740) {
+        return 1.5;
+    } else if (fam == CAENDigitizerFamilies::x751) {
+        return 4.0 / 3.0;
+    }
+    return 2.0;
+}
+
+// Returns the max rate that bandwidth allows for events of event_size bytes
+// 0 if any of them is unknown (0).
+inline double max_event_rate(const double& bandwidth,
+                             const std::size_t& event_size) {
+    if (bandwidth <= 0.0 or event_size == 0) {
+        return 0.0;
+    }
+    return bandwidth / static_cast<double>(event_size);
+}
+
+// Predicts the data rates and limits for a given configuration.
+//
+// traces_encoding and checksums are those of the SiPM file. expected_rate
+// is the expected trigger rate in Hz, disk_available is the free space of
+// the runs directory in bytes.
+// measured_link_rate and measured_disk_rate are the speeds (in bytes/s)
+// measured in this computer, 0 if they have not been measured and then
+// they are ignored.
+inline ThroughputPlan plan_throughput(const CAENDigitizerFamilies& fam,
+                                      const CAENConnectionType& ct,
+                                      const CAENDigitizerModelConstants& model_consts,
+                                      const CAENGlobalConfig& global_config,
+                                      const std::array<CAENGroupConfig, 8>& group_configs,
+                                      const BinaryFormat::ColumnEncoding& traces_encoding,
+                                      const bool& checksums,
+                                      const double& expected_rate,
+                                      const uint64_t& disk_available,
+                                      const double& measured_link_rate,
+                                      const double& measured_disk_rate) {
+    // Header of each CAEN event, 4 words.
+    constexpr std::size_t kCAENEventHeaderSize = 16;
+    ThroughputPlan plan;
+
+    for (std::size_t i = 0; i < group_configs.size(); i++) {
+        if (not group_configs[i].Enabled) {
+            continue;
+        }
+
+        plan.NumLinkChannels += model_consts.NumberOfGroups == 0 ?
+            1 : model_consts.NumChannelsPerGroup;
+    }
+
+    if (plan.NumLinkChannels > 0) {
+        plan.LinkBytesPerEvent = kCAENEventHeaderSize
+            + static_cast<std::size_t>(std::ceil(caen_link_bytes_per_sample(fam)
+                *plan.NumLinkChannels*global_config.RecordLength));
+    }
+
+    plan.FileBytesPerEvent = BinaryFormat::SiPMDynamicWriter::event_size(
+        model_consts, global_config, group_configs, traces_encoding, checksums);
+    plan.FileSizeIsUpperBound
+        = traces_encoding == BinaryFormat::ColumnEncoding::DeltaZigZagBitPack;
+
+    plan.LinkDataRate = expected_rate*plan.LinkBytesPerEvent;
+    plan.FileDataRate = expected_rate*plan.FileBytesPerEvent;
+    if (plan.FileDataRate > 0.0) {
+        plan.DiskFillTime = static_cast<double>(disk_available) / plan.FileDataRate;
+    }
+
+    // See caen_comm_transfer_rate for why it is multiplied by 2
+    plan.NominalLinkBandwidth = 2.0*caen_comm_transfer_rate(ct);
+    plan.MaxRateNominalLink = max_event_rate(plan.NominalLinkBandwidth,
+                                             plan.LinkBytesPerEvent);
+    plan.MaxRateMeasuredLink = max_event_rate(measured_link_rate,
+                                              plan.LinkBytesPerEvent);
+    plan.MaxRateMeasuredDisk = max_event_rate(measured_disk_rate,
+                                              plan.FileBytesPerEvent);
+
+    // The measured link speed is a better estimate than the nominal one
+    double link_limit = plan.MaxRateMeasuredLink > 0.0 ?
+        plan.MaxRateMeasuredLink : plan.MaxRateNominalLink;
+
+    plan.MaxSustainableRate = std::numeric_limits<double>::infinity();
+    for (const auto& limit : {link_limit, plan.MaxRateMeasuredDisk}) {
+        if (limit > 0.0) {
+            plan.MaxSustainableRate = std::min(plan.MaxSustainableRate, limit);
+        }
+    }
+
+    plan.LinkSaturated = link_limit > 0.0 and expected_rate > link_limit;
+    plan.DiskSaturated = plan.MaxRateMeasuredDisk > 0.0
+        and expected_rate > plan.MaxRateMeasuredDisk;
+
+    return plan;
+}
+
+// Measures the sustained write speed (in bytes/s) of the disk where dir
+// lives by writing (and then deleting) a file of total_size bytes.
+// The data is forced to the disk before the clock stops, so the OS cache
+// does not inflate the number. Returns 0 if the file could not be written.
+inline double measure_disk_write_rate(const std::string& dir,
+                                      const std::size_t& total_size = 256ull << 20,
+                                      const std::size_t& chunk_size = 4ull << 20) {
+    const auto file_name = std::filesystem::path(dir) / ".sbc_disk_speed_test.bin";
+    std::FILE* file = std::fopen(file_name.string().c_str(), "wb");
+    if (not file) {
+        return 0.0;
+    }
+
+    const std::vector<char> chunk(chunk_size, 0x5A);
+    std::size_t written = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    while (written < total_size) {
+        auto out = std::fwrite(chunk.data(), 1, chunk.size(), file);
+        written += out;
+        if (out != chunk.size()) {
+            break;
+        }
+    }
+
+    std::fflush(file);
+#ifdef _WIN32
+    _commit(_fileno(file));
+#else
+    fsync(fileno(file));
+#endif
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+    std::fclose(file);
+
+    std::error_code ec;
+    std::filesystem::remove(file_name, ec);
+
+    if (written < total_size or dt.count() <= 0.0) {
+        return 0.0;
+    }
+
+    return static_cast<double>(written) / dt.count();
+}
+
+// Free space (in bytes) of the disk where dir lives. 0 if it cannot be read.
+inline uint64_t disk_available_space(const std::string& dir) {
+    std::error_code ec;
+    auto info = std::filesystem::space(dir, ec);
+    if (ec) {
+        return 0;
+    }
+
+    return info.available;
+}
+
+}  // namespace SBCQueens
+
+#endif
@@ -25,6 +25,8 @@ void CAENGeneralConfigTab::init_tab(const toml::table& tb) {
         = CAEN_conf["OverlappingRejection"].value_or(false);
     _sipm_doe.GlobalConfig.EXTAsGate
         = CAEN_conf["TRGINasGate"].value_or(false);
+    _sipm_doe.GlobalConfig.DESMode
+        = CAEN_conf["DESMode"].value_or(false);
     _sipm_doe.GlobalConfig.EXTTriggerMode
         = static_cast<CAEN_DGTZ_TriggerMode_t>(CAEN_conf["ExternalTrigger"].value_or(0L));
     _sipm_doe.GlobalConfig.SWTriggerMode
@@ -140,6 +142,19 @@ void CAENGeneralConfigTab::draw() {
     );
 //    ImGui::Checkbox("TRG-IN as Gate", &_sipm_doe.GlobalConfig.EXTAsGate);
 
+    if (caen_model_family(_sipm_doe.Model) == CAENDigitizerFamilies::x751) {
+        constexpr auto des_mode_cb =
+                get_control<ControlTypes::Checkbox, "DES Mode">(SiPMGUIControls);
+        draw_control(des_mode_cb, _sipm_doe,
+                     _sipm_doe.GlobalConfig.DESMode,
+                     ImGui::IsItemDeactivatedAfterEdit,
+                // Callback when IsItemEdited !
+                     [&](SiPMAcquisitionData& caen_twin) {
+                         caen_twin.GlobalConfig.DESMode = _sipm_doe.GlobalConfig.DESMode;
+                     }
+        );
+    }
+
     const std::unordered_map<CAEN_DGTZ_TriggerMode_t, std::string> tgg_mode_map = {
         {CAEN_DGTZ_TriggerMode_t::CAEN_DGTZ_TRGMODE_DISABLED, "Disabled"},
         {CAEN_DGTZ_TriggerMode_t::CAEN_DGTZ_TRGMODE_ACQ_ONLY, "Acq Only"},
@@ -31,6 +31,22 @@ void IndicatorWindow::draw() {
                     "Events in buffer">(SiPMGUIIndicators);
             draw_indicator(event_in_buff_ind, _sipm_doe.NumEventsInBuffer);
 
+            constexpr auto writer_queue_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Queue Depth">(SiPMGUIIndicators);
+            draw_indicator(writer_queue_ind, _sipm_doe.WriterStats.QueueDepth);
+
+            constexpr auto writer_latency_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Latency">(SiPMGUIIndicators);
+            draw_indicator(writer_latency_ind, _sipm_doe.WriterStats.LastLatency);
+
+            constexpr auto writer_max_latency_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Writer Max Latency">(SiPMGUIIndicators);
+            draw_indicator(writer_max_latency_ind, _sipm_doe.WriterStats.MaxLatency);
+
+            constexpr auto dropped_ind = get_indicator<IndicatorTypes::Numerical,
+                    "Dropped Events">(SiPMGUIIndicators);
+            draw_indicator(dropped_ind, _sipm_doe.WriterStats.DroppedEvents);
+
             ImGui::EndTabItem();
         }
 
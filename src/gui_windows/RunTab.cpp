@@ -34,13 +34,22 @@ void RunTab::init_tab(const toml::table& cfg) {
 	_sipm_doe.RunDir = i_run_dir;
 	_slowdaq_doe.RunDir = i_run_dir;
 
+    MigrationConfig migration;
+    migration.ArchiveDir = file_conf["ArchiveDir"].value_or("");
+    migration.MaxMBps = file_conf["MigrationMBps"].value_or(0.0);
+    migration.IdleIO = file_conf["MigrationIdleIO"].value_or(true);
+    if (migration.isEnabled()) {
+        _migrator = std::make_shared<FileMigrator>(migration);
+    }
+
     // Teens stuff
     _teensy_doe.Port = t_conf["Port"].value_or("COM3");
 
     // CAEN Run stuff
     std::unordered_map<std::string, CAENConnectionType> connection_type_map =
       	{{"USB", CAENConnectionType::USB, },
-        {"A4818", CAENConnectionType::A4818}};
+        {"A4818", CAENConnectionType::A4818},
+        {"OpticalLink", CAENConnectionType::OpticalLink}};
     _sipm_doe.Model
         = CAENDigitizerModelsMap.at(CAEN_conf["Model"].value_or("DT5730B"));
     _sipm_doe.PortNum
@@ -49,6 +58,8 @@ void RunTab::init_tab(const toml::table& cfg) {
       = connection_type_map[CAEN_conf["ConnectionType"].value_or("USB")];
     _sipm_doe.VMEAddress
         = CAEN_conf["VMEAddress"].value_or(0u);
+    _sipm_doe.ConetNode
+        = CAEN_conf["ConetNode"].value_or(0);
 
     // Other/slow daq stuff
     _slowdaq_doe.PFEIFFERPort
@@ -83,9 +94,10 @@ void RunTab::draw() {
     draw_control(connect_teensy, _teensy_doe,
         tmp, [&](){ return tmp; },
         // Callback when IsItemEdited !
-        [doe = _teensy_doe, run_dir = i_run_dir]
+        [doe = _teensy_doe, run_dir = i_run_dir, migrator = _migrator]
         (TeensyControllerData& teensy_twin) {
             teensy_twin.RunDir = run_dir;
+            teensy_twin.Migrator = migrator;
             teensy_twin.Port = doe.Port;
             teensy_twin.CurrentState
                 = TeensyControllerStates::AttemptConnection;
@@ -131,7 +143,8 @@ void RunTab::draw() {
 
     static std::unordered_map<CAENConnectionType, std::string> model_map =
         {{CAENConnectionType::USB, "USB"},
-        {CAENConnectionType::A4818, "A4818 USB 3.0 to CONET Adapter"}};
+        {CAENConnectionType::A4818, "A4818 USB 3.0 to CONET Adapter"},
+        {CAENConnectionType::OpticalLink, "A2818/A3818 CONET2 Optical Link"}};
     constexpr auto connection_type =
         get_control<ControlTypes::ComboBox, "Connection Type">(SiPMGUIControls);
     draw_control(connection_type, _sipm_doe,
@@ -142,7 +155,8 @@ void RunTab::draw() {
         }, model_map
     );
 
-    if (_sipm_doe.ConnectionType == CAENConnectionType::A4818) {
+    if (_sipm_doe.ConnectionType == CAENConnectionType::A4818
+        or _sipm_doe.ConnectionType == CAENConnectionType::OpticalLink) {
         ImGui::SameLine();
         // ImGui::InputScalar("VME Address", ImGuiDataType_U32,
         //     &cgui_state.VMEAddress);
@@ -157,6 +171,18 @@ void RunTab::draw() {
 
     }
 
+    if (_sipm_doe.ConnectionType == CAENConnectionType::OpticalLink) {
+        ImGui::SameLine();
+        constexpr auto conet_node = get_control<ControlTypes::InputInt,
+            "CONET Node">(SiPMGUIControls);
+        draw_control(conet_node, _sipm_doe,
+            _sipm_doe.ConetNode, ImGui::IsItemEdited,
+            // Callback when IsItemEdited !
+            [&](SiPMAcquisitionData& caen_twin) {
+              caen_twin.ConetNode = _sipm_doe.ConetNode;
+        });
+    }
+
     constexpr auto keith_com = get_control<ControlTypes::InputText,
                                     "Keithley COM Port">(SiPMGUIControls);
     draw_control(keith_com, _sipm_doe,
@@ -176,11 +202,12 @@ void RunTab::draw() {
     draw_control(connect_caen, _sipm_doe,
         tmp, [&](){ return tmp; },
         // Callback when tmp is true !
-        [doe = _sipm_doe, run_dir = i_run_dir]
+        [doe = _sipm_doe, run_dir = i_run_dir, migrator = _migrator]
         (SiPMAcquisitionData& caen_twin) {
             caen_twin = doe;
 
             caen_twin.RunDir = run_dir;
+            caen_twin.Migrator = migrator;
             caen_twin.CurrentState = SiPMAcquisitionManagerStates::Acquisition;
             caen_twin.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
     });
@@ -192,13 +219,27 @@ void RunTab::draw() {
         tmp, [&](){ return tmp; },
         // Callback when tmp is true !
         [](SiPMAcquisitionData& caen_twin) {
-            if(caen_twin.CurrentState == SiPMAcquisitionManagerStates::Acquisition) {
+            if(caen_twin.CurrentState == SiPMAcquisitionManagerStates::Acquisition or
+               caen_twin.CurrentState == SiPMAcquisitionManagerStates::WarmStandby) {
                 caen_twin.CurrentState = SiPMAcquisitionManagerStates::Standby;
             }
     });
 
     ImGui::SameLine();
 
+    constexpr auto warm_standby_caen_btn = get_control<ControlTypes::Button,
+                                        "Warm Standby##CAEN">(SiPMGUIControls);
+    draw_control(warm_standby_caen_btn, _sipm_doe,
+        tmp, [&](){ return tmp; },
+        // Callback when tmp is true !
+        [](SiPMAcquisitionData& caen_twin) {
+            if(caen_twin.CurrentState == SiPMAcquisitionManagerStates::Acquisition) {
+                caen_twin.CurrentState = SiPMAcquisitionManagerStates::WarmStandby;
+            }
+    });
+
+    ImGui::SameLine();
+
     constexpr auto caen_connected_led = get_indicator<IndicatorTypes::LED,
                                         "##CAEN Connected?">(SiPMGUIIndicators);
     draw_indicator(caen_connected_led, _sipm_doe.CurrentState,
@@ -224,7 +265,8 @@ void RunTab::draw() {
     draw_control(connect_slowdaq, _slowdaq_doe,
         tmp, [&](){ return tmp; },
         // Callback when tmp is true !
-        [](SlowDAQData& doe_twin) {
+        [migrator = _migrator](SlowDAQData& doe_twin) {
+            doe_twin.Migrator = migrator;
             doe_twin.PFEIFFERState = PFEIFFERSSGState::AttemptConnection;
     });
 
@@ -3,6 +3,11 @@
 // C STD includes
 // C 3rd party includes
 // C++ STD includes
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
 // C++ 3rd party includes
 // my includes
 #include "sbcqueens-gui/imgui_helpers.hpp"
@@ -26,6 +31,85 @@ void SiPMControlWindow::init_window(const toml::table& tb) {
         = file_conf["RunWaveforms"].value_or(1000000ull);
     _sipm_data.VBDData.SPEEstimationTotalPulses
         = file_conf["GainWaveforms"].value_or(10000ull);
+
+    // 0 = no limit
+    _sipm_data.FileRollover.MaxBytes
+        = 1000000ull*file_conf["RolloverMaxMB"].value_or(0ull);
+    _sipm_data.FileRollover.MaxEvents
+        = file_conf["RolloverMaxEvents"].value_or(0ull);
+    _sipm_data.FileRollover.MaxTime
+        = std::chrono::seconds(file_conf["RolloverMaxSeconds"].value_or(0ll));
+    _sipm_data.FileRollover.Preallocate = file_conf["RolloverPreallocate"].value_or(true);
+
+    _sipm_data.AsyncWriter.Enabled = file_conf["AsyncWriter"].value_or(true);
+    _sipm_data.AsyncWriter.QueueSize
+        = std::max<std::size_t>(file_conf["WriterQueueSize"].value_or(64ull), 1);
+    const std::unordered_map<std::string, BinaryFormat::WriterFullPolicy> full_policies = {
+        {"Block", BinaryFormat::WriterFullPolicy::Block},
+        {"Drop", BinaryFormat::WriterFullPolicy::Drop},
+        {"Prescale", BinaryFormat::WriterFullPolicy::Prescale}};
+    auto full_policy = full_policies.find(file_conf["WriterFullPolicy"].value_or("Block"));
+    _sipm_data.AsyncWriter.FullPolicy = full_policy != full_policies.end() ?
+        full_policy->second : BinaryFormat::WriterFullPolicy::Block;
+    _sipm_data.AsyncWriter.PrescaleFactor
+        = file_conf["WriterPrescaleFactor"].value_or(10u);
+
+    const std::unordered_map<std::string, BinaryFormat::ColumnEncoding> encodings = {
+        {"raw", BinaryFormat::ColumnEncoding::Raw},
+        {"dzbp", BinaryFormat::ColumnEncoding::DeltaZigZagBitPack},
+        {"chunked", BinaryFormat::ColumnEncoding::ChannelChunked}};
+    auto encoding = encodings.find(file_conf["WaveformEncoding"].value_or("raw"));
+    _sipm_data.WaveformEncoding = encoding != encodings.end() ?
+        encoding->second : BinaryFormat::ColumnEncoding::Raw;
+
+    const std::unordered_map<std::string, BinaryFormat::IOBackend> io_backends = {
+        {"Buffered", BinaryFormat::IOBackend::Buffered},
+        {"Direct", BinaryFormat::IOBackend::Direct},
+        {"IOUring", BinaryFormat::IOBackend::IOUring}};
+    auto io_backend = io_backends.find(file_conf["IOBackend"].value_or("Buffered"));
+    _sipm_data.IOBackend = io_backend != io_backends.end() ?
+        io_backend->second : BinaryFormat::IOBackend::Buffered;
+
+    const std::unordered_map<std::string, BinaryFormat::DurabilityMode> durability_modes = {
+        {"None", BinaryFormat::DurabilityMode::None},
+        {"Periodic", BinaryFormat::DurabilityMode::Periodic},
+        {"Batch", BinaryFormat::DurabilityMode::Batch}};
+    auto durability_mode = durability_modes.find(file_conf["Durability"].value_or("None"));
+    _sipm_data.Durability.Mode = durability_mode != durability_modes.end() ?
+        durability_mode->second : BinaryFormat::DurabilityMode::None;
+    _sipm_data.Durability.SyncBytes = 1000000ull*file_conf["SyncMB"].value_or(0ull);
+    _sipm_data.Durability.SyncTime
+        = std::chrono::seconds(file_conf["SyncSeconds"].value_or(0ll));
+    _sipm_data.Checksums = file_conf["Checksums"].value_or(true);
+
+    _sipm_data.ShardDirs.clear();
+    if (const toml::array* shard_dirs = file_conf["ShardDirs"].as_array()) {
+        for (const auto& dir : *shard_dirs) {
+            const std::string name = dir.value_or(std::string{});
+            if (not name.empty()) {
+                _sipm_data.ShardDirs.push_back(name);
+            }
+        }
+    }
+
+    _sipm_data.RunQueue.clear();
+    if (const toml::array* queue = tb["RunQueue"].as_array()) {
+        for (const auto& node : *queue) {
+            const toml::table* run = node.as_table();
+            if (not run) {
+                continue;
+            }
+
+            SiPMRunQueueEntry entry;
+            entry.Name = (*run)["Name"].value_or("run"
+                + std::to_string(_sipm_data.RunQueue.size()));
+            entry.Voltage = (*run)["Voltage"].value_or(0.0f);
+            entry.Temperature = (*run)["Temperature"].value_or(0.0f);
+            entry.Events = (*run)["Events"].value_or(_sipm_data.VBDData.DataPulses);
+            entry.SettleTime = std::chrono::seconds((*run)["SettleTime"].value_or(0ll));
+            _sipm_data.RunQueue.push_back(entry);
+        }
+    }
 }
 
 void SiPMControlWindow::draw()  {
@@ -36,12 +120,15 @@ void SiPMControlWindow::draw()  {
                  tmp, [&](){ return tmp; },
             // Callback when IsItemEdited !
                  [&](SiPMAcquisitionData& doe_twin) {
-                     if (doe_twin.CurrentState != SiPMAcquisitionManagerStates::Acquisition) {
+                     if (doe_twin.CurrentState != SiPMAcquisitionManagerStates::Acquisition
+                         or doe_twin.RunQueueActive) {
                          return;
                      }
 
                      if (doe_twin.AcquisitionState == SiPMAcquisitionStates::Oscilloscope) {
-                         doe_twin.AcquisitionState = SiPMAcquisitionStates::EndlessAcquisition;
+                         doe_twin.AcquisitionState = doe_twin.VBDData.DataPulses > 0 ?
+                            SiPMAcquisitionStates::NumberedAcquisition :
+                            SiPMAcquisitionStates::EndlessAcquisition;
 
 //                if (doe_twin.SiPMVoltageSysSupplyEN) {
 //                    doe_twin.LatestTemperature = _teensy_data.PIDTempValues.SetPoint;
@@ -61,14 +148,54 @@ void SiPMControlWindow::draw()  {
                  tmp, [&](){ return tmp; },
             // Callback when IsItemEdited !
                  [](SiPMAcquisitionData& doe_twin) {
-                     if (doe_twin.AcquisitionState == SiPMAcquisitionStates::EndlessAcquisition) {
+                     doe_twin.RunQueueActive = false;
+                     if (doe_twin.AcquisitionState == SiPMAcquisitionStates::EndlessAcquisition
+                         or doe_twin.AcquisitionState == SiPMAcquisitionStates::NumberedAcquisition) {
                          doe_twin.AcquisitionState = SiPMAcquisitionStates::Oscilloscope;
                      }
                  }
     );
+
+    ImGui::SameLine();
+
+    constexpr auto run_queue_btn = get_control<ControlTypes::Button,
+            "RUN QUEUE##CAEN">(SiPMGUIControls);
+    draw_control(run_queue_btn, _sipm_data,
+                 tmp, [&](){ return tmp; },
+            // Callback when IsItemEdited !
+                 [](SiPMAcquisitionData& doe_twin) {
+                     if (doe_twin.CurrentState != SiPMAcquisitionManagerStates::Acquisition
+                         or doe_twin.AcquisitionState != SiPMAcquisitionStates::Oscilloscope
+                         or doe_twin.RunQueue.empty()) {
+                         return;
+                     }
+
+                     doe_twin.RunQueueIndex = 0;
+                     doe_twin.RunQueueActive = true;
+                 }
+    );
+
+    // The temperature of each entry is sent to the Teensy by GUIManager
+    if (not _sipm_data.RunQueueActive) {
+        ImGui::Text("Run queue: %zu runs", _sipm_data.RunQueue.size());
+    } else if (_sipm_data.RunQueueIndex < _sipm_data.RunQueue.size()) {
+        const auto& entry = _sipm_data.RunQueue[_sipm_data.RunQueueIndex];
+        ImGui::Text("Run queue: %zu/%zu %s", _sipm_data.RunQueueIndex + 1,
+                    _sipm_data.RunQueue.size(), entry.Name.c_str());
+    }
+
     ImGui::Separator();
     ImGui::PushItemWidth(120);
 
+    constexpr auto run_events_it = get_control<ControlTypes::InputUINT32,
+            "Run Events">(SiPMGUIControls);
+    draw_control(run_events_it, _sipm_data,
+                 _sipm_data.VBDData.DataPulses, ImGui::IsItemEdited,
+                 // Callback when IsItemEdited !
+                 [&](SiPMAcquisitionData& doe_twin) {
+                     doe_twin.VBDData.DataPulses = _sipm_data.VBDData.DataPulses;
+                 });
+
     constexpr auto sipm_out_filename_it = get_control<ControlTypes::InputText, "SiPM Output File Name">(SiPMGUIControls);
     draw_control(sipm_out_filename_it,
                  _sipm_data,
@@ -79,6 +206,37 @@ void SiPMControlWindow::draw()  {
                      doe_twin.SiPMOutputName = _sipm_data.SiPMOutputName;
                  });
 
+    auto& rollover = _sipm_data.FileRollover;
+    auto rollover_callback = [&](SiPMAcquisitionData& doe_twin) {
+        doe_twin.FileRollover = _sipm_data.FileRollover;
+    };
+
+    uint64_t rotate_mb = rollover.MaxBytes / 1000000ull;
+    constexpr auto rotate_size_it = get_control<ControlTypes::InputUINT64,
+            "Rotate Size [MB]">(SiPMGUIControls);
+    if (draw_control(rotate_size_it, _sipm_data, rotate_mb,
+                     ImGui::IsItemEdited, rollover_callback)) {
+        rollover.MaxBytes = 1000000ull*rotate_mb;
+    }
+
+    constexpr auto rotate_events_it = get_control<ControlTypes::InputUINT64,
+            "Rotate Events">(SiPMGUIControls);
+    draw_control(rotate_events_it, _sipm_data, rollover.MaxEvents,
+                 ImGui::IsItemEdited, rollover_callback);
+
+    auto rotate_seconds = static_cast<uint64_t>(rollover.MaxTime.count());
+    constexpr auto rotate_time_it = get_control<ControlTypes::InputUINT64,
+            "Rotate Time [s]">(SiPMGUIControls);
+    if (draw_control(rotate_time_it, _sipm_data, rotate_seconds,
+                     ImGui::IsItemEdited, rollover_callback)) {
+        rollover.MaxTime = std::chrono::seconds(rotate_seconds);
+    }
+
+    constexpr auto preallocate_it = get_control<ControlTypes::Checkbox,
+            "Preallocate Files">(SiPMGUIControls);
+    draw_control(preallocate_it, _sipm_data, rollover.Preallocate,
+                 ImGui::IsItemEdited, rollover_callback);
+
     constexpr auto sipm_id_it = get_control<ControlTypes::InputInt, "SiPM ID">(SiPMGUIControls);
     draw_control(sipm_id_it,
                  _sipm_data,
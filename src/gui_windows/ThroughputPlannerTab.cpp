@@ -0,0 +1,153 @@
+#include "sbcqueens-gui/gui_windows/ThroughputPlannerTab.hpp"
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <cmath>
+
+// C++ 3rd party includes
+#include <imgui.h>
+
+// my includes
+#include "sbcqueens-gui/imgui_helpers.hpp"
+#include "sbcqueens-gui/gui_windows/ControlList.hpp"
+#include "sbcqueens-gui/gui_windows/IndicatorList.hpp"
+#include "sbcqueens-gui/sipm_helpers/ThroughputPlanner.hpp"
+
+namespace SBCQueens {
+
+void ThroughputPlannerTab::init_tab(const toml::table& tb) {
+    auto CAEN_conf = tb["CAEN"];
+
+    _sipm_doe.ExpectedTriggerRate
+        = CAEN_conf["ExpectedTriggerRate"].value_or(100.0);
+}
+
+void ThroughputPlannerTab::draw() {
+    ImGui::PushItemWidth(120);
+
+    constexpr auto expected_rate = get_control<ControlTypes::InputDouble,
+            "Expected Trigger Rate">(SiPMGUIControls);
+    draw_control(expected_rate, _sipm_doe,
+                 _sipm_doe.ExpectedTriggerRate, ImGui::IsItemEdited,
+                 // Callback when IsItemEdited !
+                 [&](SiPMAcquisitionData& doe_twin) {
+                     doe_twin.ExpectedTriggerRate = _sipm_doe.ExpectedTriggerRate;
+                 });
+
+    ImGui::SameLine();
+
+    static bool tmp;
+    constexpr auto measure_disk = get_control<ControlTypes::Button,
+            "Measure Disk Speed">(SiPMGUIControls);
+    draw_control(measure_disk, _sipm_doe,
+                 tmp, [&](){ return tmp; },
+                 // Callback when tmp is true !
+                 [](SiPMAcquisitionData& doe_twin) {
+                     doe_twin.MeasureDiskSpeed = true;
+                 });
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Writes 256 MB to the runs directory.\n"
+            "Only done when the digitizer is in standby or warm standby.");
+    }
+
+    ImGui::Separator();
+
+    // Everything is calculated using the GUI values so the user
+    // can see the effect of a configuration before sending it.
+    const auto& model_consts = CAENDigitizerModelsConstantsMap.at(_sipm_doe.Model);
+    auto plan = plan_throughput(caen_model_family(_sipm_doe.Model),
+                                _sipm_doe.ConnectionType,
+                                model_consts,
+                                _sipm_doe.GlobalConfig,
+                                _sipm_doe.GroupConfigs,
+                                _sipm_doe.WaveformEncoding,
+                                _sipm_doe.Checksums,
+                                _sipm_doe.ExpectedTriggerRate,
+                                _sipm_doe.DiskAvailable,
+                                _sipm_doe.MeasuredLinkRate,
+                                _sipm_doe.MeasuredDiskRate);
+
+    // The numerical indicators print every digit, so we round them here
+    auto round_2 = [](const double& val) { return std::round(100.0*val) / 100.0; };
+    double link_rate_mbs = round_2(plan.LinkDataRate / 1e6);
+    double file_rate_mbs = round_2(plan.FileDataRate / 1e6);
+    double fill_time_hours = round_2(plan.DiskFillTime / 3600.0);
+    double free_space_gb = round_2(static_cast<double>(_sipm_doe.DiskAvailable) / 1e9);
+    double nominal_link_mbs = round_2(plan.NominalLinkBandwidth / 1e6);
+    double measured_link_mbs = round_2(_sipm_doe.MeasuredLinkRate / 1e6);
+    double measured_disk_mbs = round_2(_sipm_doe.MeasuredDiskRate / 1e6);
+    double max_rate = std::round(plan.MaxSustainableRate);
+
+    constexpr auto link_bytes_ind = get_indicator<IndicatorTypes::Numerical,
+            "Link Bytes per Event">(SiPMGUIIndicators);
+    draw_indicator(link_bytes_ind, plan.LinkBytesPerEvent);
+
+    constexpr auto file_bytes_ind = get_indicator<IndicatorTypes::Numerical,
+            "File Bytes per Event">(SiPMGUIIndicators);
+    draw_indicator(file_bytes_ind, plan.FileBytesPerEvent);
+
+    constexpr auto link_rate_ind = get_indicator<IndicatorTypes::Numerical,
+            "Expected Link Rate">(SiPMGUIIndicators);
+    draw_indicator(link_rate_ind, link_rate_mbs);
+
+    constexpr auto file_rate_ind = get_indicator<IndicatorTypes::Numerical,
+            "Expected File Rate">(SiPMGUIIndicators);
+    draw_indicator(file_rate_ind, file_rate_mbs);
+
+    constexpr auto fill_time_ind = get_indicator<IndicatorTypes::Numerical,
+            "Disk Fill Time">(SiPMGUIIndicators);
+    draw_indicator(fill_time_ind, fill_time_hours);
+
+    constexpr auto free_space_ind = get_indicator<IndicatorTypes::Numerical,
+            "Free Disk Space">(SiPMGUIIndicators);
+    draw_indicator(free_space_ind, free_space_gb);
+
+    if (plan.FileSizeIsUpperBound) {
+        ImGui::Text("dzbp: the file sizes are upper bounds, the real ones "
+                    "depend on the waveforms.");
+    }
+
+    ImGui::Separator();
+
+    constexpr auto nominal_link_ind = get_indicator<IndicatorTypes::Numerical,
+            "Nominal Link Speed">(SiPMGUIIndicators);
+    draw_indicator(nominal_link_ind, nominal_link_mbs);
+
+    constexpr auto measured_link_ind = get_indicator<IndicatorTypes::Numerical,
+            "Measured Link Speed">(SiPMGUIIndicators);
+    draw_indicator(measured_link_ind, measured_link_mbs);
+
+    constexpr auto measured_disk_ind = get_indicator<IndicatorTypes::Numerical,
+            "Measured Disk Speed">(SiPMGUIIndicators);
+    draw_indicator(measured_disk_ind, measured_disk_mbs);
+
+    constexpr auto max_rate_ind = get_indicator<IndicatorTypes::Numerical,
+            "Max Sustainable Rate">(SiPMGUIIndicators);
+    draw_indicator(max_rate_ind, max_rate);
+
+    constexpr auto keep_up_ind = get_indicator<IndicatorTypes::LED,
+            "Can Keep Up?">(SiPMGUIIndicators);
+    draw_indicator(keep_up_ind, plan,
+        [](const ThroughputPlan& p) -> bool {
+            return not p.LinkSaturated and not p.DiskSaturated;
+    });
+
+    if (plan.LinkSaturated) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+            "The link cannot keep up with the expected trigger rate.");
+    }
+
+    if (plan.DiskSaturated) {
+        ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f),
+            "The disk cannot keep up with the expected trigger rate.");
+    }
+
+    if (_sipm_doe.MeasuredDiskRate <= 0.0) {
+        ImGui::Text("Disk speed not measured. Only the link limit is used.");
+    }
+
+    ImGui::PopItemWidth();
+}
+
+} // namespace SBCQueens
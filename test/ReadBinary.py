@@ -15,6 +15,15 @@ file_endianness = 'little'
 
 #np.set_printoptions(threshold=np.nan)
 
+SBC2_MAGIC = b'SBC2'
+possible_data_types = {'char': 8, 'int8': 8,
+                       'int16': 16, 'int32': 32,
+                       'int64': 64, 'uint8': 8,
+                       'uint16': 16, 'uint32': 32,
+                       'uint64': 64, 'single': 32,
+                       'double': 64, 'float128': 128,
+                       'float64': 64, 'float32': 32}
+
 
 def ReadBlock(file_name, max_file_size = 2000):
     '''
@@ -24,13 +33,6 @@ def ReadBlock(file_name, max_file_size = 2000):
     If the size of the file is greater than max_file_size (in MB), then it will not open/load.
     '''
     variables_dict = OrderedDict()
-    possible_data_types = {'char': 8, 'int8': 8,
-                           'int16': 16, 'int32': 32,
-                           'int64': 64, 'uint8': 8,
-                           'uint16': 16, 'uint32': 32,
-                           'uint64': 64, 'single': 32,
-                           'double': 64, 'float128': 128,
-                           'float64': 64, 'float32': 32}
 
     # Open file here
     file_size = os.path.getsize(file_name)/1000/1000  # To get result in mb
@@ -42,6 +44,11 @@ def ReadBlock(file_name, max_file_size = 2000):
                           format(file_name, file_size, max_file_size))
 
     with open(file_name, "rb") as read_in:
+        # Version 2 files start with a magic word instead
+        if read_in.read(4) == SBC2_MAGIC:
+            return ReadBlockV2(file_name)
+        read_in.seek(0)
+
         # Check the Endianness flag of the block
         endianness = np.fromfile(read_in, dtype=np.uint32, count=1)
         # 0x01020304 = 16909060 in base 10
@@ -148,6 +155,285 @@ def ReadBlock(file_name, max_file_size = 2000):
     return variables_dict
 
 
+def ParseHeader(header_str):
+    '''
+    Turns a "name;type;size1,size2;..." header into an OrderedDict of
+    name -> (type, shape, size in bytes)
+    Encoded columns ("type:encoding") keep the encoding in their type and
+    have a size of 0, as it changes from event to event.
+    '''
+    columns = OrderedDict()
+    components = header_str.split(';')
+    for variable in range(0, len(components) - 2, 3):
+        if components[variable]:
+            shape = tuple(int(size) for size in components[variable + 2].split(','))
+            data_type = components[variable + 1]
+            num_bytes = possible_data_types[data_type.split(':')[0]] // 8
+            width = 0 if ':' in data_type else num_bytes * int(np.prod(shape))
+            columns[components[variable]] = (data_type, shape, width)
+    return columns
+
+
+def ReadLines(columns, uint8_buffer):
+    '''
+    Casts a (num_lines, bytes_per_line) uint8 array into the columns
+    '''
+    variables_dict = OrderedDict()
+    start = 0
+    num_lines = uint8_buffer.shape[0]
+    for key, (data_type, shape, width) in columns.items():
+        temp = np.ascontiguousarray(uint8_buffer[:, start:start + width])
+        sizes = (num_lines,) if shape == (1,) else (num_lines,) + shape
+        variables_dict[key] = np.reshape(Cast(data_type, temp), sizes, order='C')
+        start += width
+    return variables_dict
+
+
+def ReadIndexV2(data, data_start):
+    '''
+    Returns the EVNT, CONF, STRM and SDAT block offsets from the INDX footer
+    of a closed version 2 file, or None if the file does not end in a TRLR
+    block.
+    '''
+    if data.size < data_start + 16 or bytes(data[-16:-12]) != b'TRLR':
+        return None
+
+    index_pos = int(data[-8:].view(np.uint64)[0])
+    if index_pos < data_start or index_pos + 24 > data.size - 16 \
+            or bytes(data[index_pos:index_pos + 4]) != b'INDX':
+        return None
+
+    payload_size = int(data[index_pos + 4:index_pos + 8].view(np.uint32)[0])
+    index = data[index_pos + 8:index_pos + 8 + payload_size].view(np.uint64)
+    num_events, num_configs = int(index[0]), int(index[1])
+    streams_start = 2 + 2*num_events + 2*num_configs
+    stream_offsets, chunk_offsets = [], []
+    if index.size != streams_start:
+        # Files with streams have their offsets after the rest
+        if index.size < streams_start + 2:
+            return None
+        num_streams, num_chunks = int(index[streams_start]), int(index[streams_start + 1])
+        if index.size != streams_start + 2 + num_streams + num_chunks:
+            return None
+        stream_offsets = index[streams_start + 2:streams_start + 2 + num_streams]
+        chunk_offsets = index[streams_start + 2 + num_streams:]
+
+    event_offsets = index[2:2 + num_events].astype(np.int64)
+    config_start = 2 + 2*num_events
+    config_offsets = index[config_start:config_start + num_configs]
+    return event_offsets, config_offsets, stream_offsets, chunk_offsets
+
+
+def ReadConfigV2(data, pos):
+    '''
+    Reads the CONF block at pos as a dictionary.
+    '''
+    payload_size = int(data[pos + 4:pos + 8].view(np.uint32)[0])
+    payload = data[pos + 8:pos + 8 + payload_size]
+    conf_len = int(payload[:2].view(np.uint16)[0])
+    conf_columns = ParseHeader("".join(map(chr, payload[2:2 + conf_len])))
+    values = payload[2 + conf_len:][np.newaxis, :]
+    config = ReadLines(conf_columns, values)
+    return OrderedDict((key, val[0]) for key, val in config.items())
+
+
+def ReadStreamsV2(data, stream_offsets, chunk_offsets):
+    '''
+    Reads the records of the streams (STRM and SDAT blocks) as a dictionary
+    of stream name to its columns, as in ReadBlock.
+    '''
+    streams = []
+    for pos in stream_offsets:
+        pos = int(pos) + 8 + 2
+        name_len = int(data[pos:pos + 2].view(np.uint16)[0])
+        name = "".join(map(chr, data[pos + 2:pos + 2 + name_len]))
+        pos += 2 + name_len
+        header_len = int(data[pos:pos + 2].view(np.uint16)[0])
+        columns = ParseHeader("".join(map(chr, data[pos + 2:pos + 2 + header_len])))
+        streams.append((name, columns, []))
+
+    for pos in chunk_offsets:
+        pos = int(pos)
+        payload_size = int(data[pos + 4:pos + 8].view(np.uint32)[0])
+        stream_id = int(data[pos + 8:pos + 10].view(np.uint16)[0])
+        streams[stream_id][2].append(data[pos + 16:pos + 8 + payload_size])
+
+    out = OrderedDict()
+    for name, columns, chunks in streams:
+        record_size = sum(width for (_, _, width) in columns.values())
+        records = np.concatenate(chunks) if chunks else np.zeros(0, dtype=np.uint8)
+        out[name] = ReadLines(columns, records.reshape(-1, record_size))
+    return out
+
+
+def DecodeDZBP(encoded, shape):
+    '''
+    Decodes a "uint16:dzbp" column (delta + zig-zag + bit-packing in
+    blocks of 128 values interleaved in 8 lanes, see SBCBinaryCodec.hpp)
+    into a uint16 array of the given shape.
+    '''
+    row_length = shape[-1]
+    num_rows = int(np.prod(shape)) // row_length
+    out = np.zeros((num_rows, row_length), dtype=np.uint16)
+    pos = 0
+    for row in range(num_rows):
+        values = []
+        for _ in range(0, row_length, 128):
+            width = int(encoded[pos])
+            words = encoded[pos + 1:pos + 1 + 16*width].view(np.uint16).reshape(width, 8)
+            pos += 1 + 16*width
+            if width == 0:
+                values.append(np.zeros(128, dtype=np.int64))
+                continue
+            # The bits of each lane, lowest first
+            bits = np.unpackbits(words.T.copy().view(np.uint8), axis=1, bitorder='little')
+            lanes = bits[:, :16*width].reshape(8, 16, width).astype(np.int64) \
+                @ (1 << np.arange(width, dtype=np.int64))
+            values.append(lanes.T.reshape(128))
+        zig_zag = np.concatenate(values)[:row_length]
+        deltas = (zig_zag >> 1) ^ -(zig_zag & 1)
+        out[row] = np.cumsum(deltas) & 0xFFFF
+    return out.reshape(shape)
+
+
+def ReadBlockV2(file_name):
+    '''
+    Reads a SBC binary version 2 file. The event columns are returned as
+    in ReadBlock, the CONF blocks under 'configs' as a list of
+    dictionaries (one per block, in file order), and the records of the
+    streams under 'streams' (see ReadStreamsV2). A "uint16:chunked" column
+    is put together from its "{column}/{row}" streams; if the file was not
+    closed it can have fewer events than the other columns.
+    If the file was closed, the blocks are found through its INDX footer.
+    Otherwise, the file is scanned and blocks with unknown tags are skipped.
+    '''
+    data = np.fromfile(file_name, dtype=np.uint8)
+    if bytes(data[:4]) != SBC2_MAGIC:
+        raise IOError("File {} is not a SBC binary version 2 file".format(file_name))
+
+    if data[4:8].view(np.uint32)[0] != 16909060:
+        raise IOError("File {} has a different endianness".format(file_name))
+
+    header_len = int(data[10:12].view(np.uint16)[0])
+    columns = ParseHeader("".join(map(chr, data[12:12 + header_len])))
+    bytes_per_event = sum(width for (_, _, width) in columns.values())
+    pos = 12 + header_len + 8
+    # Only the last column can be encoded. Chunked columns are not in the
+    # events, so their size is still fixed.
+    encoded = [(key, val) for key, val in columns.items() if val[0].endswith(':dzbp')]
+    chunked = [(key, val) for key, val in columns.items() if val[0].endswith(':chunked')]
+    for key, _ in encoded + chunked:
+        del columns[key]
+
+    event_offsets = []
+    configs = []
+    stream_offsets = []
+    chunk_offsets = []
+    block_size = 8 + bytes_per_event
+    index = ReadIndexV2(data, pos)
+    if index is not None:
+        event_offsets, config_offsets, stream_offsets, chunk_offsets = index
+        event_offsets = [event_offsets + 8]
+        for conf_pos in config_offsets:
+            configs.append(ReadConfigV2(data, int(conf_pos)))
+        pos = data.size
+
+    while pos + 8 <= data.size:
+        tag = bytes(data[pos:pos + 4])
+        payload_size = int(data[pos + 4:pos + 8].view(np.uint32)[0])
+        if tag == b'EVNT' and not encoded:
+            # Events come in long runs, so they are found all at once
+            max_events = (data.size - pos) // block_size
+            headers = np.lib.stride_tricks.as_strided(data[pos:], shape=(max_events, 8),
+                                                      strides=(block_size, 1))
+            sizes = np.ascontiguousarray(headers[:, 4:]).view(np.uint32)[:, 0]
+            is_event = np.all(headers[:, :4] == np.frombuffer(b'EVNT', dtype=np.uint8),
+                              axis=1) & (sizes == bytes_per_event)
+            run = max_events if is_event.all() else int(np.argmin(is_event))
+            if run > 0:
+                event_offsets.append(pos + 8 + block_size*np.arange(run))
+                pos += block_size*run
+                continue
+
+        if pos + 8 + payload_size > data.size:
+            print("Warning: file " + file_name + " ends in the middle of a block")
+            break
+
+        if tag == b'EVNT':
+            # Events of the wrong size (ex: damaged disks) are skipped
+            if payload_size == bytes_per_event or (encoded and payload_size > bytes_per_event):
+                event_offsets.append(np.array([pos + 8], dtype=np.int64))
+        elif tag == b'CONF':
+            configs.append(ReadConfigV2(data, pos))
+        elif tag == b'STRM':
+            stream_offsets.append(pos)
+        elif tag == b'SDAT':
+            chunk_offsets.append(pos)
+
+        pos += 8 + payload_size
+
+    if event_offsets:
+        event_offsets = np.concatenate(event_offsets)
+    else:
+        event_offsets = np.zeros(0, dtype=np.int64)
+
+    uint8_buffer = data[event_offsets[:, np.newaxis] + np.arange(bytes_per_event)]
+    variables_dict = ReadLines(columns, uint8_buffer)
+    for key, (_, shape, _) in encoded:
+        sizes = data[(event_offsets[:, np.newaxis] - 4) + np.arange(4)].view(np.uint32)[:, 0]
+        variables_dict[key] = np.zeros((event_offsets.size,) + shape, dtype=np.uint16)
+        for i, (offset, size) in enumerate(zip(event_offsets, sizes)):
+            variables_dict[key][i] = DecodeDZBP(
+                data[offset + bytes_per_event:offset + size], shape)
+    variables_dict['configs'] = configs
+    variables_dict['streams'] = ReadStreamsV2(data, stream_offsets, chunk_offsets)
+    for key, (_, shape, _) in chunked:
+        rows = [variables_dict['streams']['{}/{}'.format(key, row)][key]
+                for row in range(int(np.prod(shape)) // shape[-1])]
+        num_events = min(row.shape[0] for row in rows)
+        variables_dict[key] = np.stack([row[:num_events] for row in rows],
+                                       axis=1).reshape((num_events,) + shape)
+    return variables_dict
+
+
+def ReadShardedV2(manifest_name):
+    '''
+    Reads a sharded run (see SiPMShardedWriter) through its manifest. The
+    events of all the shard files are merged in time_stamp order, and the
+    configs and streams of every file are returned in file order.
+    '''
+    with open(manifest_name) as manifest:
+        lines = manifest.read().splitlines()
+    if not lines or lines[0] != 'SBC shards 1':
+        raise IOError("File {} is not a shard manifest".format(manifest_name))
+
+    file_names = []
+    for shard in filter(None, lines[1:]):
+        shard = os.path.join(os.path.dirname(manifest_name), shard)
+        if os.path.exists(shard):
+            file_names.append(shard)
+            continue
+        # Rotated: run.bin -> run_0000.bin, run_0001.bin...
+        root, ext = os.path.splitext(shard)
+        seq = 0
+        while os.path.exists('{}_{:04d}{}'.format(root, seq, ext)):
+            file_names.append('{}_{:04d}{}'.format(root, seq, ext))
+            seq += 1
+
+    files = [ReadBlockV2(file_name) for file_name in file_names]
+    variables_dict = OrderedDict()
+    for key in files[0]:
+        if key not in ('configs', 'streams'):
+            variables_dict[key] = np.concatenate([f[key] for f in files])
+    # Stable, so events with the same time stamp keep the shard order
+    order = np.argsort(variables_dict['time_stamp'], kind='stable')
+    for key in variables_dict:
+        variables_dict[key] = variables_dict[key][order]
+    variables_dict['configs'] = [conf for f in files for conf in f['configs']]
+    variables_dict['streams'] = [f['streams'] for f in files]
+    return variables_dict
+
+
 def Cast(variable_name, data):
     '''
     This function takes in the type to be cast to,
@@ -0,0 +1,86 @@
+// C STD includes
+// C 3rd party includes
+// C++ STD include
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "sbcqueens-gui/caen_helper.hpp"
+
+using namespace SBCQueens;
+
+namespace {
+
+// Same two passes as CAEN::ReadData: extend every TTT of the batch, then
+// close it and apply the correction and host times.
+std::vector<CAENEventTime> read_batch(CAENTimeTagTracker& tracker,
+    const std::vector<uint32_t>& ttts, const int64_t& read_time) {
+    std::vector<CAENEventTime> times;
+    for (const auto& ttt : ttts) {
+        times.push_back(CAENEventTime{tracker.extend(ttt), 0});
+    }
+
+    const auto correction = tracker.close_batch(times.back().ExtendedTimeTag,
+        read_time);
+    for (auto& time : times) {
+        time.ExtendedTimeTag += correction;
+        time.HostTime = tracker.host_time(time.ExtendedTimeTag);
+    }
+    return times;
+}
+
+}  // namespace
+
+TEST_CASE("CAEN_TIME_TAG_TRACKER") {
+    constexpr uint64_t kRollover = uint64_t{1} << 31;
+    constexpr int64_t kPeriod = 8;
+
+    CAENTimeTagTracker tracker;
+    tracker.reset(static_cast<double>(kPeriod));
+
+    // The TTT wraps in the middle of the batch, the last event is at the
+    // read time and the rest are placed before it.
+    const int64_t first_read = 1'000'000'000;
+    const auto first = read_batch(tracker,
+        {kRollover - 100, kRollover - 10, 5, 50}, first_read);
+    REQUIRE(first.size() == 4);
+    CHECK(first[0].ExtendedTimeTag == kRollover - 100);
+    CHECK(first[1].ExtendedTimeTag == kRollover - 10);
+    CHECK(first[2].ExtendedTimeTag == kRollover + 5);
+    CHECK(first[3].ExtendedTimeTag == kRollover + 50);
+    CHECK(first[3].HostTime == first_read);
+    CHECK(first[2].HostTime == first_read - 45*kPeriod);
+    CHECK(first[0].HostTime == first_read - 150*kPeriod);
+
+    // No events for more than two TTT periods: the TTT looks like it only
+    // moved forward by 2000 ticks, the host time says two wraps were missed.
+    const int64_t second_read = first_read
+        + static_cast<int64_t>(2*kRollover + 2000)*kPeriod;
+    const auto second = read_batch(tracker, {1050, 2050}, second_read);
+    REQUIRE(second.size() == 2);
+    CHECK(second[0].ExtendedTimeTag == 3*kRollover + 1050);
+    CHECK(second[1].ExtendedTimeTag == 3*kRollover + 2050);
+    CHECK(second[1].HostTime == second_read);
+    CHECK(second[0].HostTime == second_read - 1000*kPeriod);
+
+    // The acquisition restarts 1000 ticks after the last read with its TTT
+    // back to 0, the extended time tag keeps going from where it was.
+    const int64_t restart_time = second_read + 1000*kPeriod;
+    tracker.restart(restart_time);
+    const int64_t third_read = restart_time + 20*kPeriod;
+    const auto third = read_batch(tracker, {10, 20}, third_read);
+    REQUIRE(third.size() == 2);
+    CHECK(third[0].ExtendedTimeTag == 3*kRollover + 3060);
+    CHECK(third[1].ExtendedTimeTag == 3*kRollover + 3070);
+    CHECK(third[1].HostTime == third_read);
+    CHECK(third[0].HostTime == third_read - 10*kPeriod);
+    CHECK(third[0].ExtendedTimeTag > second[1].ExtendedTimeTag);
+
+    // reset starts over from 0
+    tracker.reset(static_cast<double>(kPeriod));
+    const auto fourth = read_batch(tracker, {7}, third_read + 1000);
+    CHECK(fourth[0].ExtendedTimeTag == 7);
+    CHECK(fourth[0].HostTime == third_read + 1000);
+}
@@ -0,0 +1,853 @@
+// C STD includes
+// C 3rd party includes
+// C++ STD include
+// C++ 3rd party includes
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sbcqueens-gui/binary_file_helpers.hpp"
+#include "sbcqueens-gui/file_migrator.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryReader.hpp"
+
+using namespace SBCQueens;
+
+namespace {
+
+// A DT5730B with one enabled channel of 64 samples
+struct SiPMFixture {
+    const CAENDigitizerModelConstants& ModelConsts
+        = CAENDigitizerModelsConstantsMap.at(CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig GlobalConfig;
+    std::array<CAENGroupConfig, 8> GroupConfigs{};
+    std::vector<std::shared_ptr<CAENWaveforms<uint16_t>>> Waveforms;
+};
+
+using WaveformFill = std::function<void(CAENWaveforms<uint16_t>&, const std::size_t&)>;
+
+// n waveforms, each one set by fill(waveform, i). Without fill they all
+// share the same empty waveform.
+SiPMFixture make_sipm_fixture(const std::size_t& n, const WaveformFill& fill = {}) {
+    SiPMFixture fixture;
+    fixture.GlobalConfig.RecordLength = 64;
+    fixture.GroupConfigs[0].Enabled = true;
+
+    if (not fill) {
+        fixture.Waveforms.assign(n, std::make_shared<CAENWaveforms<uint16_t>>(
+            fixture.ModelConsts, fixture.GlobalConfig, fixture.GroupConfigs));
+        return fixture;
+    }
+
+    for (std::size_t i = 0; i < n; i++) {
+        auto waveform = std::make_shared<CAENWaveforms<uint16_t>>(
+            fixture.ModelConsts, fixture.GlobalConfig, fixture.GroupConfigs);
+        fill(*waveform, i);
+        fixture.Waveforms.push_back(waveform);
+    }
+    return fixture;
+}
+
+// Empty directory under the temporary directory
+std::filesystem::path make_test_dir(const std::string& name) {
+    const auto dir = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+}  // namespace
+
+TEST_CASE("SBC_BINARY_V1_ROUND_TRIP") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_v1_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    {
+        BinaryFormat::DynamicWriter<double, uint16_t> writer(file_name,
+            {"rate", "traces"}, {1, 2}, {1, 2, 3});
+        for (uint16_t i = 0; i < 10; i++) {
+            double rate[1] = {1.5*i};
+            uint16_t traces[6] = {i, 1, 2, 3, 4, 5};
+            writer.save(rate, traces);
+        }
+    }
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.version() == 1);
+    REQUIRE(reader.size() == 10);
+    CHECK(reader.event_schema().at("traces").Shape == std::vector<std::size_t>{2, 3});
+    CHECK(reader[7].value<double>("rate") == doctest::Approx(10.5));
+    CHECK(reader[7].read<uint16_t>("traces")
+          == std::vector<uint16_t>{7, 1, 2, 3, 4, 5});
+    CHECK_THROWS(reader[7].read<float>("traces"));
+
+    std::size_t count = 0;
+    for (const auto& event : reader) {
+        CHECK(event.read<uint16_t>("traces")[0] == count);
+        count++;
+    }
+    CHECK(count == 10);
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_SIPM_ROUND_TRIP") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_v2_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    const auto& model_consts
+        = CAENDigitizerModelsConstantsMap.at(CAENDigitizerModel::DT5730B);
+    CAENGlobalConfig global_config;
+    global_config.RecordLength = 64;
+    std::array<CAENGroupConfig, 8> group_configs{};
+    group_configs[1].Enabled = true;
+    group_configs[1].TriggerThreshold = 1234;
+    group_configs[4].Enabled = true;
+
+    std::vector<std::shared_ptr<CAENWaveforms<uint16_t>>> waveforms;
+    for (std::size_t i = 0; i < 100; i++) {
+        auto waveform = std::make_shared<CAENWaveforms<uint16_t>>(model_consts,
+            global_config, group_configs);
+        auto data = waveform->getData();
+        for (std::size_t j = 0; j < data.size(); j++) {
+            data[j] = static_cast<uint16_t>(i + j);
+        }
+        waveform->setTime(CAENEventTime{1000 + i, 0});
+        waveforms.push_back(waveform);
+    }
+
+    {
+        BinaryFormat::SiPMDynamicWriter writer(file_name, CAENDigitizerFamilies::x730,
+            model_consts, global_config, group_configs, {}, {true, 4});
+        writer.save_waveforms(waveforms.begin(), waveforms.size());
+    }
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.version() == 2);
+    REQUIRE(reader.size() == 100);
+    REQUIRE(reader.num_configs() == 1);
+
+    auto config = reader.config(reader.config_index_for(50));
+    CHECK(config.read<uint8_t>("en_chs") == std::vector<uint8_t>{1, 4});
+    CHECK(config.read<uint16_t>("thresholds")[0] == 1234);
+    CHECK(config.value<double>("sample_rate") == doctest::Approx(500e6));
+
+    std::atomic<std::size_t> mismatches = 0;
+    reader.for_each([&](std::size_t i, const BinaryFormat::RecordView& event) {
+        auto traces = event.read<uint16_t>("sipm_traces");
+        if (event.value<uint64_t>("time_stamp") != 1000 + i
+            or traces.size() != 2*64 or traces[5] != i + 5) {
+            mismatches++;
+        }
+    }, 4);
+    CHECK(mismatches == 0);
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_INDEX_FOOTER") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_v2_index_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    using Writer = BinaryFormat::BlockWriter<uint64_t, float>;
+    auto write_events = [&](uint64_t first, uint64_t n) {
+        Writer writer(file_name, {"time", "value"}, {1, 1}, {1, 3});
+        for (uint64_t i = first; i < first + n; i++) {
+            uint64_t time[1] = {10*i};
+            float value[3] = {1.0f*i, 2.0f, 3.0f};
+            writer.save_with_key(time[0], time, value);
+        }
+    };
+
+    // The second writer appends after the footer of the first
+    write_events(0, 20);
+    write_events(20, 30);
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.has_index());
+    REQUIRE(reader.size() == 50);
+    CHECK(reader.key(42) == 420);
+    CHECK(reader.find_key(255) == 26);
+    CHECK(reader[35].value<uint64_t>("time") == 350);
+
+    // The number of events goes right after the event header
+    const std::string event_header = "time;uint64;1;value;single;3;";
+    uint64_t num_events = 0;
+    std::ifstream peeker(file_name, std::ios::binary);
+    peeker.seekg(static_cast<std::streamoff>(12 + event_header.size()));
+    peeker.read(reinterpret_cast<char*>(&num_events), sizeof(num_events));
+    CHECK(num_events == 50);
+    peeker.close();
+
+    // Without the footer (e.g. a crash) the events are found by scanning
+    std::filesystem::resize_file(file_name, std::filesystem::file_size(file_name) - 1);
+    BinaryFormat::Reader scanned(file_name);
+    CHECK_FALSE(scanned.has_index());
+    CHECK(scanned.size() == 50);
+    CHECK(scanned[49].value<uint64_t>("time") == 490);
+
+    // Corrupted counts are rejected instead of wrapping the size check
+    BinaryFormat::EventIndex index;
+    std::string corrupted(2*sizeof(uint64_t), '\0');
+    const uint64_t huge_counts[2] = {uint64_t{1} << 62, 0};
+    std::memcpy(corrupted.data(), huge_counts, sizeof(huge_counts));
+    CHECK_FALSE(index.parse(corrupted));
+
+    corrupted.assign(4*sizeof(uint64_t), '\0');
+    std::memcpy(corrupted.data() + 2*sizeof(uint64_t), huge_counts, sizeof(huge_counts));
+    CHECK_FALSE(index.parse(corrupted));
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_DZBP_ROUND_TRIP") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_dzbp_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    // 2 channels of 300 samples: a baseline with noise, a pulse, and the
+    // full uint16 range so every bit width is used
+    std::vector<uint16_t> traces(2*300);
+    for (std::size_t i = 0; i < traces.size(); i++) {
+        traces[i] = static_cast<uint16_t>(8000 + (i*7919) % 5);
+    }
+    traces[150] = 0;
+    traces[151] = 65535;
+    traces[420] = 12000;
+
+    std::vector<char> encoded(BinaryFormat::DeltaZigZagCodec::max_encoded_size(
+        traces.size(), 300));
+    const auto size = BinaryFormat::DeltaZigZagCodec::encode(traces, 300, encoded.data());
+    CHECK(size < traces.size()*sizeof(uint16_t));
+
+    std::vector<uint16_t> decoded(traces.size());
+    BinaryFormat::DeltaZigZagCodec::decode({encoded.data(), size}, 300, decoded);
+    CHECK(decoded == traces);
+    CHECK_THROWS(BinaryFormat::DeltaZigZagCodec::decode({encoded.data(), size - 1},
+                                                        300, decoded));
+
+    {
+        BinaryFormat::BlockWriter<uint64_t, uint16_t> writer(file_name,
+            {"time", "traces"}, {1, 2}, {1, 2, 300},
+            {BinaryFormat::ColumnEncoding::Raw,
+             BinaryFormat::ColumnEncoding::DeltaZigZagBitPack});
+        for (uint64_t i = 0; i < 10; i++) {
+            uint64_t time[1] = {i};
+            traces[0] = static_cast<uint16_t>(i);
+            writer.save(time, traces);
+        }
+    }
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.size() == 10);
+    CHECK(reader.event_schema().at("traces").Encoding
+          == BinaryFormat::ColumnEncoding::DeltaZigZagBitPack);
+    CHECK(reader[3].value<uint64_t>("time") == 3);
+    CHECK(reader[3].value<uint16_t>("traces") == 3);
+    CHECK(reader[9].read<uint16_t>("traces") == traces);
+    CHECK_THROWS(reader[9].get<uint16_t>("traces"));
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_ROTATION") {
+    const auto dir = make_test_dir("sbc_binary_rotation_test");
+    const auto [model_consts, global_config, group_configs, waveforms]
+        = make_sipm_fixture(25);
+
+    BinaryFormat::RolloverPolicy policy;
+    policy.MaxEvents = 10;
+    {
+        BinaryFormat::SiPMDynamicWriter writer((dir / "run.bin").string(),
+            CAENDigitizerFamilies::x730, model_consts, global_config, group_configs,
+            policy);
+        writer.save_waveforms(waveforms.begin(), waveforms.size());
+        CHECK(writer.get_current_file_name() == (dir / "run_0002.bin").string());
+    }
+
+    // Every file is closed with its footer and the unused next file is removed
+    std::size_t total_events = 0;
+    for (uint32_t seq = 0; seq < 3; seq++) {
+        const auto file_name = dir / fmt::format("run_{:04d}.bin", seq);
+        BinaryFormat::Reader reader(file_name.string());
+        CHECK(reader.has_index());
+        CHECK(reader.config(0).value<uint32_t>("file_sequence") == seq);
+        total_events += reader.size();
+    }
+    CHECK(total_events == 25);
+    CHECK_FALSE(std::filesystem::exists(dir / "run_0003.bin"));
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("SBC_BINARY_V2_IO_BACKENDS") {
+    for (const auto& backend : {BinaryFormat::IOBackend::Buffered,
+                                BinaryFormat::IOBackend::Direct,
+                                BinaryFormat::IOBackend::IOUring}) {
+        const auto file_name = (std::filesystem::temp_directory_path()
+            / "sbc_binary_io_test.bin").string();
+        std::filesystem::remove(file_name);
+
+        // Events that are not a multiple of the 4096 bytes blocks of
+        // O_DIRECT, and an append that starts in the middle of one
+        using Writer = BinaryFormat::BlockWriter<uint64_t, uint16_t>;
+        auto write_events = [&](uint64_t first, uint64_t n) {
+            Writer writer(file_name, {"time", "traces"}, {1, 1}, {1, 3001}, {}, backend);
+            std::vector<uint16_t> traces(3001);
+            for (uint64_t i = first; i < first + n; i++) {
+                uint64_t time[1] = {i};
+                traces.back() = static_cast<uint16_t>(i);
+                writer.save(time, traces);
+            }
+        };
+        write_events(0, 37);
+        write_events(37, 100);
+
+        BinaryFormat::Reader reader(file_name);
+        REQUIRE(reader.has_index());
+        REQUIRE(reader.size() == 137);
+        CHECK(reader[136].read<uint16_t>("traces").back() == 136);
+        CHECK(reader[20].value<uint64_t>("time") == 20);
+
+        std::filesystem::remove(file_name);
+    }
+}
+
+TEST_CASE("SBC_BINARY_V2_RECOVERY") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_recovery_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    using Writer = BinaryFormat::BlockWriter<uint64_t, float>;
+    auto write_events = [&](uint64_t first, uint64_t n) {
+        Writer writer(file_name, {"time", "value"}, {1, 1}, {1, 3});
+        writer.set_durability({BinaryFormat::DurabilityMode::Periodic, 64, {}});
+        for (uint64_t i = first; i < first + n; i++) {
+            uint64_t time[1] = {10*i};
+            float value[3] = {1.0f*i, 2.0f, 3.0f};
+            writer.save_with_key(time[0], time, value);
+        }
+    };
+    write_events(0, 20);
+
+    // As if it crashed in the middle of event 15: no footer and a partial
+    // event at the end
+    const std::string event_header = "time;uint64;1;value;single;3;";
+    const std::size_t event_block = 8 + 8 + 3*sizeof(float);
+    std::filesystem::resize_file(file_name, 12 + event_header.size() + 8
+                                 + 15*event_block + 5);
+
+    write_events(15, 10);
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.has_index());
+    REQUIRE(reader.size() == 25);
+    CHECK(reader.key(14) == 140);
+    CHECK(reader.find_key(150) == 15);
+    CHECK(reader[24].value<uint64_t>("time") == 240);
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_DAMAGED_EVENT") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_damaged_event_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    {
+        BinaryFormat::BlockWriter<uint64_t, float> writer(file_name, {"time", "value"},
+                                                          {1, 1}, {1, 3});
+        for (uint64_t i = 0; i < 5; i++) {
+            uint64_t time[1] = {10*i};
+            float value[3] = {1.0f*i, 2.0f, 3.0f};
+            writer.save(time, value);
+        }
+    }
+
+    // Event 2 loses its values and the footer is gone, so the events are
+    // found by scanning
+    const std::string event_header = "time;uint64;1;value;single;3;";
+    const std::size_t event_block = 8 + 8 + 3*sizeof(float);
+    const std::size_t event_2 = 12 + event_header.size() + 8 + 2*event_block;
+    std::string data(std::filesystem::file_size(file_name), '\0');
+    std::ifstream(file_name, std::ios::binary).read(data.data(),
+        static_cast<std::streamsize>(data.size()));
+    const uint32_t short_size = 8;
+    std::memcpy(data.data() + event_2 + 4, &short_size, sizeof(short_size));
+    data.erase(event_2 + 8 + short_size, 3*sizeof(float));
+    data.resize(data.size() - 1);
+    std::ofstream(file_name, std::ios::binary | std::ios::trunc) << data;
+
+    BinaryFormat::Reader reader(file_name);
+    CHECK_FALSE(reader.has_index());
+    REQUIRE(reader.size() == 4);
+    CHECK(reader[2].value<uint64_t>("time") == 30);
+    CHECK(reader[3].read<float>("value")[0] == doctest::Approx(4.0f));
+
+    // Columns past the end of a record are not read
+    const BinaryFormat::RecordView short_event(reader.event_schema(),
+        reinterpret_cast<const std::byte*>(data.data() + event_2 + 8), short_size);
+    CHECK(short_event.value<uint64_t>("time") == 20);
+    CHECK_THROWS(short_event.read<float>("value"));
+    CHECK_THROWS(short_event.raw("value"));
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_CHECKSUMS") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_checksum_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    CHECK(BinaryFormat::crc32c("123456789", 9) == 0xE3069283);
+
+    {
+        BinaryFormat::BlockWriter<uint64_t, float> writer(file_name,
+            {"time", "value"}, {1, 1}, {1, 3});
+        writer.set_checksums(true);
+        for (uint64_t i = 0; i < 600; i++) {
+            uint64_t time[1] = {i};
+            float value[3] = {1.0f*i, 2.0f, 3.0f};
+            writer.save(time, value);
+        }
+    }
+
+    {
+        BinaryFormat::Reader reader(file_name);
+        const auto report = reader.verify_checksums(4);
+        CHECK(report.isOk());
+        CHECK(report.GoodBlocks == 600);
+        CHECK(report.UncheckedBlocks == 0);
+    }
+
+    // One byte of the payload of event 7
+    const std::string event_header = "time;uint64;1;value;single;3;";
+    const std::size_t first_block = 12 + event_header.size() + 8;
+    const std::size_t event_block = 8 + 8 + 3*sizeof(float);
+    {
+        std::fstream file(file_name, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(first_block + 7*event_block + 12));
+        file.put('\x7f');
+    }
+
+    BinaryFormat::Reader reader(file_name);
+    const auto report = reader.verify_checksums(4);
+    REQUIRE(report.BadRanges.size() == 1);
+    CHECK(report.BadBlocks == 1);
+    CHECK(report.BadRanges[0].FirstEvent == 7);
+    CHECK(report.BadRanges[0].NumEvents == 1);
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_DATA_FILE") {
+    struct Item {
+        double time;
+        std::vector<double> temps;
+    };
+
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto file_name = (dir / "sbc_binary_data_file_test.bin").string();
+    const auto other_name = (dir / "sbc_binary_data_file_test_1.bin").string();
+    std::filesystem::remove(file_name);
+    std::filesystem::remove(other_name);
+
+    auto columns = [](Item& item) {
+        return std::make_tuple(std::span<double>(&item.time, 1),
+                               std::span<double>(item.temps));
+    };
+
+    BinaryDataFile<Item, double, double> file(file_name, {"time", "temps"});
+    REQUIRE(file.isOpen());
+    file.add({1.0, {10.0, 11.0, 12.0}});
+    file.add({2.0, {20.0, 21.0}});
+    file.add({3.0, {30.0, 31.0, 32.0}});
+    file.save(columns);
+    CHECK(file.getFileName() == file_name);
+    CHECK(file.getDropped() == 1);
+
+    // Readable while it is still open
+    {
+        BinaryFormat::Reader reader(file_name);
+        REQUIRE(reader.size() == 2);
+        CHECK(reader[1].value<double>("time") == doctest::Approx(3.0));
+        CHECK(reader[1].read<double>("temps") == std::vector<double>{30.0, 31.0, 32.0});
+    }
+
+    // Other columns do not overwrite it
+    BinaryDataFile<Item, double, double> other(file_name, {"time", "temps"});
+    other.add({4.0, {40.0}});
+    other.save(columns);
+    CHECK(other.getFileName() == other_name);
+
+    // Nothing is lost if the file cannot be opened yet
+    const auto missing_dir = dir / "sbc_binary_data_file_test_dir";
+    std::filesystem::remove_all(missing_dir);
+    BinaryDataFile<Item, double, double> later((missing_dir / "data.bin").string(),
+                                               {"time", "temps"});
+    later.add({5.0, {50.0}});
+    CHECK_THROWS(later.save(columns));
+    std::filesystem::create_directory(missing_dir);
+    later.add({6.0, {60.0}});
+    later.save(columns);
+    {
+        BinaryFormat::Reader reader(later.getFileName());
+        REQUIRE(reader.size() == 2);
+        CHECK(reader[0].value<double>("time") == doctest::Approx(5.0));
+        CHECK(reader[1].value<double>("time") == doctest::Approx(6.0));
+    }
+
+    std::filesystem::remove(file_name);
+    std::filesystem::remove(other_name);
+    std::filesystem::remove_all(missing_dir);
+}
+
+TEST_CASE("SBC_BINARY_V2_STREAMS") {
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto file_name = (dir / "sbc_binary_v2_streams_test.bin").string();
+    const auto copy_name = (dir / "sbc_binary_v2_streams_copy.bin").string();
+    std::filesystem::remove(file_name);
+    std::filesystem::remove(copy_name);
+
+    {
+        BinaryFormat::BlockWriter<uint64_t, float> writer(file_name,
+            {"time", "value"}, {1, 1}, {1, 2});
+        auto rtds = writer.add_stream<double, double>("rtds", {"time", "temps"},
+                                                      {1, 1}, {1, 3}, 4);
+        auto bias = writer.add_stream<double, float>("bias", {"time", "voltage"},
+                                                     {1, 1}, {1, 1});
+        for (uint64_t i = 0; i < 10; i++) {
+            uint64_t time[1] = {i};
+            float value[2] = {1.0f*i, 0.0f};
+            writer.save(time, value);
+
+            double rtd_time[1] = {0.5*i};
+            double temps[3] = {1.0*i, 2.0*i, 3.0*i};
+            rtds.save(rtd_time, temps);
+        }
+
+        double bias_time[1] = {0.0};
+        float voltage[1] = {55.0f};
+        bias.save(bias_time, voltage);
+        CHECK(bias.size() == 1);
+
+        // Not closed yet
+        writer.sync();
+        std::filesystem::copy_file(file_name, copy_name);
+    }
+
+    auto check = [](const std::string& name, const bool& indexed) {
+        BinaryFormat::Reader reader(name);
+        CHECK(reader.has_index() == indexed);
+        REQUIRE(reader.size() == 10);
+        REQUIRE(reader.num_streams() == 2);
+        const auto rtds = reader.stream_index("rtds");
+        REQUIRE(reader.stream_size(rtds) == 10);
+        CHECK(reader.stream_size(reader.stream_index("bias")) == 1);
+        CHECK(reader.stream_record(rtds, 7).read<double>("temps")
+              == std::vector<double>{7.0, 14.0, 21.0});
+        CHECK_THROWS(reader.stream_record(rtds, 10));
+
+        // Chunks of 4 records go right after their last record
+        std::vector<std::string> order;
+        reader.for_each_in_file_order(
+            [&](const std::size_t& i, const BinaryFormat::RecordView&) {
+                order.push_back("e" + std::to_string(i));
+            },
+            [&](const std::size_t& stream, const std::size_t& i,
+                const BinaryFormat::RecordView& record) {
+                if (stream == rtds) {
+                    CHECK(record.value<double>("time") == doctest::Approx(0.5*i));
+                }
+                order.push_back(reader.stream_name(stream) + std::to_string(i));
+            });
+        REQUIRE(order.size() == 21);
+        CHECK(order[3] == "e3");
+        CHECK(order[4] == "rtds0");
+        CHECK(order[8] == "e4");
+    };
+    check(file_name, true);
+    check(copy_name, false);
+
+    // Appending continues the streams, of a closed file or not
+    for (const auto& name : {file_name, copy_name}) {
+        BinaryFormat::BlockWriter<uint64_t, float> writer(name,
+            {"time", "value"}, {1, 1}, {1, 2});
+        CHECK_THROWS(writer.add_stream<double, float>("rtds", {"time", "temps"},
+                                                      {1, 1}, {1, 1}));
+        auto rtds = writer.add_stream<double, double>("rtds", {"time", "temps"},
+                                                      {1, 1}, {1, 3});
+        CHECK(rtds.size() == 10);
+        double rtd_time[1] = {5.0};
+        double temps[3] = {10.0, 20.0, 30.0};
+        rtds.save(rtd_time, temps);
+        writer.close();
+
+        BinaryFormat::Reader reader(name);
+        CHECK(reader.has_index());
+        CHECK(reader.stream_size(reader.stream_index("rtds")) == 11);
+        CHECK(reader.stream_record(reader.stream_index("rtds"), 10).value<double>("time")
+              == doctest::Approx(5.0));
+        CHECK(reader.verify_checksums(2).isOk());
+    }
+
+    std::filesystem::remove(file_name);
+    std::filesystem::remove(copy_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_CHANNEL_CHUNKS") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_v2_chunks_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    // 3 channels of 50 samples, saved as 3 streams of rows
+    using Writer = BinaryFormat::BlockWriter<uint64_t, uint16_t>;
+    auto make_traces = [](const uint64_t& i) {
+        std::vector<uint16_t> traces(3*50);
+        for (std::size_t j = 0; j < traces.size(); j++) {
+            traces[j] = static_cast<uint16_t>(100*i + j);
+        }
+        return traces;
+    };
+    auto write_events = [&](const uint64_t& first, const uint64_t& last) {
+        Writer writer(file_name, {"time", "traces"}, {1, 2}, {1, 3, 50},
+                      {BinaryFormat::ColumnEncoding::Raw,
+                       BinaryFormat::ColumnEncoding::ChannelChunked});
+        writer.set_chunk_events(4);
+        for (uint64_t i = first; i < last; i++) {
+            uint64_t time[1] = {i};
+            auto traces = make_traces(i);
+            writer.save(time, traces);
+        }
+    };
+    write_events(0, 10);
+
+    {
+        BinaryFormat::Reader reader(file_name);
+        REQUIRE(reader.size() == 10);
+        REQUIRE(reader.num_streams() == 3);
+        CHECK(reader.event_schema().isChunked());
+        CHECK(reader.stream_name(2) == "traces/2");
+        CHECK(reader.stream_size(1) == 10);
+        CHECK(reader.read_chunked<uint16_t>("traces", 9) == make_traces(9));
+        CHECK(reader.stream_record(1, 5).read<uint16_t>("traces")[0] == 550);
+        CHECK_THROWS(reader[0].read<uint16_t>("traces"));
+        CHECK_THROWS(reader[0].get<uint16_t>("traces"));
+        CHECK_THROWS(reader.read_chunked<uint16_t>("time", 0));
+    }
+
+    // As if it crashed before the rows of events 8 and 9 were written:
+    // they are removed when the file is opened again
+    std::string data(std::filesystem::file_size(file_name), '\0');
+    std::ifstream(file_name, std::ios::binary).read(data.data(),
+        static_cast<std::streamsize>(data.size()));
+    std::filesystem::resize_file(file_name, data.rfind("EVNT") + 8 + sizeof(uint64_t));
+
+    write_events(8, 12);
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.has_index());
+    REQUIRE(reader.size() == 12);
+    CHECK(reader.stream_size(0) == 12);
+    CHECK(reader[9].value<uint64_t>("time") == 9);
+    CHECK(reader.read_chunked<uint16_t>("traces", 8) == make_traces(8));
+    CHECK(reader.read_chunked<uint16_t>("traces", 11) == make_traces(11));
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_STREAMS_PERIODIC_SYNC") {
+    const auto file_name = (std::filesystem::temp_directory_path()
+        / "sbc_binary_v2_streams_sync_test.bin").string();
+    std::filesystem::remove(file_name);
+
+    // A sync after every block flushes the pending chunks, which must be
+    // written once
+    using Writer = BinaryFormat::BlockWriter<uint64_t, uint16_t>;
+    {
+        Writer writer(file_name, {"time", "traces"}, {1, 2}, {1, 2, 16},
+                      {BinaryFormat::ColumnEncoding::Raw,
+                       BinaryFormat::ColumnEncoding::ChannelChunked});
+        writer.set_durability({BinaryFormat::DurabilityMode::Periodic, 1024, {}});
+        for (uint64_t i = 0; i < 200; i++) {
+            uint64_t time[1] = {i};
+            std::vector<uint16_t> traces(2*16, static_cast<uint16_t>(i));
+            writer.save(time, traces);
+        }
+    }
+
+    BinaryFormat::Reader reader(file_name);
+    REQUIRE(reader.size() == 200);
+    CHECK(reader.stream_size(0) == 200);
+    CHECK(reader.stream_size(1) == 200);
+    CHECK(reader.read_chunked<uint16_t>("traces", 199)[31] == 199);
+    CHECK(std::filesystem::file_size(file_name) < 200*(2*16*sizeof(uint16_t) + 64));
+
+    std::filesystem::remove(file_name);
+}
+
+TEST_CASE("SBC_BINARY_V2_SIPM_CHUNKED_ROTATION") {
+    const auto dir = make_test_dir("sbc_binary_chunked_rotation_test");
+    const auto [model_consts, global_config, group_configs, waveforms]
+        = make_sipm_fixture(25, [](auto& waveform, const std::size_t& i) {
+            waveform.getData()[0] = static_cast<uint16_t>(i);
+            waveform.getData()[63] = static_cast<uint16_t>(1000 + i);
+        });
+
+    // As in gui_setup.toml: chunked traces synced every few blocks
+    BinaryFormat::RolloverPolicy policy;
+    policy.MaxEvents = 10;
+    {
+        BinaryFormat::SiPMDynamicWriter writer((dir / "run.bin").string(),
+            CAENDigitizerFamilies::x730, model_consts, global_config, group_configs,
+            policy, {}, BinaryFormat::ColumnEncoding::ChannelChunked,
+            BinaryFormat::IOBackend::Buffered,
+            {BinaryFormat::DurabilityMode::Periodic, 1024, {}});
+        writer.save_waveforms(waveforms.begin(), 12);
+        writer.save_waveforms(waveforms.begin() + 12, 13);
+        CHECK(writer.pop_write_error().empty());
+    }
+
+    const auto files = BinaryFormat::find_file_sequence((dir / "run.bin").string());
+    REQUIRE(files.size() == 3);
+    std::size_t event = 0;
+    bool same_traces = true;
+    for (const auto& file_name : files) {
+        BinaryFormat::Reader reader(file_name);
+        CHECK(reader.event_schema().isChunked());
+        for (std::size_t i = 0; i < reader.size(); i++, event++) {
+            const auto traces = reader.read_chunked<uint16_t>("sipm_traces", i);
+            same_traces = same_traces and traces.size() == 64
+                and traces[0] == event and traces[63] == 1000 + event;
+        }
+    }
+    CHECK(event == 25);
+    CHECK(same_traces);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("SBC_BINARY_V2_SHARDS") {
+    const auto dir = make_test_dir("sbc_binary_shards_test");
+    const auto [model_consts, global_config, group_configs, waveforms]
+        = make_sipm_fixture(50, [](auto& waveform, const std::size_t& i) {
+            waveform.getData()[0] = static_cast<uint16_t>(i);
+            waveform.setTime(CAENEventTime{100*i, 0});
+        });
+
+    // 3 shards, each rotated every 5 events
+    const auto manifest_name = (dir / "run.shards").string();
+    BinaryFormat::RolloverPolicy policy;
+    policy.MaxEvents = 5;
+    {
+        BinaryFormat::SiPMShardedWriter writer(manifest_name,
+            {(dir / "a" / "run.bin").string(), (dir / "b" / "run.bin").string(),
+             (dir / "c" / "run.bin").string()},
+            CAENDigitizerFamilies::x730, model_consts, global_config, group_configs,
+            policy);
+        CHECK(writer.num_shards() == 3);
+        writer.save_waveforms(waveforms.begin(), 20);
+        writer.save_waveforms(waveforms.begin() + 20, 30);
+        CHECK(writer.pop_write_error().empty());
+    }
+
+    // Each shard has every third event
+    BinaryFormat::Reader shard(BinaryFormat::find_file_sequence(
+        (dir / "b" / "run.bin").string()).front());
+    CHECK(shard[1].value<uint64_t>("time_stamp") == 400);
+
+    BinaryFormat::ShardedReader reader(manifest_name);
+    REQUIRE(reader.size() == 50);
+    CHECK(reader.num_files() == 12);
+    bool in_order = true;
+    for (std::size_t i = 0; i < reader.size(); i++) {
+        in_order = in_order and reader.key(i) == 100*i
+            and reader[i].read<uint16_t>("sipm_traces")[0] == i;
+    }
+    CHECK(in_order);
+    CHECK(reader.find_key(1050) == 11);
+    CHECK(reader.locate(11).first.config(0).value<uint32_t>("file_sequence") == 0);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("FILE_MIGRATOR") {
+    const auto dir = make_test_dir("sbc_migrator_test");
+    const auto run_dir = dir / "runs";
+    const auto archive_dir = dir / "archive";
+    std::filesystem::create_directories(run_dir / "run1");
+
+    const auto sipm = make_sipm_fixture(12);
+
+    MigrationConfig config;
+    config.ArchiveDir = archive_dir.string();
+    FileMigrator migrator(config);
+
+    // Every rotated file is moved once it is closed. The second run in
+    // the same directory continues the sequence of the archive.
+    const auto base_name = (run_dir / "run1" / "run.bin").string();
+    auto write_run = [&]() {
+        BinaryFormat::RolloverPolicy policy;
+        policy.MaxEvents = 5;
+        policy.FirstSequence = migrator.first_free_sequence(base_name, run_dir.string());
+        BinaryFormat::SiPMDynamicWriter writer(base_name,
+            CAENDigitizerFamilies::x730, sipm.ModelConsts, sipm.GlobalConfig,
+            sipm.GroupConfigs, policy, {}, BinaryFormat::ColumnEncoding::Raw, BinaryFormat::IOBackend::Buffered,
+            {}, true);
+        writer.set_on_file_closed([&](const std::string& name) {
+            migrator.submit(name, run_dir.string());
+        });
+        writer.save_waveforms(sipm.Waveforms.begin(), sipm.Waveforms.size());
+    };
+    write_run();
+    migrator.wait();
+    CHECK(migrator.first_free_sequence(base_name, run_dir.string()) == 3);
+    write_run();
+    migrator.wait();
+
+    std::size_t total_events = 0;
+    for (uint32_t seq = 0; seq < 6; seq++) {
+        const auto name = fmt::format("run_{:04d}.bin", seq);
+        CHECK_FALSE(std::filesystem::exists(run_dir / "run1" / name));
+        BinaryFormat::Reader reader((archive_dir / "run1" / name).string());
+        CHECK(reader.verify_checksums(1).isOk());
+        CHECK(reader.config(0).value<uint32_t>("file_sequence") == seq);
+        total_events += reader.size();
+    }
+    CHECK(total_events == 24);
+    CHECK_FALSE(std::filesystem::exists(archive_dir / "run1" / "run_0000_1.bin"));
+
+    // A file that is already in the archive is saved next to it
+    for (int i = 0; i < 2; i++) {
+        std::ofstream(run_dir / "run1" / "notes.txt") << "run " << i;
+        migrator.submit((run_dir / "run1" / "notes.txt").string(), run_dir.string());
+        migrator.wait();
+    }
+    CHECK(std::filesystem::exists(archive_dir / "run1" / "notes.txt"));
+    CHECK(std::filesystem::exists(archive_dir / "run1" / "notes_1.txt"));
+
+    // Files outside the run directory are left alone
+    const auto outside = dir / "other.bin";
+    std::ofstream(outside) << "not in the run";
+    migrator.submit(outside.string(), run_dir.string());
+    migrator.wait();
+    CHECK(std::filesystem::exists(outside));
+
+    const auto stats = migrator.get_stats();
+    CHECK(stats.Pending == 0);
+    CHECK(stats.Migrated == 8);
+    CHECK(stats.Failed == 1);
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,546 @@
+// Summary of SBC binary files to check a run: number of events, trigger
+// rate over time, baseline and noise of every channel, saturated events
+// and gaps in the time stamps. The events are split between threads and
+// read through the memory map in a single pass.
+//
+// Usage: sbc-inspect [--json] [--threads N] [--bins N] [--baseline N]
+//                    [--adc-bits N] [--gap-factor F] [--verify] <file.bin>...
+// The exit code is 2 if --verify finds corrupted blocks.
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// C++ 3rd party includes
+#include <fmt/core.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryReader.hpp"
+
+using namespace SBCQueens::BinaryFormat;
+
+namespace {
+
+struct Options {
+    bool Json = false;
+    std::size_t Threads = std::max(1u, std::thread::hardware_concurrency());
+    // Of the rate histogram
+    std::size_t Bins = 20;
+    // Samples at the start of each waveform used for the baseline
+    std::size_t BaselineSamples = 64;
+    // The V1740 is 12 bits
+    uint32_t ADCBits = 12;
+    // A gap is an interval this many times longer than the mean one
+    double GapFactor = 10.0;
+    bool Verify = false;
+};
+
+// The files are read as a single sequence of events
+struct EventSet {
+    std::vector<std::unique_ptr<Reader>> Readers;
+    std::vector<std::size_t> FirstEvents;
+    std::size_t NumEvents = 0;
+    uint64_t Bytes = 0;
+
+    // Nanoseconds per time_stamp tick, 0 if the files do not say
+    double TickNs = 0.0;
+    bool HasTimeStamp = false;
+    bool HasHostTime = false;
+    bool HasTraces = false;
+    // Saved by channel in streams instead of in the events
+    bool ChunkedTraces = false;
+    std::size_t Channels = 0;
+    std::size_t RecordLength = 0;
+
+    // In seconds. Trigger time tag if known, otherwise the host time.
+    double time(const RecordView& event) const {
+        if (HasTimeStamp and TickNs > 0.0) {
+            return static_cast<double>(event.value<uint64_t>("time_stamp"))*TickNs*1e-9;
+        }
+        return static_cast<double>(event.value<int64_t>("host_time"))*1e-9;
+    }
+
+    bool hasTime() const { return (HasTimeStamp and TickNs > 0.0) or HasHostTime; }
+
+    std::size_t file_of(const std::size_t& i) const {
+        auto it = std::upper_bound(FirstEvents.begin(), FirstEvents.end(), i);
+        return static_cast<std::size_t>(std::distance(FirstEvents.begin(), it)) - 1;
+    }
+
+    RecordView event(const std::size_t& i) const {
+        const auto file = file_of(i);
+        return (*Readers[file])[i - FirstEvents[file]];
+    }
+
+    std::vector<uint16_t> chunked_traces(const std::size_t& i) const {
+        const auto file = file_of(i);
+        return Readers[file]->read_chunked<uint16_t>("sipm_traces", i - FirstEvents[file]);
+    }
+};
+
+struct ChannelStats {
+    uint64_t Events = 0;
+    // Of the per event baselines
+    double BaselineSum = 0.0;
+    double BaselineSqSum = 0.0;
+    double RMSSum = 0.0;
+    uint64_t Saturated = 0;
+};
+
+// Statistics of a range of events, merged at the end
+struct Partial {
+    std::vector<ChannelStats> Channels;
+    std::vector<uint64_t> Histogram;
+    uint64_t Gaps = 0;
+    uint64_t Backwards = 0;
+    double LargestGap = 0.0;
+    std::size_t LargestGapEvent = 0;
+    // For the interval between this range and the next
+    double FirstTime = 0.0;
+    double LastTime = 0.0;
+};
+
+// Plain loops over the samples so the compiler vectorises them
+struct RowSums {
+    uint64_t Sum = 0;
+    uint64_t SumSq = 0;
+};
+
+RowSums row_sums(const uint16_t* data, const std::size_t& size) {
+    uint64_t sum = 0;
+    uint64_t sum_sq = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        const uint32_t x = data[i];
+        sum += x;
+        sum_sq += x*x;
+    }
+    return {sum, sum_sq};
+}
+
+std::pair<uint16_t, uint16_t> row_extremes(const uint16_t* data, const std::size_t& size) {
+    uint16_t low = std::numeric_limits<uint16_t>::max();
+    uint16_t high = 0;
+    for (std::size_t i = 0; i < size; i++) {
+        low = std::min(low, data[i]);
+        high = std::max(high, data[i]);
+    }
+    return {low, high};
+}
+
+void inspect_range(const EventSet& set, const Options& options,
+                   const double& start_time, const double& bin_width,
+                   const double& gap_threshold,
+                   const std::size_t& first, const std::size_t& last, Partial& out) {
+    out.Channels.resize(set.Channels);
+    out.Histogram.resize(options.Bins);
+    const std::size_t baseline_samples = std::min(options.BaselineSamples, set.RecordLength);
+    const uint16_t full_scale = static_cast<uint16_t>((1u << options.ADCBits) - 1);
+
+    std::vector<uint16_t> decoded;
+    double previous = 0.0;
+    for (std::size_t i = first; i < last; i++) {
+        const auto event = set.event(i);
+
+        if (set.hasTime()) {
+            const double t = set.time(event);
+            if (i == first) {
+                out.FirstTime = t;
+            } else {
+                const double dt = t - previous;
+                if (dt < 0.0) {
+                    out.Backwards++;
+                } else if (dt > gap_threshold) {
+                    out.Gaps++;
+                }
+
+                if (dt > out.LargestGap) {
+                    out.LargestGap = dt;
+                    out.LargestGapEvent = i - 1;
+                }
+            }
+            previous = t;
+            out.LastTime = t;
+
+            if (bin_width > 0.0 and t >= start_time) {
+                const auto bin = std::min(static_cast<std::size_t>((t - start_time) / bin_width),
+                                          options.Bins - 1);
+                out.Histogram[bin]++;
+            }
+        }
+
+        if (not set.HasTraces) {
+            continue;
+        }
+
+        // Zero copy unless it is encoded, chunked or not aligned
+        const uint16_t* traces = nullptr;
+        if (set.ChunkedTraces) {
+            decoded = set.chunked_traces(i);
+            traces = decoded.data();
+        } else {
+            try {
+                traces = event.get<uint16_t>("sipm_traces").data();
+            } catch (const std::runtime_error&) {
+                decoded = event.read<uint16_t>("sipm_traces");
+                traces = decoded.data();
+            }
+        }
+
+        for (std::size_t ch = 0; ch < set.Channels; ch++) {
+            const uint16_t* row = traces + ch*set.RecordLength;
+            auto& stats = out.Channels[ch];
+            stats.Events++;
+
+            if (baseline_samples > 0) {
+                const auto sums = row_sums(row, baseline_samples);
+                const double n = static_cast<double>(baseline_samples);
+                const double mean = static_cast<double>(sums.Sum) / n;
+                const double variance = static_cast<double>(sums.SumSq) / n - mean*mean;
+                stats.BaselineSum += mean;
+                stats.BaselineSqSum += mean*mean;
+                stats.RMSSum += std::sqrt(std::max(variance, 0.0));
+            }
+
+            const auto [low, high] = row_extremes(row, set.RecordLength);
+            if (low == 0 or high >= full_scale) {
+                stats.Saturated++;
+            }
+        }
+    }
+}
+
+// The en_chs of the first configuration if it matches, otherwise 0, 1, 2...
+std::vector<std::size_t> channel_names(const EventSet& set) {
+    std::vector<std::size_t> out(set.Channels);
+    for (std::size_t i = 0; i < set.Channels; i++) {
+        out[i] = i;
+    }
+
+    try {
+        const auto en_chs = set.Readers.front()->config(0).read<uint8_t>("en_chs");
+        if (en_chs.size() == set.Channels) {
+            std::copy(en_chs.begin(), en_chs.end(), out.begin());
+        }
+    } catch (const std::exception&) {}
+    return out;
+}
+
+std::string json_string(const std::string& str) {
+    std::string out = "\"";
+    for (const auto& c : str) {
+        if (c == '"' or c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+// JSON has no inf or nan
+std::string json_number(const double& x) {
+    return std::isfinite(x) ? fmt::format("{}", x) : "null";
+}
+
+void print_usage(const char* name) {
+    fmt::print("Usage: {} [--json] [--threads N] [--bins N] [--baseline N] [--adc-bits N] "
+               "[--gap-factor F] [--verify] <file.bin>...\n", name);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--json") {
+            options.Json = true;
+        } else if (arg == "--verify") {
+            options.Verify = true;
+        } else if (arg == "--threads" and has_value) {
+            options.Threads = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        } else if (arg == "--bins" and has_value) {
+            options.Bins = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        } else if (arg == "--baseline" and has_value) {
+            options.BaselineSamples = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--adc-bits" and has_value) {
+            options.ADCBits = std::clamp<uint32_t>(
+                static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1, 16);
+        } else if (arg == "--gap-factor" and has_value) {
+            options.GapFactor = std::strtod(argv[++i], nullptr);
+        } else if (arg == "-h" or arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        EventSet set;
+        std::vector<std::string> file_names;
+        for (const auto& input : inputs) {
+            for (const auto& file_name : find_file_sequence(input)) {
+                auto reader = std::make_unique<Reader>(file_name);
+                set.FirstEvents.push_back(set.NumEvents);
+                set.NumEvents += reader->size();
+                set.Bytes += std::filesystem::file_size(file_name);
+                set.Readers.push_back(std::move(reader));
+                file_names.push_back(file_name);
+            }
+        }
+
+        const auto& schema = set.Readers.front()->event_schema();
+        auto has_column = [&](const std::string& name, const std::string& type) {
+            return std::any_of(schema.columns().begin(), schema.columns().end(),
+                [&](const ColumnInfo& col) { return col.Name == name and col.Type == type; });
+        };
+        set.HasTimeStamp = has_column("time_stamp", "uint64");
+        set.HasHostTime = has_column("host_time", "int64");
+        if (has_column("sipm_traces", "uint16")) {
+            const auto& traces = schema.at("sipm_traces");
+            set.HasTraces = traces.Shape.size() == 2;
+            set.Channels = set.HasTraces ? traces.Shape[0] : 0;
+            set.RecordLength = set.HasTraces ? traces.Shape[1] : 0;
+            set.ChunkedTraces = traces.Encoding == ColumnEncoding::ChannelChunked;
+        }
+
+        if (set.Readers.front()->num_configs() > 0) {
+            try {
+                set.TickNs = set.Readers.front()->config(0).value<double>("ttt_period");
+            } catch (const std::exception&) {}
+        }
+
+        for (const auto& reader : set.Readers) {
+            if (reader->event_schema().columns().size() != schema.columns().size()
+                or reader->event_schema().record_size() != schema.record_size()) {
+                throw std::runtime_error("The files have different columns");
+            }
+        }
+
+        // The rate bins and the gap threshold come from the first and last
+        // events, so everything else is a single pass
+        double first_time = 0.0;
+        double last_time = 0.0;
+        if (set.hasTime() and set.NumEvents > 0) {
+            first_time = set.time(set.event(0));
+            last_time = set.time(set.event(set.NumEvents - 1));
+        }
+        const double duration = std::max(last_time - first_time, 0.0);
+        const double bin_width = duration / static_cast<double>(options.Bins);
+        const double mean_interval = set.NumEvents > 1 ?
+            duration / static_cast<double>(set.NumEvents - 1) : 0.0;
+        const double gap_threshold = mean_interval > 0.0 ?
+            options.GapFactor*mean_interval : std::numeric_limits<double>::infinity();
+
+        const std::size_t num_threads = std::clamp<std::size_t>(options.Threads, 1,
+            std::max<std::size_t>(set.NumEvents, 1));
+        const std::size_t chunk = (set.NumEvents + num_threads - 1) / num_threads;
+        std::vector<Partial> partials(num_threads);
+        std::vector<std::string> errors(num_threads);
+        std::vector<std::thread> workers;
+        for (std::size_t t = 0; t < num_threads; t++) {
+            workers.emplace_back([&, t]() {
+                try {
+                    inspect_range(set, options, first_time, bin_width, gap_threshold,
+                                  std::min(set.NumEvents, t*chunk),
+                                  std::min(set.NumEvents, (t + 1)*chunk), partials[t]);
+                } catch (const std::exception& err) {
+                    errors[t] = err.what();
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (const auto& error : errors) {
+            if (not error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+
+        // Merge, including the intervals between the ranges
+        Partial total;
+        total.Channels.resize(set.Channels);
+        total.Histogram.resize(options.Bins);
+        for (std::size_t t = 0; t < num_threads; t++) {
+            const auto& part = partials[t];
+            const std::size_t range_start = t*chunk;
+            if (range_start >= set.NumEvents) {
+                break;
+            }
+
+            if (set.hasTime() and t > 0) {
+                const double dt = part.FirstTime - partials[t - 1].LastTime;
+                if (dt < 0.0) {
+                    total.Backwards++;
+                } else if (dt > gap_threshold) {
+                    total.Gaps++;
+                }
+
+                if (dt > total.LargestGap) {
+                    total.LargestGap = dt;
+                    total.LargestGapEvent = range_start - 1;
+                }
+            }
+
+            total.Gaps += part.Gaps;
+            total.Backwards += part.Backwards;
+            if (part.LargestGap > total.LargestGap) {
+                total.LargestGap = part.LargestGap;
+                total.LargestGapEvent = part.LargestGapEvent;
+            }
+
+            for (std::size_t b = 0; b < options.Bins; b++) {
+                total.Histogram[b] += part.Histogram[b];
+            }
+
+            for (std::size_t ch = 0; ch < set.Channels; ch++) {
+                total.Channels[ch].Events += part.Channels[ch].Events;
+                total.Channels[ch].BaselineSum += part.Channels[ch].BaselineSum;
+                total.Channels[ch].BaselineSqSum += part.Channels[ch].BaselineSqSum;
+                total.Channels[ch].RMSSum += part.Channels[ch].RMSSum;
+                total.Channels[ch].Saturated += part.Channels[ch].Saturated;
+            }
+        }
+
+        ChecksumReport checksums;
+        for (const auto& reader : set.Readers) {
+            if (not options.Verify) {
+                break;
+            }
+
+            const auto report = reader->verify_checksums(options.Threads);
+            checksums.GoodBlocks += report.GoodBlocks;
+            checksums.BadBlocks += report.BadBlocks;
+            checksums.UncheckedBlocks += report.UncheckedBlocks;
+            checksums.BadRanges.insert(checksums.BadRanges.end(), report.BadRanges.begin(),
+                                       report.BadRanges.end());
+        }
+
+        const double elapsed = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        const double mean_rate = duration > 0.0 ?
+            static_cast<double>(set.NumEvents - 1) / duration : 0.0;
+        const auto names = channel_names(set);
+
+        struct ChannelSummary {
+            std::size_t Name;
+            double Baseline;
+            double Spread;
+            double RMS;
+            uint64_t Saturated;
+        };
+        std::vector<ChannelSummary> channels;
+        for (std::size_t ch = 0; ch < set.Channels; ch++) {
+            const auto& stats = total.Channels[ch];
+            const double n = std::max<double>(static_cast<double>(stats.Events), 1.0);
+            const double baseline = stats.BaselineSum / n;
+            channels.push_back({names[ch], baseline,
+                std::sqrt(std::max(stats.BaselineSqSum / n - baseline*baseline, 0.0)),
+                stats.RMSSum / n, stats.Saturated});
+        }
+
+        if (options.Json) {
+            std::string files;
+            for (const auto& name : file_names) {
+                files += (files.empty() ? "" : ", ") + json_string(name);
+            }
+
+            std::string rates;
+            for (const auto& count : total.Histogram) {
+                rates += (rates.empty() ? "" : ", ") + json_number(
+                    bin_width > 0.0 ? static_cast<double>(count) / bin_width : 0.0);
+            }
+
+            std::string channels_json;
+            for (const auto& ch : channels) {
+                channels_json += fmt::format("{}{{\"channel\": {}, \"baseline\": {}, "
+                    "\"baseline_spread\": {}, \"rms\": {}, \"saturated\": {}}}",
+                    channels_json.empty() ? "" : ", ", ch.Name, json_number(ch.Baseline),
+                    json_number(ch.Spread), json_number(ch.RMS), ch.Saturated);
+            }
+
+            fmt::print("{{\"files\": [{}], \"events\": {}, \"bytes\": {}, "
+                       "\"duration_s\": {}, \"mean_rate_hz\": {}, "
+                       "\"rate\": {{\"bin_s\": {}, \"hz\": [{}]}}, "
+                       "\"gaps\": {{\"threshold_s\": {}, \"count\": {}, \"largest_s\": {}, "
+                       "\"largest_after_event\": {}}}, \"backwards\": {}, "
+                       "\"channels\": [{}], ",
+                       files, set.NumEvents, set.Bytes, json_number(duration),
+                       json_number(mean_rate), json_number(bin_width), rates,
+                       json_number(gap_threshold), total.Gaps, json_number(total.LargestGap),
+                       total.LargestGapEvent, total.Backwards, channels_json);
+            if (options.Verify) {
+                fmt::print("\"checksums\": {{\"good\": {}, \"bad\": {}, \"unchecked\": {}}}, ",
+                           checksums.GoodBlocks, checksums.BadBlocks,
+                           checksums.UncheckedBlocks);
+            }
+            fmt::print("\"elapsed_s\": {}}}\n", json_number(elapsed));
+        } else {
+            fmt::print("{} file(s), {} events, {:.1f} MB\n", file_names.size(),
+                       set.NumEvents, static_cast<double>(set.Bytes) / 1e6);
+            if (set.hasTime()) {
+                fmt::print("Duration: {:.3f} s, mean rate {:.2f} Hz\n", duration, mean_rate);
+                fmt::print("Rate [Hz] every {:.3f} s:", bin_width);
+                for (const auto& count : total.Histogram) {
+                    fmt::print(" {:.1f}", bin_width > 0.0 ?
+                               static_cast<double>(count) / bin_width : 0.0);
+                }
+                fmt::print("\nGaps over {:.3g} s: {}, largest {:.3g} s after event {}\n",
+                           gap_threshold, total.Gaps, total.LargestGap,
+                           total.LargestGapEvent);
+                fmt::print("Time stamps going backwards: {}\n", total.Backwards);
+            } else {
+                fmt::print("No time stamps\n");
+            }
+
+            if (not channels.empty()) {
+                fmt::print("{:>8} {:>10} {:>10} {:>10} {:>10}\n", "Channel", "Baseline",
+                           "Spread", "RMS", "Saturated");
+            }
+            for (const auto& ch : channels) {
+                fmt::print("{:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10}\n", ch.Name,
+                           ch.Baseline, ch.Spread, ch.RMS, ch.Saturated);
+            }
+
+            if (options.Verify) {
+                fmt::print("Checksums: {} good, {} bad, {} unchecked blocks\n",
+                           checksums.GoodBlocks, checksums.BadBlocks,
+                           checksums.UncheckedBlocks);
+            }
+            fmt::print("Inspected in {:.2f} s ({:.0f} MB/s)\n", elapsed,
+                       static_cast<double>(set.Bytes) / 1e6 / std::max(elapsed, 1e-9));
+        }
+
+        if (options.Verify and not checksums.isOk()) {
+            return 2;
+        }
+    } catch (const std::exception& err) {
+        fmt::print("sbc-inspect failed: {}\n", err.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+// Compares the I/O backends of BlockWriter: sustained MB/s (including the
+// final fsync) and the latency of every save().
+//
+// Usage: sbc-io-benchmark <directory> [events] [samples per event]
+
+// C STD includes
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// C++ 3rd party includes
+#include <fmt/core.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryFormat.hpp"
+
+using namespace SBCQueens::BinaryFormat;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+void sync_file(const std::string& file_name) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
+}
+
+double percentile(const std::vector<double>& sorted, const double& p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const auto i = static_cast<std::size_t>(p*static_cast<double>(sorted.size() - 1));
+    return sorted[i];
+}
+
+void run(const std::filesystem::path& dir, const IOBackend& backend,
+         const std::size_t& events, const std::size_t& samples) {
+    const auto file_name = (dir / fmt::format("sbc_io_benchmark_{}.bin",
+        io_backend_to_string(backend))).string();
+    std::filesystem::remove(file_name);
+
+    // Something that looks like a baseline, the content does not matter
+    std::vector<uint16_t> traces(samples);
+    for (std::size_t i = 0; i < samples; i++) {
+        traces[i] = static_cast<uint16_t>(8000 + (i*7919) % 13);
+    }
+
+    std::vector<double> latencies;
+    latencies.reserve(events);
+    uint64_t bytes = 0;
+
+    const auto start = Clock::now();
+    IOBackend used;
+    {
+        BlockWriter<uint64_t, uint16_t> writer(file_name, {"time_stamp", "sipm_traces"},
+            {1, 1}, {1, samples}, {}, backend);
+        used = writer.backend();
+        for (uint64_t i = 0; i < events; i++) {
+            uint64_t time[1] = {i};
+            traces[0] = static_cast<uint16_t>(i);
+
+            const auto before = Clock::now();
+            bytes += writer.save(time, traces);
+            latencies.push_back(std::chrono::duration<double, std::micro>(
+                Clock::now() - before).count());
+        }
+    }
+    sync_file(file_name);
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    fmt::print("{:>9} {:>9} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f} {:>10.1f}\n",
+               io_backend_to_string(backend), io_backend_to_string(used),
+               static_cast<double>(bytes) / seconds / 1e6,
+               percentile(latencies, 0.5), percentile(latencies, 0.99),
+               percentile(latencies, 0.999), latencies.empty() ? 0.0 : latencies.back());
+
+    std::filesystem::remove(file_name);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fmt::print("Usage: {} <directory> [events] [samples per event]\n", argv[0]);
+        return 1;
+    }
+
+    const std::filesystem::path dir = argv[1];
+    const std::size_t events = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+    const std::size_t samples = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 16*2000;
+
+    fmt::print("{} events of {} bytes in {}\n", events, samples*sizeof(uint16_t),
+               dir.string());
+    fmt::print("{:>9} {:>9} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "requested", "used",
+               "MB/s", "p50 [us]", "p99 [us]", "p99.9 [us]", "max [us]");
+
+    try {
+        for (const auto& backend : {IOBackend::Buffered, IOBackend::Direct,
+                                    IOBackend::IOUring}) {
+            run(dir, backend, events, samples);
+        }
+    } catch (const std::exception& err) {
+        fmt::print("Benchmark failed: {}\n", err.what());
+        return 1;
+    }
+
+    return 0;
+}
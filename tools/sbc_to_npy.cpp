@@ -0,0 +1,332 @@
+// Transposes SBC binary files into one .npy file per event column, so the
+// analysis can memory map only the columns it needs. A rotated set
+// ("run.bin" -> run_0000.bin, run_0001.bin...) becomes a single set of
+// .npy files with the events in file order.
+//
+// Usage: sbc-to-npy [--split-channels] [--threads N] [--columns a,b,...]
+//                   <output directory> <file.bin>...
+
+// C STD includes
+// C 3rd party includes
+// C++ STD includes
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// C++ 3rd party includes
+#include <fmt/core.h>
+
+// my includes
+#include "sbcqueens-gui/sipm_helpers/SBCBinaryReader.hpp"
+
+using namespace SBCQueens::BinaryFormat;
+
+namespace {
+
+// Rows are buffered up to this size before they are written
+constexpr std::size_t kFlushSize = 4*1024*1024;
+
+// NumPy dtype of an SBC type, in the byte order of this machine
+std::string npy_descr(const ColumnInfo& col) {
+    const char order = std::endian::native == std::endian::little ? '<' : '>';
+    if (col.Type == "char") {
+        return "|S1";
+    } else if (col.Type == "uint8") {
+        return "|u1";
+    } else if (col.Type == "int8") {
+        return "|i1";
+    } else if (col.Type == "single") {
+        return fmt::format("{}f4", order);
+    } else if (col.Type == "double") {
+        return fmt::format("{}f8", order);
+    } else if (col.Type == "float128") {
+        return fmt::format("{}f16", order);
+    }
+
+    // (u)int16, 32, 64
+    const char kind = col.Type[0] == 'u' ? 'u' : 'i';
+    return fmt::format("{}{}{}", order, kind, col.TypeSize);
+}
+
+// Version 1.0 header: magic, version, uint16 header length and the
+// dictionary padded with spaces so the data starts 64 bytes aligned.
+std::string npy_header(const std::string& descr, const std::vector<std::size_t>& shape) {
+    std::string shape_str = "(";
+    for (const auto& dim : shape) {
+        shape_str += std::to_string(dim) + ",";
+    }
+    // Only 1-tuples need the trailing comma
+    if (shape.size() > 1) {
+        shape_str.pop_back();
+    }
+    shape_str += ")";
+
+    std::string dict = fmt::format("{{'descr': '{}', 'fortran_order': False, 'shape': {}, }}",
+                                   descr, shape_str);
+    const std::size_t prefix = 10;
+    dict.append(63 - (prefix + dict.size()) % 64, ' ');
+    dict += '\n';
+
+    std::string out = "\x93NUMPY";
+    out += '\x01';
+    out += '\x00';
+    const auto dict_size = static_cast<uint16_t>(dict.size());
+    out += static_cast<char>(dict_size & 0xff);
+    out += static_cast<char>(dict_size >> 8);
+    return out + dict;
+}
+
+// An output .npy file: a slice of bytes of every event of a column
+struct Output {
+    std::string FileName;
+    // Column in the event schema
+    std::size_t Column;
+    // Bytes of the (decoded) column that go to this file
+    std::size_t ByteOffset;
+    std::size_t RowSize;
+    std::size_t DataStart;
+};
+
+bool same_schema(const Schema& a, const Schema& b) {
+    return std::equal(a.columns().begin(), a.columns().end(),
+                      b.columns().begin(), b.columns().end(),
+        [](const ColumnInfo& x, const ColumnInfo& y) {
+            return x.Name == y.Name and x.Type == y.Type and x.Shape == y.Shape;
+        });
+}
+
+// Channel names of the column rows: the en_chs of the first configuration
+// if it matches, otherwise 0, 1, 2...
+std::vector<std::size_t> channel_names(const Reader& reader, const std::size_t& channels) {
+    std::vector<std::size_t> out(channels);
+    for (std::size_t i = 0; i < channels; i++) {
+        out[i] = i;
+    }
+
+    if (reader.num_configs() == 0) {
+        return out;
+    }
+
+    try {
+        const auto en_chs = reader.config(0).read<uint8_t>("en_chs");
+        if (en_chs.size() == channels) {
+            std::copy(en_chs.begin(), en_chs.end(), out.begin());
+        }
+    } catch (const std::exception&) {}
+    return out;
+}
+
+// Writes the events [first, last) of the whole set
+void convert_range(const std::vector<std::unique_ptr<Reader>>& readers,
+                   const std::vector<std::size_t>& first_events,
+                   const std::vector<Output>& outputs,
+                   const std::size_t& first, const std::size_t& last) {
+    const Schema& schema = readers.front()->event_schema();
+    std::vector<std::fstream> streams;
+    std::vector<std::string> buffers(outputs.size());
+    for (const auto& output : outputs) {
+        streams.emplace_back(output.FileName, std::ios::in | std::ios::out | std::ios::binary);
+        streams.back().seekp(static_cast<std::streamoff>(
+            output.DataStart + first*output.RowSize));
+        if (not streams.back().is_open()) {
+            throw std::runtime_error("Could not open " + output.FileName);
+        }
+    }
+
+    auto flush = [&](const std::size_t& i) {
+        streams[i].write(buffers[i].data(), static_cast<std::streamsize>(buffers[i].size()));
+        buffers[i].clear();
+    };
+
+    std::vector<uint16_t> decoded;
+    for (std::size_t file = 0; file < readers.size(); file++) {
+        const std::size_t start = std::max(first, first_events[file]);
+        const std::size_t end = std::min(last, first_events[file] + readers[file]->size());
+        for (std::size_t i = start; i < end; i++) {
+            const auto event = (*readers[file])[i - first_events[file]];
+            for (std::size_t j = 0; j < outputs.size(); j++) {
+                const auto& col = schema.columns()[outputs[j].Column];
+                std::span<const std::byte> bytes;
+                if (col.Encoding == ColumnEncoding::ChannelChunked) {
+                    decoded = readers[file]->read_chunked<uint16_t>(col.Name,
+                                                                    i - first_events[file]);
+                    bytes = std::as_bytes(std::span<const uint16_t>(decoded));
+                } else {
+                    bytes = event.raw(col.Name);
+                }
+
+                if (col.Encoding == ColumnEncoding::DeltaZigZagBitPack) {
+                    decoded.resize(col.Length);
+                    DeltaZigZagCodec::decode(
+                        {reinterpret_cast<const char*>(bytes.data()), bytes.size()},
+                        col.Shape.back(), decoded);
+                    bytes = std::as_bytes(std::span<const uint16_t>(decoded));
+                }
+
+                const auto row = bytes.subspan(outputs[j].ByteOffset, outputs[j].RowSize);
+                buffers[j].append(reinterpret_cast<const char*>(row.data()), row.size());
+                if (buffers[j].size() >= kFlushSize) {
+                    flush(j);
+                }
+            }
+        }
+    }
+
+    for (std::size_t j = 0; j < outputs.size(); j++) {
+        flush(j);
+        if (not streams[j].good()) {
+            throw std::runtime_error("Failed to write " + outputs[j].FileName);
+        }
+    }
+}
+
+void print_usage(const char* name) {
+    fmt::print("Usage: {} [--split-channels] [--threads N] [--columns a,b,...] "
+               "<output directory> <file.bin>...\n", name);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    bool split_channels = false;
+    std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::string> columns;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--split-channels") {
+            split_channels = true;
+        } else if (arg == "--threads" and i + 1 < argc) {
+            num_threads = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1);
+        } else if (arg == "--columns" and i + 1 < argc) {
+            std::string list = argv[++i];
+            for (std::size_t start = 0; start <= list.size();) {
+                const auto end = std::min(list.find(',', start), list.size());
+                columns.push_back(list.substr(start, end - start));
+                start = end + 1;
+            }
+        } else if (arg == "-h" or arg == "--help") {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const std::filesystem::path out_dir = positional[0];
+        std::filesystem::create_directories(out_dir);
+
+        std::vector<std::unique_ptr<Reader>> readers;
+        std::vector<std::size_t> first_events;
+        std::size_t num_events = 0;
+        for (auto input = positional.begin() + 1; input != positional.end(); ++input) {
+            for (const auto& file_name : find_file_sequence(*input)) {
+                auto reader = std::make_unique<Reader>(file_name);
+                if (not readers.empty() and not same_schema(readers.front()->event_schema(),
+                                                             reader->event_schema())) {
+                    throw std::runtime_error(file_name + " has different columns");
+                }
+
+                fmt::print("{}: {} events\n", file_name, reader->size());
+                first_events.push_back(num_events);
+                num_events += reader->size();
+                readers.push_back(std::move(reader));
+            }
+        }
+
+        // One output per column, or per row of the column if split
+        const Schema& schema = readers.front()->event_schema();
+        std::vector<Output> outputs;
+        for (std::size_t c = 0; c < schema.columns().size(); c++) {
+            const auto& col = schema.columns()[c];
+            if (not columns.empty()
+                and std::find(columns.begin(), columns.end(), col.Name) == columns.end()) {
+                continue;
+            }
+
+            std::vector<std::size_t> shape = {num_events};
+            if (col.Length > 1) {
+                shape.insert(shape.end(), col.Shape.begin(), col.Shape.end());
+            }
+
+            if (not split_channels or col.Shape.size() < 2) {
+                const auto file_name = (out_dir / (col.Name + ".npy")).string();
+                const auto header = npy_header(npy_descr(col), shape);
+                outputs.push_back({file_name, c, 0, col.Length*col.TypeSize, header.size()});
+                std::ofstream(file_name, std::ios::binary) << header;
+                continue;
+            }
+
+            // Rows of [channel][samples] are contiguous
+            const std::size_t channels = col.Shape.front();
+            const std::size_t row_size = col.Length / channels * col.TypeSize;
+            shape.erase(shape.begin() + 1);
+            const auto names = channel_names(*readers.front(), channels);
+            for (std::size_t ch = 0; ch < channels; ch++) {
+                const auto file_name = (out_dir / fmt::format("{}_ch{}.npy", col.Name,
+                                                              names[ch])).string();
+                const auto header = npy_header(npy_descr(col), shape);
+                outputs.push_back({file_name, c, ch*row_size, row_size, header.size()});
+                std::ofstream(file_name, std::ios::binary) << header;
+            }
+        }
+
+        if (outputs.empty()) {
+            throw std::runtime_error("None of the columns was found");
+        }
+
+        // Every thread writes its own contiguous range of rows
+        for (const auto& output : outputs) {
+            std::filesystem::resize_file(output.FileName,
+                                         output.DataStart + num_events*output.RowSize);
+        }
+
+        num_threads = std::clamp<std::size_t>(num_threads, 1, std::max<std::size_t>(num_events, 1));
+        const std::size_t chunk = (num_events + num_threads - 1) / num_threads;
+        std::vector<std::thread> workers;
+        std::vector<std::string> errors(num_threads);
+        for (std::size_t t = 0; t < num_threads; t++) {
+            workers.emplace_back([&, t]() {
+                try {
+                    convert_range(readers, first_events, outputs, t*chunk,
+                                  std::min(num_events, (t + 1)*chunk));
+                } catch (const std::exception& err) {
+                    errors[t] = err.what();
+                }
+            });
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (const auto& error : errors) {
+            if (not error.empty()) {
+                throw std::runtime_error(error);
+            }
+        }
+
+        for (const auto& output : outputs) {
+            fmt::print("Wrote {}\n", output.FileName);
+        }
+    } catch (const std::exception& err) {
+        fmt::print("sbc-to-npy failed: {}\n", err.what());
+        return 1;
+    }
+
+    return 0;
+}